@@ -28,6 +28,7 @@
 #include "audio/bassmusicinterface.hpp"
 #include "audio/bass.h"
 #include "misc/autocrit.hpp"
+#include "misc/jobsystem.hpp"
 #include "debug/debug.hpp"
 #include "debug/errorhandler.hpp"
 #include "paklib/pakinterface.hpp"
@@ -35,6 +36,7 @@
 
 #include <string>
 #include <ctime>
+#include <thread>
 #include <cmath>
 
 #include <filesystem>
@@ -75,6 +77,10 @@ AppBase::AppBase()
 	}
 
 	gAppBase = this;
+	Profiler::SetThreadName("Main");
+
+	if (gJobSystem == nullptr)
+		gJobSystem = new JobSystem();
 
 	mMutex = nullptr;
 
@@ -125,6 +131,9 @@ AppBase::AppBase()
 	mIsDrawing = false;
 	mLastDrawWasEmpty = false;
 	mLastTimeCheck = 0;
+	mLastUpdateFTime = 0;
+	mUpdateFFrac = 1.0;
+	mUpdateInterpolation = 0.0;
 	mUpdateMultiplier = 1;
 	mPaused = false;
 	mFastForwardToUpdateNum = 0;
@@ -186,6 +195,9 @@ AppBase::AppBase()
 	mShowFPSMode = FPS_ShowFPS;
 	mDrawTime = 0;
 	mScreenBltTime = 0;
+	mLastPresentTime = 0;
+	mLastFrameTime = 0.0;
+	ResetFrameTimeStats();
 	mAlphaDisabled = false;
 	mDebugKeysEnabled = false;
 	mNoSoundNeeded = false;
@@ -392,17 +404,45 @@ AppBase::~AppBase()
 	SDL_DestroyCursor(mDraggingCursor);
 
 	gAppBase = nullptr;
+
+	delete gJobSystem;
+	gJobSystem = nullptr;
+
+	// every thread that recorded zones is gone by now
+	Profiler::Shutdown();
 }
 
 void AppBase::ClearUpdateBacklog(bool relaxForASecond)
 {
-	mLastTimeCheck = SDL_GetTicks();
+	mLastTimeCheck = SDL_GetTicksNS();
+	mLastUpdateFTime = 0;
 	mUpdateFTimeAcc = 0.0;
+	mPendingUpdatesAcc = 0.0;
 
 	if (relaxForASecond)
 		mRelaxUpdateBacklogCount = 1000;
 }
 
+void AppBase::ResetFrameTimeStats()
+{
+	mFrameTimeMean = 0.0;
+	mFrameTimeM2 = 0.0;
+	mFrameTimeSamples = 0;
+}
+
+double AppBase::GetUpdateInterpolation()
+{
+	return mUpdateInterpolation;
+}
+
+double AppBase::GetFrameTimeStdDev()
+{
+	if (mFrameTimeSamples < 2)
+		return 0.0;
+
+	return sqrt(mFrameTimeM2 / (mFrameTimeSamples - 1));
+}
+
 bool AppBase::IsScreenSaver()
 {
 	return mIsScreenSaver;
@@ -720,6 +760,19 @@ void AppBase::TakeScreenshot()
 	SDL_DestroySurface(surface);
 }
 
+bool AppBase::DumpProfile()
+{
+	std::filesystem::path aProfileDir = std::filesystem::current_path() / "profiles";
+	std::filesystem::create_directory(aProfileDir); // create silently
+
+	std::time_t t = std::time(nullptr);
+	std::tm tm = *std::localtime(&t);
+	std::ostringstream aFileNameStream;
+	aFileNameStream << std::put_time(&tm, "%Y%m%d_%H%M%S") << ".json";
+
+	return Profiler::DumpChromeTrace((aProfileDir / aFileNameStream.str()).string());
+}
+
 void AppBase::DumpProgramInfo()
 {
 	Deltree(GetAppDataFolder() + "_dump");
@@ -1515,6 +1568,7 @@ void AppBase::DoExit(int theCode)
 
 extern bool demoWind;
 extern bool debugWind;
+extern bool profilerWind;
 
 void AppBase::UpdateFrames()
 {
@@ -1532,6 +1586,8 @@ void AppBase::UpdateFrames()
 
 void AppBase::DoUpdateFramesF(float theFrac)
 {
+	PROFILE_ZONE("AppBase::DoUpdateFramesF");
+
 	if ((mVSyncUpdates) && (!mMinimized))
 		mWidgetManager->UpdateFrameF(theFrac);
 }
@@ -1592,7 +1648,6 @@ static void CalculateFPS()
 		gFPSImage = new SDLImage(gAppBase->mSDLInterface);
 		gFPSImage->Create(50, aFont.GetHeight() + 4);
 		gFPSImage->SetImageMode(false, false);
-		gFPSImage->SetVolatile(true);
 		gFPSImage->mPurgeBits = false;
 		// gFPSImage->mWantDDSurface = true;
 		gFPSImage->PurgeBits();
@@ -1619,9 +1674,8 @@ static void CalculateFPS()
 		aDrawG.FillRect(0, 0, gFPSImage->GetWidth(), gFPSImage->GetHeight());
 		aDrawG.SetColor(Color(255, 255, 255));
 		aDrawG.DrawString(aFPS, 2, aFont.GetAscent());
-		// gFPSImage->mKeepBits = false;
-		// gFPSImage->GenerateDDSurface();
-		gFPSImage->mBitsChangedCount++;
+		// drawing through a Graphics makes gFPSImage a render target, it's drawn on the GPU and never streamed or
+		// uploaded from the bits
 	}
 }
 
@@ -1634,7 +1688,6 @@ static void FPSDrawCoords(int theX, int theY)
 		gFPSImage = new SDLImage(gAppBase->mSDLInterface);
 		gFPSImage->Create(50, aFont.GetHeight() + 4);
 		gFPSImage->SetImageMode(false, false);
-		gFPSImage->SetVolatile(true);
 		gFPSImage->mPurgeBits = false;
 		// gFPSImage->mWantDDSurface = true;
 		gFPSImage->PurgeBits();
@@ -1647,7 +1700,6 @@ static void FPSDrawCoords(int theX, int theY)
 	aDrawG.FillRect(0, 0, gFPSImage->GetWidth(), gFPSImage->GetHeight());
 	aDrawG.SetColor(0xFFFFFF);
 	aDrawG.DrawString(aFPS, 2, aFont.GetAscent());
-	gFPSImage->mBitsChangedCount++;
 }
 
 static void UpdateScreenSaverInfo(uint32_t theTick)
@@ -1726,11 +1778,23 @@ bool AppBase::DrawDirtyStuff()
 
 		if (mWaitForVSync && mIsPhysWindowed && mSoftVSyncWait)
 		{
-			uint32_t aTick = SDL_GetTicks();
-			if (aTick - mLastDrawTick < mSDLInterface->mMillisecondsPerFrame)
-				SDL_Delay(mSDLInterface->mMillisecondsPerFrame - (aTick - mLastDrawTick));
+			double aSinceLastPresent = (SDL_GetTicksNS() - mLastPresentTime) / (double)SDL_NS_PER_MS;
+			if (aSinceLastPresent < mSDLInterface->mMillisecondsPerFrame)
+				PreciseSleep(mSDLInterface->mMillisecondsPerFrame - aSinceLastPresent);
 		}
 
+		uint64_t aPresentTime = SDL_GetTicksNS();
+		if (mLastPresentTime != 0)
+		{
+			// running mean and variance (Welford), so frame pacing jitter can be read off at any time
+			mLastFrameTime = (aPresentTime - mLastPresentTime) / (double)SDL_NS_PER_MS;
+			mFrameTimeSamples++;
+			double aDelta = mLastFrameTime - mFrameTimeMean;
+			mFrameTimeMean += aDelta / mFrameTimeSamples;
+			mFrameTimeM2 += aDelta * (mLastFrameTime - mFrameTimeMean);
+		}
+		mLastPresentTime = aPresentTime;
+
 		uint32_t aPreScreenBltTime = SDL_GetTicks();
 		mLastDrawTick = aPreScreenBltTime;
 
@@ -1739,6 +1803,8 @@ bool AppBase::DrawDirtyStuff()
 		// This is our one UpdateFTimeAcc if we are vsynched
 		UpdateFTimeAcc();
 
+		Profiler::MarkFrame();
+
 		uint32_t aEndTime = SDL_GetTicks();
 
 		mScreenBltTime = aEndTime - aPreScreenBltTime;
@@ -2159,6 +2225,15 @@ bool AppBase::DebugKeyDown(int theKey)
 		else
 			debugWind = true;
 	}
+	else if (theKey == SDLK_8)
+	{
+		profilerWind = !profilerWind;
+	}
+	else if (theKey == SDLK_F4)
+	{
+		DumpProfile();
+		return true;
+	}
 	else if (theKey == SDLK_F2)
 	{
 		bool isPerfOn = !Perf::IsPerfOn();
@@ -2420,7 +2495,11 @@ int AppBase::LoadingThreadProcStub(void *theArg)
 {
 	AppBase *aPopLibApp = (AppBase *)theArg;
 
-	aPopLibApp->LoadingThreadProc();
+	Profiler::SetThreadName("Loading");
+	{
+		PROFILE_ZONE("AppBase::LoadingThreadProc");
+		aPopLibApp->LoadingThreadProc();
+	}
 
 	char aStr[256];
 	sprintf(aStr, "Resource Loading Time: %d\r\n", (SDL_GetTicks() - aPopLibApp->mTimeLoaded));
@@ -2659,21 +2738,41 @@ void AppBase::ProcessSafeDeleteList()
 
 void AppBase::UpdateFTimeAcc()
 {
-	uint32_t aCurTime = SDL_GetTicks();
+	uint64_t aCurTime = SDL_GetTicksNS();
 
 	if (mLastTimeCheck != 0)
 	{
-		int aDeltaTime = aCurTime - mLastTimeCheck;
+		double aDeltaTime = (aCurTime - mLastTimeCheck) / (double)SDL_NS_PER_MS;
 
 		mUpdateFTimeAcc = std::min(mUpdateFTimeAcc + aDeltaTime, 200.0);
 
+		// counted in whole milliseconds crossed, so frequent calls don't lose or gain time to rounding
 		if (mRelaxUpdateBacklogCount > 0)
-			mRelaxUpdateBacklogCount = std::max(mRelaxUpdateBacklogCount - aDeltaTime, 0);
+		{
+			int aDeltaMS = (int)(aCurTime / SDL_NS_PER_MS - mLastTimeCheck / SDL_NS_PER_MS);
+			mRelaxUpdateBacklogCount = std::max(mRelaxUpdateBacklogCount - aDeltaMS, 0);
+		}
 	}
 
 	mLastTimeCheck = aCurTime;
 }
 
+void AppBase::PreciseSleep(double theMilliseconds)
+{
+	if (theMilliseconds <= 0)
+		return;
+
+	uint64_t aNow = SDL_GetTicksNS();
+	uint64_t anEndTime = aNow + (uint64_t)(theMilliseconds * SDL_NS_PER_MS);
+
+	// The OS sleep can overshoot by up to about a millisecond, so stop it that much early and spin the rest
+	if (anEndTime - aNow > SDL_NS_PER_MS)
+		SDL_DelayNS(anEndTime - aNow - SDL_NS_PER_MS);
+
+	while (SDL_GetTicksNS() < anEndTime)
+		std::this_thread::yield();
+}
+
 // int aNumCalls = 0;
 // uint32_t aLastCheck = 0;
 
@@ -2709,10 +2808,10 @@ bool AppBase::Process(bool allowSleep)
 	// Make sure we're not paused
 	if ((!mPaused) && (mUpdateMultiplier > 0))
 	{
-		ulong aStartTime = SDL_GetTicks();
+		uint64_t aStartTimeNS = SDL_GetTicksNS();
+		ulong aStartTime = (ulong)(aStartTimeNS / SDL_NS_PER_MS);
 
-		ulong aCurTime = aStartTime;
-		int aCumSleepTime = 0;
+		double aCumSleepTime = 0;
 
 		// When we are VSynching, only calculate this FTimeAcc right after drawing
 
@@ -2767,7 +2866,30 @@ bool AppBase::Process(bool allowSleep)
 						}
 					}
 
-					bool hadRealUpdate = DoUpdateFrames();
+					// The fixed ratio above assumes a mSyncRefreshRate display. Go by the time that really passed
+					//  since the last UpdateF instead, and only update once a whole update's worth of it has built
+					//  up, so displays running faster than the update rate get UpdateFs in between.
+					if (mVSyncUpdates)
+					{
+						uint64_t aNow = SDL_GetTicksNS();
+						mUpdateFFrac = anUpdatesPerUpdateF;
+						if (mLastUpdateFTime != 0)
+						{
+							double anElapsed = (aNow - mLastUpdateFTime) / (double)SDL_NS_PER_MS;
+							mUpdateFFrac = std::min(anElapsed * mUpdateMultiplier / mFrameTime, 200.0 / mFrameTime);
+						}
+						mLastUpdateFTime = aNow;
+						mPendingUpdatesAcc += mUpdateFFrac;
+					}
+
+					bool hadRealUpdate = true;
+					if ((!mVSyncUpdates) || (mPendingUpdatesAcc >= 1.0))
+					{
+						hadRealUpdate = DoUpdateFrames();
+						if (mVSyncUpdates)
+							mPendingUpdatesAcc = hadRealUpdate ? std::max(mPendingUpdatesAcc - 1.0, 0.0) : 0.0;
+					}
+
 					if (hadRealUpdate)
 						mUpdateAppState = UPDATESTATE_PROCESS_2;
 
@@ -2780,11 +2902,9 @@ bool AppBase::Process(bool allowSleep)
 		{
 			mUpdateAppState = UPDATESTATE_PROCESS_DONE;
 
-			mPendingUpdatesAcc += anUpdatesPerUpdateF;
-			mPendingUpdatesAcc -= 1.0;
 			ProcessSafeDeleteList();
 
-			// Process any extra updates
+			// Process any extra updates, when the display is slower than the update rate
 			while (mPendingUpdatesAcc >= 1.0)
 			{
 
@@ -2800,7 +2920,7 @@ bool AppBase::Process(bool allowSleep)
 			}
 
 			// aNumCalls++;
-			DoUpdateFramesF((float)anUpdatesPerUpdateF);
+			DoUpdateFramesF((float)(mVSyncUpdates ? mUpdateFFrac : anUpdatesPerUpdateF));
 			ProcessSafeDeleteList();
 
 			// Don't let mUpdateFTimeAcc dip below 0
@@ -2816,6 +2936,12 @@ bool AppBase::Process(bool allowSleep)
 			if (mRelaxUpdateBacklogCount > 0)
 				mUpdateFTimeAcc = 0;
 
+			// how far into the next update the draw lands, in vsync mode that's what's left in mPendingUpdatesAcc
+			if (mVSyncUpdates)
+				mUpdateInterpolation = std::min(mPendingUpdatesAcc, 1.0);
+			else
+				mUpdateInterpolation = std::min(std::max(mUpdateFTimeAcc / aFrameFTime, 0.0), 1.0);
+
 			didUpdate = true;
 		}
 
@@ -2832,7 +2958,7 @@ bool AppBase::Process(bool allowSleep)
 			else
 			{
 				// Let us take into account the time it took to draw dirty stuff
-				int aTimeToNextFrame = (int)(aFrameFTime - mUpdateFTimeAcc);
+				double aTimeToNextFrame = aFrameFTime - mUpdateFTimeAcc;
 				if (aTimeToNextFrame > 0)
 				{
 					if (!allowSleep)
@@ -2840,7 +2966,7 @@ bool AppBase::Process(bool allowSleep)
 
 					// Wait till next processing cycle
 					++mSleepCount;
-					SDL_Delay(aTimeToNextFrame);
+					PreciseSleep(aTimeToNextFrame);
 
 					aCumSleepTime += aTimeToNextFrame;
 				}
@@ -2852,16 +2978,15 @@ bool AppBase::Process(bool allowSleep)
 			// This is to make sure that the title screen doesn't take up any more than
 			// 1/3 of the processor time
 
-			ulong anEndTime = SDL_GetTicks();
-			int anElapsedTime = (anEndTime - aStartTime) - aCumSleepTime;
-			int aLoadingYieldSleepTime = std::min(250, (anElapsedTime * 2) - aCumSleepTime);
+			double anElapsedTime = (SDL_GetTicksNS() - aStartTimeNS) / (double)SDL_NS_PER_MS - aCumSleepTime;
+			double aLoadingYieldSleepTime = std::min(250.0, (anElapsedTime * 2) - aCumSleepTime);
 
 			if (aLoadingYieldSleepTime >= 0)
 			{
 				if (!allowSleep)
 					return false;
 
-				SDL_Delay(aLoadingYieldSleepTime);
+				SDL_Delay((uint32_t)aLoadingYieldSleepTime);
 			}
 		}
 	}
@@ -3545,10 +3670,19 @@ PopLib::SDLImage *AppBase::GetImage(const std::string &theFileName, bool commitB
 	if (aLoadedImage == nullptr)
 		return nullptr;
 
+	SDLImage *anImage = CreateImage(aLoadedImage, theFileName, commitBits);
+	delete aLoadedImage;
+
+	return anImage;
+}
+
+PopLib::SDLImage *AppBase::CreateImage(ImageLib::Image *theLoadedImage, const std::string &theFileName,
+									   bool commitBits)
+{
 	SDLImage *anImage = new SDLImage(mSDLInterface);
 	anImage->mFilePath = theFileName;
-	anImage->SetBits((uint32_t*)aLoadedImage->GetBits(), aLoadedImage->GetWidth(), aLoadedImage->GetHeight(), commitBits);
-	delete aLoadedImage;
+	anImage->SetBits((uint32_t *)theLoadedImage->GetBits(), theLoadedImage->GetWidth(), theLoadedImage->GetHeight(),
+					 commitBits);
 
 	return anImage;
 }
@@ -4202,7 +4336,8 @@ void AppBase::Set3DAcclerated(bool is3D, bool reinit)
 	}
 }
 
-SharedImageRef AppBase::GetSharedImage(const std::string &theFileName, const std::string &theVariant, bool *isNew)
+SharedImageRef AppBase::GetSharedImage(const std::string &theFileName, const std::string &theVariant, bool *isNew,
+									   ImageLib::Image *theLoadedImage)
 {
 	std::string anUpperFileName = StringToUpper(theFileName);
 	std::string anUpperVariant = StringToUpper(theVariant);
@@ -4225,6 +4360,8 @@ SharedImageRef AppBase::GetSharedImage(const std::string &theFileName, const std
 		// Pass in a '!' as the first char of the file name to create a new image
 		if ((theFileName.length() > 0) && (theFileName[0] == '!'))
 			aSharedImageRef.mSharedImage->mImage = new SDLImage(mSDLInterface);
+		else if (theLoadedImage != nullptr)
+			aSharedImageRef.mSharedImage->mImage = CreateImage(theLoadedImage, theFileName, false);
 		else
 			aSharedImageRef.mSharedImage->mImage = GetImage(theFileName, false);
 	}
@@ -297,12 +297,18 @@ class AppBase : public ButtonListener, public DialogListener
 	bool mLastDrawWasEmpty;
 	/// @brief true if the app has a pending draw
 	bool mHasPendingDraw;
-	/// @brief TBA
+	/// @brief updates' worth of real time not yet run, vsync mode only
 	double mPendingUpdatesAcc;
-	/// @brief TBA
+	/// @brief milliseconds of game time not yet consumed by updates
 	double mUpdateFTimeAcc;
-	/// @brief TBA
+	/// @brief nanosecond tick of the last UpdateFTimeAcc
 	uint64_t mLastTimeCheck;
+	/// @brief nanosecond tick of the last UpdateF
+	uint64_t mLastUpdateFTime;
+	/// @brief updates' worth of real time the coming UpdateF covers, vsync mode only
+	double mUpdateFFrac;
+	/// @brief fraction of an update left in mUpdateFTimeAcc after the last update, for interpolating draws
+	double mUpdateInterpolation;
 	/// @brief last time
 	uint64_t mLastTime;
 	/// @brief last user input tick
@@ -377,6 +383,16 @@ class AppBase : public ButtonListener, public DialogListener
 	int mShowFPSMode;
 	/// @brief screen blit time
 	int mScreenBltTime;
+	/// @brief nanosecond tick of the last present
+	uint64_t mLastPresentTime;
+	/// @brief milliseconds between the last two presents
+	double mLastFrameTime;
+	/// @brief running mean of mLastFrameTime, in milliseconds
+	double mFrameTimeMean;
+	/// @brief running sum of squared differences from mFrameTimeMean
+	double mFrameTimeM2;
+	/// @brief number of frame times in mFrameTimeMean
+	int mFrameTimeSamples;
 	/// @brief true if loading thread started
 	bool mAutoStartLoadingThread;
 	/// @brief true if loading thread started
@@ -479,8 +495,11 @@ class AppBase : public ButtonListener, public DialogListener
 	/// @param singleMessage 
 	/// @return true if success
 	bool ProcessDeferredMessages(bool singleMessage);
-	/// @brief TBA
+	/// @brief adds the time since the last call to mUpdateFTimeAcc
 	void UpdateFTimeAcc();
+	/// @brief sleeps for the given time, coarse sleeping then spinning on the nanosecond clock for the last part
+	/// @param theMilliseconds 
+	void PreciseSleep(double theMilliseconds);
 	/// @brief process
 	/// @param allowSleep 
 	/// @return true if success
@@ -746,13 +765,20 @@ class AppBase : public ButtonListener, public DialogListener
 	/// @param commitBits 
 	/// @return SDLImage
 	virtual SDLImage *GetImage(const std::string &theFileName, bool commitBits = true);
+	/// @brief makes an image out of one that was already decoded, theLoadedImage is copied and stays the caller's
+	/// @param theLoadedImage 
+	/// @param theFileName 
+	/// @param commitBits 
+	/// @return SDLImage
+	SDLImage *CreateImage(ImageLib::Image *theLoadedImage, const std::string &theFileName, bool commitBits = true);
 	/// @brief gets a shared image
 	/// @param theFileName 
 	/// @param theVariant 
 	/// @param isNew 
+	/// @param theLoadedImage if the image is new, it's made from this instead of reading theFileName
 	/// @return SharedImageRef
 	virtual SharedImageRef GetSharedImage(const std::string &theFileName, const std::string &theVariant = "",
-										  bool *isNew = NULL);
+										  bool *isNew = NULL, ImageLib::Image *theLoadedImage = nullptr);
 
 	/// @brief sets taskbar icon
 	/// @param theFileName 
@@ -1142,6 +1168,17 @@ class AppBase : public ButtonListener, public DialogListener
 	/// @brief TBA
 	/// @param relaxForASecond 
 	void ClearUpdateBacklog(bool relaxForASecond = false);
+	/// @brief writes the profiler's recorded zones to profiles/ as a Chrome trace
+	/// @return true if success
+	bool DumpProfile();
+	/// @brief forgets the frame time statistics
+	void ResetFrameTimeStats();
+	/// @brief how far the game is into the next update when drawing, for draws that interpolate between updates
+	/// @return 0 right after an update to 1 when the next one is due
+	double GetUpdateInterpolation();
+	/// @brief standard deviation of the frame time since the last ResetFrameTimeStats
+	/// @return milliseconds
+	double GetFrameTimeStdDev();
 	/// @brief is the app a screensaver?
 	/// @return true if yes
 	bool IsScreenSaver();
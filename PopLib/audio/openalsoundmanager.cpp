@@ -162,12 +162,14 @@ bool OpenALSoundManager::LoadSound(unsigned int theSfxID, const std::string &the
 		if (!fp)
 			continue;
 
-		p_fseek(fp, 0, SEEK_END);
-		size_t fileSize = p_ftell(fp);
-		p_fseek(fp, 0, SEEK_SET);
-		uint8_t *data = new uint8_t[fileSize];
-		p_fread(data, 1, fileSize, fp);
-		p_fclose(fp);
+		// decoded straight from the pak, the mapping lives until fp is closed
+		size_t fileSize;
+		const void *data = p_fmap(fp, &fileSize);
+		if (!data)
+		{
+			p_fclose(fp);
+			continue;
+		}
 
 		mSourceDataSizes[theSfxID] = fileSize;
 
@@ -175,7 +177,7 @@ bool OpenALSoundManager::LoadSound(unsigned int theSfxID, const std::string &the
 		ma_result result = ma_decoder_init_memory(data, fileSize, NULL, &decoder);
 		if (result != MA_SUCCESS)
 		{
-			delete[] data;
+			p_fclose(fp);
 			continue;
 		}
 
@@ -185,8 +187,8 @@ bool OpenALSoundManager::LoadSound(unsigned int theSfxID, const std::string &the
 		ma_result decoder_result = ma_decoder_read_pcm_frames(&decoder, pcmData.data(), pcmData.size(), NULL);
 		if (decoder_result != MA_SUCCESS)
 		{
-			delete[] data;
 			ma_decoder_uninit(&decoder);
+			p_fclose(fp);
 			continue;
 		}
 
@@ -196,8 +198,8 @@ bool OpenALSoundManager::LoadSound(unsigned int theSfxID, const std::string &the
 
 		mSourceSounds[theSfxID] = buffer;
 
-		delete[] data;
 		ma_decoder_uninit(&decoder);
+		p_fclose(fp);
 		return true;
 	}
 
@@ -228,21 +230,63 @@ int OpenALSoundManager::LoadSound(const std::string &theFilename)
 	return -1;
 }
 
-static int p_fseek64_wrap(PFILE *f, ogg_int64_t off, int whence)
+// Ogg streams are decoded from p_fmap'd memory, for stored pak entries that's the mapped .pak itself
+struct OggMemorySource
+{
+	const uint8_t *mData;
+	size_t mSize;
+	size_t mPos;
+};
+
+static size_t ogg_mem_read(void *ptr, size_t size, size_t nmemb, void *datasource)
+{
+	OggMemorySource *aSource = (OggMemorySource *)datasource;
+	if (size == 0)
+		return 0;
+
+	size_t aCount = std::min(nmemb, (aSource->mSize - aSource->mPos) / size);
+	memcpy(ptr, aSource->mData + aSource->mPos, aCount * size);
+	aSource->mPos += aCount * size;
+	return aCount;
+}
+
+static int ogg_mem_seek(void *datasource, ogg_int64_t offset, int whence)
 {
-	if (!f)
+	OggMemorySource *aSource = (OggMemorySource *)datasource;
+
+	ogg_int64_t aPos;
+	switch (whence)
+	{
+	case SEEK_SET:
+		aPos = offset;
+		break;
+	case SEEK_CUR:
+		aPos = (ogg_int64_t)aSource->mPos + offset;
+		break;
+	case SEEK_END:
+		aPos = (ogg_int64_t)aSource->mSize + offset;
+		break;
+	default:
 		return -1;
-	
-	return p_fseek(f, (long)off, whence);
+	}
+
+	if ((aPos < 0) || (aPos > (ogg_int64_t)aSource->mSize))
+		return -1;
+
+	aSource->mPos = (size_t)aPos;
+	return 0;
+}
+
+static long ogg_mem_tell(void *datasource)
+{
+	return (long)((OggMemorySource *)datasource)->mPos;
 }
 
-int ov_pak_open(PFILE *f, OggVorbis_File *vf, char *initial, long ibytes)
+int ov_mem_open(OggMemorySource *theSource, OggVorbis_File *vf)
 {
-	ov_callbacks callbacks = {(size_t(*)(void *, size_t, size_t, void *))p_fread,
-							  (int (*)(void *, ogg_int64_t, int))p_fseek64_wrap, (int (*)(void *))p_fclose,
-							  (long (*)(void *))p_ftell};
+	ov_callbacks callbacks = {ogg_mem_read, ogg_mem_seek, NULL, ogg_mem_tell};
 
-	return ov_open_callbacks((void *)f, vf, initial, ibytes, callbacks);
+	return ov_open_callbacks((void *)theSource, vf, NULL, 0, callbacks);
 }
 
 bool OpenALSoundManager::LoadOGGSound(unsigned int theSfxID, const std::string &theFilename)
@@ -254,7 +298,11 @@ bool OpenALSoundManager::LoadOGGSound(unsigned int theSfxID, const std::string &
 	if (!aFile)
 		return false;
 
-	if (ov_pak_open(aFile, &vf, NULL, 0) < 0)
+	OggMemorySource aSource;
+	aSource.mData = (const uint8_t *)p_fmap(aFile, &aSource.mSize);
+	aSource.mPos = 0;
+
+	if (!aSource.mData || ov_mem_open(&aSource, &vf) < 0)
 	{
 		p_fclose(aFile);
 		return false;
@@ -294,6 +342,7 @@ bool OpenALSoundManager::LoadOGGSound(unsigned int theSfxID, const std::string &
 			// this means something is wrong
 			delete[] aBuf;
 			ov_clear(&vf);
+			p_fclose(aFile);
 			return false;
 		}
 		else
@@ -310,6 +359,7 @@ bool OpenALSoundManager::LoadOGGSound(unsigned int theSfxID, const std::string &
 
 	delete[] aBuf;
 	ov_clear(&vf);
+	p_fclose(aFile);
 
 	return true;
 }
@@ -320,19 +370,15 @@ bool OpenALSoundManager::LoadAUSound(unsigned int theSfxID, const std::string &t
 	if (!fp)
 		return false;
 
-	p_fseek(fp, 0, SEEK_END);
-	size_t fileSize = p_ftell(fp);
-	p_fseek(fp, 0, SEEK_SET);
-	uint8_t *data = new uint8_t[fileSize];
-	p_fread(data, 1, fileSize, fp);
-	p_fclose(fp);
+	size_t fileSize;
+	const uint8_t *data = (const uint8_t *)p_fmap(fp, &fileSize);
 
 	AuFile aAUFile;
-	if (!LoadAU(data, fileSize, aAUFile))
-	{
-		delete[] data;
+	bool loaded = data && LoadAU(data, fileSize, aAUFile);
+	p_fclose(fp);
+
+	if (!loaded)
 		return false;
-	}
 
 	mSourceDataSizes[theSfxID] = aAUFile.mSamples.size();
 
@@ -345,8 +391,6 @@ bool OpenALSoundManager::LoadAUSound(unsigned int theSfxID, const std::string &t
 
 	mSourceSounds[theSfxID] = buffer;
 
-	delete[] data;
-
 	return true;
 }
 
@@ -5,6 +5,7 @@
 #endif
 
 #include "common.hpp"
+#include "profiler.hpp"
 
 #ifdef _WIN32
 #include <time.h>
@@ -106,7 +107,9 @@ class AutoPerf
 
 #define PERF_BEGIN(theName) Perf::StartTiming(theName)
 #define PERF_END(theName) Perf::StopTiming(theName)
-#define AUTO_PERF_MULTI(theName, theSuffix) AutoPerf anAutoPerf##theSuffix(theName)
+#define AUTO_PERF_MULTI(theName, theSuffix)                                                                            \
+	PROFILE_ZONE_MULTI(theName, theSuffix);                                                                            \
+	AutoPerf anAutoPerf##theSuffix(theName)
 #define AUTO_PERF_2(theName, theSuffix) AUTO_PERF_MULTI(theName, theSuffix)
 #define AUTO_PERFL(theName)                                                                                    \
 	AUTO_PERF_2(theName, __LINE__) // __LINE__ doesn't work correctly if Edit-and-Continue (/ZI) is enabled
@@ -128,8 +131,9 @@ class AutoPerf
 
 #define PERF_BEGIN(theName)
 #define PERF_END(theName)
-#define AUTO_PERF_MULTI(theName, theSuffix)
-#define AUTO_PERF(theName)
+// AUTO_PERF sites are always profiler zones, PERF_ENABLED only adds the Perf summary on top
+#define AUTO_PERF_MULTI(theName, theSuffix) PROFILE_ZONE_MULTI(theName, theSuffix)
+#define AUTO_PERF(theName) PROFILE_ZONE(theName)
 
 #define PERF_BEGIN_COND(theName, theCond)
 #define PERF_END_COND(theName, theCond)
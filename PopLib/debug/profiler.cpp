@@ -0,0 +1,249 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+
+using namespace PopLib;
+
+// Thread buffers live until Shutdown, a trace dumped after a thread has exited still shows what it did
+static std::vector<ProfileThreadBuffer *> gProfileThreads;
+static std::mutex gProfileMutex;
+
+static uint64_t gFrameStarts[Profiler::FRAME_HISTORY + 1];
+static uint64_t gFrameCount = 0; // frames marked so far, frame i starts at gFrameStarts[i % (FRAME_HISTORY + 1)]
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+ProfileThreadBuffer::ProfileThreadBuffer(int theIndex)
+	: mHead(0), mDepth(0), mIndex(theIndex), mName(StrFormat("Thread %d", theIndex))
+{
+	for (int i = 0; i < CAPACITY; i++)
+		mSlots[i].mSequence.store(0, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ProfileThreadBuffer::CopyEvents(uint64_t theStart, uint64_t theEnd, ProfileEventVector &theEvents)
+{
+	uint64_t aHead = mHead.load(std::memory_order_acquire);
+	uint64_t aFirst = (aHead > CAPACITY) ? aHead - CAPACITY : 0;
+
+	for (uint64_t i = aFirst; i < aHead; i++)
+	{
+		Slot &aSlot = mSlots[i & (CAPACITY - 1)];
+		if (aSlot.mSequence.load(std::memory_order_acquire) != i + 1)
+			continue; // already lapped by the writer
+
+		// The copy can race with the writer starting on this slot again. That race is tolerated: the sequence is
+		// cleared before the writer touches the fields, so a torn copy fails the second check and is dropped.
+		ProfileEvent anEvent = aSlot.mEvent;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (aSlot.mSequence.load(std::memory_order_relaxed) != i + 1)
+			continue;
+
+		if ((anEvent.mEnd > theStart) && (anEvent.mStart < theEnd))
+			theEvents.push_back(anEvent);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+ProfileThreadBuffer *Profiler::RegisterThread()
+{
+	std::lock_guard<std::mutex> aLock(gProfileMutex);
+
+	ProfileThreadBuffer *aBuffer = new ProfileThreadBuffer((int)gProfileThreads.size());
+	gProfileThreads.push_back(aBuffer);
+	gThreadBuffer = aBuffer;
+	return aBuffer;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void Profiler::SetThreadName(const std::string &theName)
+{
+	ProfileThreadBuffer *aBuffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> aLock(gProfileMutex);
+	aBuffer->mName = theName;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void Profiler::MarkFrame()
+{
+	uint64_t aNow = SDL_GetPerformanceCounter();
+
+	std::lock_guard<std::mutex> aLock(gProfileMutex);
+	gFrameStarts[gFrameCount % (FRAME_HISTORY + 1)] = aNow;
+	gFrameCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool Profiler::GetFrame(int theFramesAgo, uint64_t &theStart, uint64_t &theEnd)
+{
+	std::lock_guard<std::mutex> aLock(gProfileMutex);
+
+	// a frame needs both of its marks, the newest mark only starts the frame in progress
+	uint64_t aFinished = (gFrameCount > 0) ? gFrameCount - 1 : 0;
+	if ((theFramesAgo < 0) || ((uint64_t)theFramesAgo >= std::min(aFinished, (uint64_t)FRAME_HISTORY)))
+		return false;
+
+	uint64_t aFrame = aFinished - 1 - theFramesAgo;
+	theStart = gFrameStarts[aFrame % (FRAME_HISTORY + 1)];
+	theEnd = gFrameStarts[(aFrame + 1) % (FRAME_HISTORY + 1)];
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+int Profiler::GetFrameCount()
+{
+	std::lock_guard<std::mutex> aLock(gProfileMutex);
+
+	uint64_t aFinished = (gFrameCount > 0) ? gFrameCount - 1 : 0;
+	return (int)std::min(aFinished, (uint64_t)FRAME_HISTORY);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void Profiler::GetEvents(uint64_t theStart, uint64_t theEnd, ProfileEventVector &theEvents)
+{
+	std::vector<ProfileThreadBuffer *> aThreads;
+	{
+		std::lock_guard<std::mutex> aLock(gProfileMutex);
+		aThreads = gProfileThreads;
+	}
+
+	for (size_t i = 0; i < aThreads.size(); i++)
+	{
+		size_t aFirst = theEvents.size();
+		aThreads[i]->CopyEvents(theStart, theEnd, theEvents);
+
+		// zones are pushed as they finish, so a parent comes after its children
+		std::sort(theEvents.begin() + aFirst, theEvents.end(), [](const ProfileEvent &a, const ProfileEvent &b) {
+			return (a.mStart != b.mStart) ? (a.mStart < b.mStart) : (a.mDepth < b.mDepth);
+		});
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+int Profiler::GetThreadCount()
+{
+	std::lock_guard<std::mutex> aLock(gProfileMutex);
+	return (int)gProfileThreads.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+std::string Profiler::GetThreadName(int theThread)
+{
+	std::lock_guard<std::mutex> aLock(gProfileMutex);
+
+	if ((theThread < 0) || (theThread >= (int)gProfileThreads.size()))
+		return "";
+	return gProfileThreads[theThread]->mName;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+double Profiler::TicksToMilliseconds(uint64_t theTicks)
+{
+	static double aTicksPerMillisecond = SDL_GetPerformanceFrequency() / 1000.0;
+	return theTicks / aTicksPerMillisecond;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void Profiler::Shutdown()
+{
+	std::lock_guard<std::mutex> aLock(gProfileMutex);
+
+	for (size_t i = 0; i < gProfileThreads.size(); i++)
+		delete gProfileThreads[i];
+	gProfileThreads.clear();
+
+	// a zone recorded on this thread after this registers a new buffer
+	gThreadBuffer = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+static std::string JSONEscape(const std::string &theString)
+{
+	std::string aResult;
+	for (size_t i = 0; i < theString.length(); i++)
+	{
+		char aChar = theString[i];
+		if ((aChar == '"') || (aChar == '\\'))
+			aResult += '\\';
+		if ((unsigned char)aChar >= 0x20)
+			aResult += aChar;
+	}
+	return aResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool Profiler::DumpChromeTrace(const std::string &theFileName)
+{
+	ProfileEventVector anEvents;
+	GetEvents(0, UINT64_MAX, anEvents);
+
+	std::vector<uint64_t> aFrames;
+	int aThreadCount;
+	{
+		std::lock_guard<std::mutex> aLock(gProfileMutex);
+		uint64_t aFirst = (gFrameCount > FRAME_HISTORY + 1) ? gFrameCount - (FRAME_HISTORY + 1) : 0;
+		for (uint64_t i = aFirst; i < gFrameCount; i++)
+			aFrames.push_back(gFrameStarts[i % (FRAME_HISTORY + 1)]);
+		aThreadCount = (int)gProfileThreads.size();
+	}
+
+	FILE *aFile = fopen(theFileName.c_str(), "w");
+	if (aFile == nullptr)
+		return false;
+
+	uint64_t anOrigin = UINT64_MAX;
+	for (size_t i = 0; i < anEvents.size(); i++)
+		anOrigin = std::min(anOrigin, anEvents[i].mStart);
+	if (!aFrames.empty())
+		anOrigin = std::min(anOrigin, aFrames.front());
+
+	// trace timestamps are in microseconds
+	double aTicksPerMicrosecond = SDL_GetPerformanceFrequency() / 1000000.0;
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", aFile);
+
+	bool first = true;
+	for (int i = 0; i < aThreadCount; i++)
+	{
+		fprintf(aFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", i, JSONEscape(GetThreadName(i)).c_str());
+		first = false;
+	}
+
+	for (size_t i = 0; i < aFrames.size(); i++)
+	{
+		fprintf(aFile, "%s{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}",
+				first ? "" : ",\n", (aFrames[i] - anOrigin) / aTicksPerMicrosecond);
+		first = false;
+	}
+
+	for (size_t i = 0; i < anEvents.size(); i++)
+	{
+		const ProfileEvent &anEvent = anEvents[i];
+		fprintf(aFile, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				first ? "" : ",\n", JSONEscape(anEvent.mName).c_str(), anEvent.mThread,
+				(anEvent.mStart - anOrigin) / aTicksPerMicrosecond,
+				(anEvent.mEnd - anEvent.mStart) / aTicksPerMicrosecond);
+		first = false;
+	}
+
+	fputs("\n]}\n", aFile);
+	fclose(aFile);
+	return true;
+}
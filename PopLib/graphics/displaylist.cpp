@@ -0,0 +1,367 @@
+#include "displaylist.hpp"
+#include "graphics.hpp"
+#include "font.hpp"
+
+using namespace PopLib;
+
+DisplayList::DisplayList()
+{
+	mComplete = true;
+}
+
+void DisplayList::Clear()
+{
+	mCommands.clear();
+	mComplete = true;
+}
+
+DisplayList::Command &DisplayList::AddCommand(int theType, const Color &theColor, int theDrawMode)
+{
+	mCommands.push_back(Command());
+
+	Command &aCommand = mCommands.back();
+	aCommand.mType = theType;
+	aCommand.mDrawMode = theDrawMode;
+	aCommand.mColor = theColor;
+	aCommand.mImage = nullptr;
+	aCommand.mFont = nullptr;
+	aCommand.mX = 0;
+	aCommand.mY = 0;
+	aCommand.mX2 = 0;
+	aCommand.mY2 = 0;
+	aCommand.mRot = 0;
+	aCommand.mFastStretch = false;
+	return aCommand;
+}
+
+void DisplayList::AddString(Font *theFont, const PopString &theString, int theX, int theY, const Color &theColor,
+							const Rect &theClipRect, int theDrawMode)
+{
+	Command &aCommand = AddCommand(CMD_DRAWSTRING, theColor, theDrawMode);
+	aCommand.mFont = theFont;
+	aCommand.mString = theString;
+	aCommand.mClipRect = theClipRect;
+	aCommand.mX = theX;
+	aCommand.mY = theY;
+}
+
+Rect DisplayList::TranslateRect(const Rect &theRect, Graphics *g)
+{
+	return Rect((int)(theRect.mX + g->mTransX), (int)(theRect.mY + g->mTransY), theRect.mWidth, theRect.mHeight);
+}
+
+void DisplayList::Draw(Graphics *g)
+{
+	Draw(g, Color::White);
+}
+
+/// <summary>
+/// Replays the list translated by g's transform, clipped to g's clip rect and with every color multiplied by theColor
+/// </summary>
+void DisplayList::Draw(Graphics *g, const Color &theColor)
+{
+	Image *aDestImage = g->mDestImage;
+	bool modulate = theColor != Color::White;
+
+	for (ulong i = 0; i < mCommands.size(); i++)
+	{
+		const Command &aCommand = mCommands[i];
+
+		Color aColor = aCommand.mColor;
+		if (modulate)
+			aColor = Color(aColor.mRed * theColor.mRed / 255, aColor.mGreen * theColor.mGreen / 255,
+						   aColor.mBlue * theColor.mBlue / 255, aColor.mAlpha * theColor.mAlpha / 255);
+
+		switch (aCommand.mType)
+		{
+		case CMD_FILLRECT:
+		case CMD_CLEARRECT: {
+			Rect aDestRect = TranslateRect(aCommand.mDestRect, g).Intersection(g->mClipRect);
+			if ((aDestRect.mWidth <= 0) || (aDestRect.mHeight <= 0))
+				break;
+
+			if (aCommand.mType == CMD_FILLRECT)
+				aDestImage->FillRect(aDestRect, aColor, aCommand.mDrawMode);
+			else
+				aDestImage->ClearRect(aDestRect);
+			break;
+		}
+		case CMD_DRAWRECT: {
+			// same split as Graphics::DrawRect when the outline crosses the clip rect
+			Rect aDestRect = TranslateRect(aCommand.mDestRect, g);
+			Rect aFullDestRect(aDestRect.mX, aDestRect.mY, aDestRect.mWidth + 1, aDestRect.mHeight + 1);
+			if (aFullDestRect == aFullDestRect.Intersection(g->mClipRect))
+			{
+				aDestImage->DrawRect(aDestRect, aColor, aCommand.mDrawMode);
+				break;
+			}
+
+			Rect anEdges[4] = {Rect(aDestRect.mX, aDestRect.mY, aDestRect.mWidth + 1, 1),
+							   Rect(aDestRect.mX, aDestRect.mY + aDestRect.mHeight, aDestRect.mWidth + 1, 1),
+							   Rect(aDestRect.mX, aDestRect.mY + 1, 1, aDestRect.mHeight - 1),
+							   Rect(aDestRect.mX + aDestRect.mWidth, aDestRect.mY + 1, 1, aDestRect.mHeight - 1)};
+			for (int anEdge = 0; anEdge < 4; anEdge++)
+			{
+				Rect aClippedRect = anEdges[anEdge].Intersection(g->mClipRect);
+				if ((aClippedRect.mWidth > 0) && (aClippedRect.mHeight > 0))
+					aDestImage->FillRect(aClippedRect, aColor, aCommand.mDrawMode);
+			}
+			break;
+		}
+		case CMD_DRAWLINE:
+		case CMD_DRAWLINEAA: {
+			double aStartX = aCommand.mX + g->mTransX;
+			double aStartY = aCommand.mY + g->mTransY;
+			double aEndX = aCommand.mX2 + g->mTransX;
+			double aEndY = aCommand.mY2 + g->mTransY;
+
+			if (!g->DrawLineClipHelper(&aStartX, &aStartY, &aEndX, &aEndY))
+				break;
+
+			if (aCommand.mType == CMD_DRAWLINE)
+				aDestImage->DrawLine(aStartX, aStartY, aEndX, aEndY, aColor, aCommand.mDrawMode);
+			else
+				aDestImage->DrawLineAA(aStartX, aStartY, aEndX, aEndY, aColor, aCommand.mDrawMode);
+			break;
+		}
+		case CMD_BLT:
+		case CMD_BLTMIRROR: {
+			// clip the same way Graphics::DrawImage and DrawImageMirror do
+			int aX = (int)(aCommand.mDestRect.mX + g->mTransX);
+			int aY = (int)(aCommand.mDestRect.mY + g->mTransY);
+			const Rect &aSrcRect = aCommand.mSrcRect;
+
+			Rect aDestRect = Rect(aX, aY, aSrcRect.mWidth, aSrcRect.mHeight).Intersection(g->mClipRect);
+			if ((aDestRect.mWidth <= 0) || (aDestRect.mHeight <= 0))
+				break;
+
+			if (aCommand.mType == CMD_BLT)
+			{
+				Rect aClippedSrcRect(aSrcRect.mX + aDestRect.mX - aX, aSrcRect.mY + aDestRect.mY - aY,
+									 aDestRect.mWidth, aDestRect.mHeight);
+				aDestImage->Blt(aCommand.mImage, aDestRect.mX, aDestRect.mY, aClippedSrcRect, aColor,
+								aCommand.mDrawMode);
+			}
+			else
+			{
+				int aRightClip = aSrcRect.mWidth - aDestRect.mWidth - (aDestRect.mX - aX);
+				Rect aClippedSrcRect(aSrcRect.mX + aRightClip, aSrcRect.mY + aDestRect.mY - aY, aDestRect.mWidth,
+									 aDestRect.mHeight);
+				aDestImage->BltMirror(aCommand.mImage, aDestRect.mX, aDestRect.mY, aClippedSrcRect, aColor,
+									  aCommand.mDrawMode);
+			}
+			break;
+		}
+		case CMD_BLTF: {
+			Rect aClipRect = TranslateRect(aCommand.mClipRect, g).Intersection(g->mClipRect);
+			aDestImage->BltF(aCommand.mImage, (float)(aCommand.mX + g->mTransX), (float)(aCommand.mY + g->mTransY),
+							 aCommand.mSrcRect, aClipRect, aColor, aCommand.mDrawMode);
+			break;
+		}
+		case CMD_BLTROTATED: {
+			Rect aClipRect = TranslateRect(aCommand.mClipRect, g).Intersection(g->mClipRect);
+			aDestImage->BltRotated(aCommand.mImage, (float)(aCommand.mX + g->mTransX),
+								   (float)(aCommand.mY + g->mTransY), aCommand.mSrcRect, aClipRect, aColor,
+								   aCommand.mDrawMode, aCommand.mRot, (float)aCommand.mX2, (float)aCommand.mY2);
+			break;
+		}
+		case CMD_STRETCHBLT:
+		case CMD_STRETCHBLTMIRROR: {
+			Rect aDestRect = TranslateRect(aCommand.mDestRect, g);
+			Rect aClipRect = TranslateRect(aCommand.mClipRect, g).Intersection(g->mClipRect);
+
+			if (aCommand.mType == CMD_STRETCHBLT)
+				aDestImage->StretchBlt(aCommand.mImage, aDestRect, aCommand.mSrcRect, aClipRect, aColor,
+									   aCommand.mDrawMode, aCommand.mFastStretch);
+			else
+				aDestImage->StretchBltMirror(aCommand.mImage, aDestRect, aCommand.mSrcRect, aClipRect, aColor,
+											 aCommand.mDrawMode, aCommand.mFastStretch);
+			break;
+		}
+		case CMD_DRAWSTRING: {
+			// the font places its glyphs again, out of whatever its caches hold now. Replaying into another recording
+			// records the text again.
+			Graphics aStringG(*g);
+			aStringG.mFont = aCommand.mFont;
+			aStringG.mColor = aColor;
+			aStringG.mDrawMode = aCommand.mDrawMode;
+			aStringG.mClipRect = TranslateRect(aCommand.mClipRect, g).Intersection(g->mClipRect);
+			if ((aStringG.mClipRect.mWidth > 0) && (aStringG.mClipRect.mHeight > 0))
+				aStringG.DrawString(aCommand.mString, (int)aCommand.mX, (int)aCommand.mY);
+			break;
+		}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DisplayListRecorder::DisplayListRecorder(DisplayList *theDisplayList, int theWidth, int theHeight)
+{
+	mDisplayList = theDisplayList;
+	mWidth = theWidth;
+	mHeight = theHeight;
+}
+
+/// <summary>
+/// Points g at this recorder with its origin at the recorder's origin and no clipping or scaling, keeping g's font,
+/// color and other state. Nothing is clipped while recording so the list can be replayed under any clip rect. Text
+/// drawn through g, or through copies made of it, is recorded as DrawString calls.
+/// </summary>
+void DisplayListRecorder::Attach(Graphics *g)
+{
+	g->mDestImage = this;
+	g->mRecordList = mDisplayList;
+	g->mTransX = 0;
+	g->mTransY = 0;
+	g->mScaleX = 1;
+	g->mScaleY = 1;
+	g->mScaleOrigX = 0;
+	g->mScaleOrigY = 0;
+	g->mClipRect = Rect(-UNCLIPPED_SIZE, -UNCLIPPED_SIZE, UNCLIPPED_SIZE * 2, UNCLIPPED_SIZE * 2);
+}
+
+bool DisplayListRecorder::PolyFill3D(const Point theVertices[], int theNumVertices, const Rect *theClipRect,
+									 const Color &theColor, int theDrawMode, int tx, int ty, bool convex)
+{
+	// claim it was drawn so Graphics doesn't go on to scan convert it
+	mDisplayList->mComplete = false;
+	return true;
+}
+
+void DisplayListRecorder::FillRect(const Rect &theRect, const Color &theColor, int theDrawMode)
+{
+	if ((theRect.mWidth <= 0) || (theRect.mHeight <= 0))
+		return;
+
+	mDisplayList->AddCommand(DisplayList::CMD_FILLRECT, theColor, theDrawMode).mDestRect = theRect;
+}
+
+void DisplayListRecorder::DrawRect(const Rect &theRect, const Color &theColor, int theDrawMode)
+{
+	mDisplayList->AddCommand(DisplayList::CMD_DRAWRECT, theColor, theDrawMode).mDestRect = theRect;
+}
+
+void DisplayListRecorder::ClearRect(const Rect &theRect)
+{
+	if ((theRect.mWidth <= 0) || (theRect.mHeight <= 0))
+		return;
+
+	mDisplayList->AddCommand(DisplayList::CMD_CLEARRECT, Color::White, Graphics::DRAWMODE_NORMAL).mDestRect =
+		theRect;
+}
+
+void DisplayListRecorder::DrawLine(double theStartX, double theStartY, double theEndX, double theEndY,
+								   const Color &theColor, int theDrawMode)
+{
+	DisplayList::Command &aCommand = mDisplayList->AddCommand(DisplayList::CMD_DRAWLINE, theColor, theDrawMode);
+	aCommand.mX = theStartX;
+	aCommand.mY = theStartY;
+	aCommand.mX2 = theEndX;
+	aCommand.mY2 = theEndY;
+}
+
+void DisplayListRecorder::DrawLineAA(double theStartX, double theStartY, double theEndX, double theEndY,
+									 const Color &theColor, int theDrawMode)
+{
+	DisplayList::Command &aCommand = mDisplayList->AddCommand(DisplayList::CMD_DRAWLINEAA, theColor, theDrawMode);
+	aCommand.mX = theStartX;
+	aCommand.mY = theStartY;
+	aCommand.mX2 = theEndX;
+	aCommand.mY2 = theEndY;
+}
+
+void DisplayListRecorder::FillScanLines(Span *theSpans, int theSpanCount, const Color &theColor, int theDrawMode)
+{
+	mDisplayList->mComplete = false;
+}
+
+void DisplayListRecorder::FillScanLinesWithCoverage(Span *theSpans, int theSpanCount, const Color &theColor,
+													int theDrawMode, const BYTE *theCoverage, int theCoverX,
+													int theCoverY, int theCoverWidth, int theCoverHeight)
+{
+	mDisplayList->mComplete = false;
+}
+
+void DisplayListRecorder::Blt(Image *theImage, int theX, int theY, const Rect &theSrcRect, const Color &theColor,
+							  int theDrawMode)
+{
+	DisplayList::Command &aCommand = mDisplayList->AddCommand(DisplayList::CMD_BLT, theColor, theDrawMode);
+	aCommand.mImage = theImage;
+	aCommand.mDestRect = Rect(theX, theY, theSrcRect.mWidth, theSrcRect.mHeight);
+	aCommand.mSrcRect = theSrcRect;
+}
+
+void DisplayListRecorder::BltF(Image *theImage, float theX, float theY, const Rect &theSrcRect,
+							   const Rect &theClipRect, const Color &theColor, int theDrawMode)
+{
+	DisplayList::Command &aCommand = mDisplayList->AddCommand(DisplayList::CMD_BLTF, theColor, theDrawMode);
+	aCommand.mImage = theImage;
+	aCommand.mSrcRect = theSrcRect;
+	aCommand.mClipRect = theClipRect;
+	aCommand.mX = theX;
+	aCommand.mY = theY;
+}
+
+void DisplayListRecorder::BltRotated(Image *theImage, float theX, float theY, const Rect &theSrcRect,
+									 const Rect &theClipRect, const Color &theColor, int theDrawMode, double theRot,
+									 float theRotCenterX, float theRotCenterY)
+{
+	DisplayList::Command &aCommand = mDisplayList->AddCommand(DisplayList::CMD_BLTROTATED, theColor, theDrawMode);
+	aCommand.mImage = theImage;
+	aCommand.mSrcRect = theSrcRect;
+	aCommand.mClipRect = theClipRect;
+	aCommand.mX = theX;
+	aCommand.mY = theY;
+	aCommand.mX2 = theRotCenterX;
+	aCommand.mY2 = theRotCenterY;
+	aCommand.mRot = theRot;
+}
+
+void DisplayListRecorder::StretchBlt(Image *theImage, const Rect &theDestRect, const Rect &theSrcRect,
+									 const Rect &theClipRect, const Color &theColor, int theDrawMode,
+									 bool fastStretch)
+{
+	DisplayList::Command &aCommand = mDisplayList->AddCommand(DisplayList::CMD_STRETCHBLT, theColor, theDrawMode);
+	aCommand.mImage = theImage;
+	aCommand.mDestRect = theDestRect;
+	aCommand.mSrcRect = theSrcRect;
+	aCommand.mClipRect = theClipRect;
+	aCommand.mFastStretch = fastStretch;
+}
+
+void DisplayListRecorder::BltMatrix(Image *theImage, float x, float y, const Matrix3 &theMatrix,
+									const Rect &theClipRect, const Color &theColor, int theDrawMode,
+									const Rect &theSrcRect, bool blend)
+{
+	mDisplayList->mComplete = false;
+}
+
+void DisplayListRecorder::BltTrianglesTex(Image *theTexture, const TriVertex theVertices[][3], int theNumTriangles,
+										  const Rect &theClipRect, const Color &theColor, int theDrawMode, float tx,
+										  float ty, bool blend)
+{
+	mDisplayList->mComplete = false;
+}
+
+void DisplayListRecorder::BltMirror(Image *theImage, int theX, int theY, const Rect &theSrcRect,
+									const Color &theColor, int theDrawMode)
+{
+	DisplayList::Command &aCommand = mDisplayList->AddCommand(DisplayList::CMD_BLTMIRROR, theColor, theDrawMode);
+	aCommand.mImage = theImage;
+	aCommand.mDestRect = Rect(theX, theY, theSrcRect.mWidth, theSrcRect.mHeight);
+	aCommand.mSrcRect = theSrcRect;
+}
+
+void DisplayListRecorder::StretchBltMirror(Image *theImage, const Rect &theDestRect, const Rect &theSrcRect,
+										   const Rect &theClipRect, const Color &theColor, int theDrawMode,
+										   bool fastStretch)
+{
+	DisplayList::Command &aCommand =
+		mDisplayList->AddCommand(DisplayList::CMD_STRETCHBLTMIRROR, theColor, theDrawMode);
+	aCommand.mImage = theImage;
+	aCommand.mDestRect = theDestRect;
+	aCommand.mSrcRect = theSrcRect;
+	aCommand.mClipRect = theClipRect;
+	aCommand.mFastStretch = fastStretch;
+}
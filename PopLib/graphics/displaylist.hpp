@@ -0,0 +1,138 @@
+#ifndef __DISPLAYLIST_HPP__
+#define __DISPLAYLIST_HPP__
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "common.hpp"
+#include "image.hpp"
+
+namespace PopLib
+{
+
+class Graphics;
+class Font;
+
+/// <summary>
+/// A recorded sequence of draw calls that can be replayed into any Graphics. Calls are captured at the Image level,
+/// after the recording Graphics has resolved transforms and clipping, so replaying is a straight walk over the
+/// commands. Text is the exception: it is kept as a DrawString call and laid out by its font again at replay, since
+/// font glyph caches and scaled layers can change in between. Replay goes through the destination image's Blt calls
+/// and batches like any other drawing. Recorded images and fonts are referenced, not owned: the owner must re-record
+/// when any of them goes away.
+/// </summary>
+class DisplayList
+{
+  public:
+	enum
+	{
+		CMD_FILLRECT,
+		CMD_DRAWRECT,
+		CMD_CLEARRECT,
+		CMD_DRAWLINE,
+		CMD_DRAWLINEAA,
+		CMD_BLT,
+		CMD_BLTF,
+		CMD_BLTROTATED,
+		CMD_BLTMIRROR,
+		CMD_STRETCHBLT,
+		CMD_STRETCHBLTMIRROR,
+		CMD_DRAWSTRING
+	};
+
+	struct Command
+	{
+		int mType;
+		int mDrawMode;
+		Color mColor;
+		Image *mImage;
+		Font *mFont;		// DrawString only, with mString drawn at mX, mY
+		PopString mString;
+		Rect mDestRect; // the rect for fills, the destination for stretches, x and y for Blt and BltMirror
+		Rect mSrcRect;
+		Rect mClipRect;
+		double mX; // BltF/BltRotated position, line start
+		double mY;
+		double mX2; // line end, BltRotated center
+		double mY2;
+		double mRot;
+		bool mFastStretch;
+	};
+
+	typedef std::vector<Command> CommandVector;
+
+  public:
+	CommandVector mCommands;
+	bool mComplete; // false when something was drawn that can't be recorded, the list can't stand in for the draw
+
+  protected:
+	static Rect TranslateRect(const Rect &theRect, Graphics *g);
+
+  public:
+	DisplayList();
+
+	void Clear();
+	Command &AddCommand(int theType, const Color &theColor, int theDrawMode);
+	void AddString(Font *theFont, const PopString &theString, int theX, int theY, const Color &theColor,
+				   const Rect &theClipRect, int theDrawMode);
+
+	void Draw(Graphics *g);
+	void Draw(Graphics *g, const Color &theColor);
+};
+
+/// <summary>
+/// Image that records everything drawn on it into a DisplayList instead of drawing it
+/// </summary>
+class DisplayListRecorder : public Image
+{
+  public:
+	enum
+	{
+		UNCLIPPED_SIZE = 1 << 20
+	};
+
+	DisplayList *mDisplayList;
+
+  public:
+	DisplayListRecorder(DisplayList *theDisplayList, int theWidth, int theHeight);
+
+	void Attach(Graphics *g);
+
+	virtual bool PolyFill3D(const Point theVertices[], int theNumVertices, const Rect *theClipRect,
+							const Color &theColor, int theDrawMode, int tx, int ty, bool convex);
+
+	virtual void FillRect(const Rect &theRect, const Color &theColor, int theDrawMode);
+	virtual void DrawRect(const Rect &theRect, const Color &theColor, int theDrawMode);
+	virtual void ClearRect(const Rect &theRect);
+	virtual void DrawLine(double theStartX, double theStartY, double theEndX, double theEndY, const Color &theColor,
+						  int theDrawMode);
+	virtual void DrawLineAA(double theStartX, double theStartY, double theEndX, double theEndY, const Color &theColor,
+							int theDrawMode);
+	virtual void FillScanLines(Span *theSpans, int theSpanCount, const Color &theColor, int theDrawMode);
+	virtual void FillScanLinesWithCoverage(Span *theSpans, int theSpanCount, const Color &theColor, int theDrawMode,
+										   const BYTE *theCoverage, int theCoverX, int theCoverY, int theCoverWidth,
+										   int theCoverHeight);
+	virtual void Blt(Image *theImage, int theX, int theY, const Rect &theSrcRect, const Color &theColor,
+					 int theDrawMode);
+	virtual void BltF(Image *theImage, float theX, float theY, const Rect &theSrcRect, const Rect &theClipRect,
+					  const Color &theColor, int theDrawMode);
+	virtual void BltRotated(Image *theImage, float theX, float theY, const Rect &theSrcRect, const Rect &theClipRect,
+							const Color &theColor, int theDrawMode, double theRot, float theRotCenterX,
+							float theRotCenterY);
+	virtual void StretchBlt(Image *theImage, const Rect &theDestRect, const Rect &theSrcRect, const Rect &theClipRect,
+							const Color &theColor, int theDrawMode, bool fastStretch);
+	virtual void BltMatrix(Image *theImage, float x, float y, const Matrix3 &theMatrix, const Rect &theClipRect,
+						   const Color &theColor, int theDrawMode, const Rect &theSrcRect, bool blend);
+	virtual void BltTrianglesTex(Image *theTexture, const TriVertex theVertices[][3], int theNumTriangles,
+								 const Rect &theClipRect, const Color &theColor, int theDrawMode, float tx, float ty,
+								 bool blend);
+
+	virtual void BltMirror(Image *theImage, int theX, int theY, const Rect &theSrcRect, const Color &theColor,
+						   int theDrawMode);
+	virtual void StretchBltMirror(Image *theImage, const Rect &theDestRect, const Rect &theSrcRect,
+								  const Rect &theClipRect, const Color &theColor, int theDrawMode, bool fastStretch);
+};
+
+} // namespace PopLib
+
+#endif // __DISPLAYLIST_HPP__
@@ -1,20 +1,26 @@
 #include "font.hpp"
 #include "image.hpp"
 
+#include <atomic>
+
 using namespace PopLib;
 
+static std::atomic<uint32_t> gNextFontLayoutId(1);
+
 Font::Font()
 {
 	mAscent = 0;
 	mHeight = 0;
 	mAscentPadding = 0;
 	mLineSpacingOffset = 0;
+	mLayoutId = gNextFontLayoutId++;
 }
 
 Font::Font(const Font &theFont)
 	: mAscent(theFont.mAscent), mHeight(theFont.mHeight), mAscentPadding(theFont.mAscentPadding),
 	  mLineSpacingOffset(theFont.mLineSpacingOffset)
 {
+	mLayoutId = gNextFontLayoutId++;
 }
 
 Font::~Font()
@@ -71,3 +77,11 @@ void Font::DrawString(Graphics *g, int theX, int theY, const PopString &theStrin
 					  const Rect &theClipRect)
 {
 }
+
+/// <summary>
+/// Call whenever the font starts measuring or drawing differently, so text layouts cached for it are not reused
+/// </summary>
+void Font::LayoutChanged()
+{
+	mLayoutId = gNextFontLayoutId++;
+}
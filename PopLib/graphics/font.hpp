@@ -20,6 +20,7 @@ class Font
 	int mAscentPadding; // How much space is above the avg uppercase char
 	int mHeight;
 	int mLineSpacingOffset; // This plus height should get added between lines
+	uint32_t mLayoutId;		// unique per font and metrics, keys cached text layouts
 
   public:
 	Font();
@@ -40,6 +41,8 @@ class Font
 							const Rect &theClipRect);
 
 	virtual Font *Duplicate() {return new Font(*this);};
+
+	void LayoutChanged();
 };
 
 } // namespace PopLib
@@ -3,6 +3,9 @@
 #include "sdlimage.hpp"
 #include "memoryimage.hpp"
 #include "math/matrix.hpp"
+#include "textlayout.hpp"
+#include "displaylist.hpp"
+#include "misc/autocrit.hpp"
 #include <math.h>
 
 using namespace PopLib;
@@ -37,6 +40,9 @@ void GraphicsState::CopyStateFrom(const GraphicsState *theState)
 Graphics::Graphics(const Graphics &theGraphics)
 {
 	CopyStateFrom(&theGraphics);
+	mStateStackSize = 0;
+	mRecordLayout = nullptr;
+	mRecordList = theGraphics.mRecordList;
 }
 
 Graphics::Graphics(Image *theDestImage)
@@ -54,6 +60,9 @@ Graphics::Graphics(Image *theDestImage)
 	mFastStretch = false;
 	mWriteColoredString = true;
 	mLinearBlend = false;
+	mStateStackSize = 0;
+	mRecordLayout = nullptr;
+	mRecordList = nullptr;
 
 	if (mDestImage == nullptr)
 	{
@@ -74,16 +83,30 @@ Graphics::~Graphics()
 
 void Graphics::PushState()
 {
-	mStateStack.push_back(GraphicsState());
-	mStateStack.back().CopyStateFrom(this);
+	if (mStateStackSize < MAX_INLINE_STATES)
+		mStateStack[mStateStackSize].CopyStateFrom(this);
+	else
+	{
+		mStateStackOverflow.push_back(GraphicsState());
+		mStateStackOverflow.back().CopyStateFrom(this);
+	}
+
+	mStateStackSize++;
 }
 
 void Graphics::PopState()
 {
-	if (mStateStack.size() > 0)
+	if (mStateStackSize > 0)
 	{
-		CopyStateFrom(&mStateStack.back());
-		mStateStack.pop_back();
+		mStateStackSize--;
+
+		if (mStateStackSize < MAX_INLINE_STATES)
+			CopyStateFrom(&mStateStack[mStateStackSize]);
+		else
+		{
+			CopyStateFrom(&mStateStackOverflow.back());
+			mStateStackOverflow.pop_back();
+		}
 	}
 }
 
@@ -645,7 +668,20 @@ void Graphics::DrawLineAA(int theStartX, int theStartY, int theEndX, int theEndY
 
 void Graphics::DrawString(const PopString &theString, int theX, int theY)
 {
-	if (mFont != nullptr)
+	if (mFont == nullptr)
+		return;
+
+	// recorded as text rather than as the glyph blits the font would make, see DisplayList. Replay doesn't carry a
+	// scale, so scaled text keeps the widget drawing directly.
+	if (mRecordList != nullptr)
+	{
+		if ((mScaleX != 1) || (mScaleY != 1))
+			mRecordList->mComplete = false;
+		else
+			mRecordList->AddString(mFont, theString, theX + (int)mTransX, theY + (int)mTransY, mColor, mClipRect,
+								   mDrawMode);
+	}
+	else
 		mFont->DrawString(this, theX, theY, theString, mColor, mClipRect);
 }
 
@@ -1097,7 +1133,8 @@ int Graphics::WriteString(const PopString &theString, int theX, int theY, int th
 	if (theOldColor == -1)
 		theOldColor = mColor.ToInt();
 
-	if (drawString)
+	// a recorded layout is justified when it is drawn
+	if (drawString && mRecordLayout == nullptr)
 	{
 		switch (theJustification)
 		{
@@ -1120,6 +1157,7 @@ int Graphics::WriteString(const PopString &theString, int theX, int theY, int th
 
 	PopString aString;
 	int aXOffset = 0;
+	int aFirstRun = (mRecordLayout != nullptr) ? (int)mRecordLayout->mRuns.size() : 0;
 
 	for (int i = theOffset; i < theLength; i++)
 	{
@@ -1135,10 +1173,14 @@ int Graphics::WriteString(const PopString &theString, int theX, int theY, int th
 			else // change color instruction
 			{
 				uint32_t aColor = 0;
+				bool isOldColor = false;
 				if (theString[i + 1] == 'o')
 				{
 					if (strncmp(theString.c_str() + i + 1, "oldclr", 6) == 0)
+					{
 						aColor = theOldColor;
+						isOldColor = true;
+					}
 				}
 				else
 				{
@@ -1158,7 +1200,12 @@ int Graphics::WriteString(const PopString &theString, int theX, int theY, int th
 					}
 				}
 
-				if (drawString)
+				if (drawString && mRecordLayout != nullptr)
+				{
+					mRecordLayout->AddRun(aString, theX + aXOffset, theY);
+					mRecordLayout->mCurColor = isOldColor ? TextLayout::COLOR_OLD : (int)(aColor & 0xFFFFFF);
+				}
+				else if (drawString)
 				{
 					DrawString(aString, theX + aXOffset, theY);
 					SetColor(Color((aColor >> 16) & 0xFF, (aColor >> 8) & 0xFF, (aColor) & 0xFF, GetColor().mAlpha));
@@ -1175,13 +1222,18 @@ int Graphics::WriteString(const PopString &theString, int theX, int theY, int th
 			aString += theString[i];
 	}
 
-	if (drawString)
+	if (drawString && mRecordLayout != nullptr)
+		mRecordLayout->AddRun(aString, theX + aXOffset, theY);
+	else if (drawString)
 	{
 		DrawString(aString, theX + aXOffset, theY);
 	}
 
 	aXOffset += GetFont()->StringWidth(aString);
 
+	if (drawString && mRecordLayout != nullptr)
+		mRecordLayout->SetLineWidth(aFirstRun, aXOffset);
+
 	return aXOffset;
 }
 
@@ -1213,6 +1265,27 @@ int Graphics::WriteWordWrapped(const Rect &theRect, const PopString &theLine, in
 
 	Font *aFont = GetFont();
 
+	// Whole strings without a carried-over indent are laid out once and then replayed from the layout cache.
+	// Partial strings (typewriter reveals) and flowed text take the direct path below.
+	if ((mRecordLayout == nullptr) && (aFont != nullptr) && (theLastWidth == nullptr) &&
+		(theMaxChars >= (int)theLine.length()))
+	{
+		if (theLineSpacing == -1)
+			theLineSpacing = aFont->GetLineSpacing();
+
+		TextLayoutPtr aLayout =
+			GetTextLayout(TextLayoutCache::LAYOUT_WORDWRAP, theRect.mWidth, theLineSpacing, theLine);
+
+		// measuring with a throwaway Graphics (see GetWordWrappedHeight) has nothing to draw
+		if (mDestImage != &mStaticImage)
+			aLayout->Draw(this, theRect.mX, theRect.mY, theJustification, anOrigColorInt, true);
+
+		if (theMaxWidth != nullptr)
+			*theMaxWidth = aLayout->mMaxWidth;
+
+		return aLayout->mHeight;
+	}
+
 	int aYOffset = aFont->GetAscent() - aFont->GetAscentPadding();
 
 	if (theLineSpacing == -1)
@@ -1272,7 +1345,16 @@ int Graphics::WriteWordWrapped(const Rect &theRect, const PopString &theLine, in
 				// theMaxChars);
 
 				int aPhysPos = theRect.mY + aYOffset + mTransY;
-				if ((aPhysPos >= mClipRect.mY) && (aPhysPos < mClipRect.mY + mClipRect.mHeight + theLineSpacing))
+				if (mRecordLayout != nullptr)
+				{
+					// recorded unconditionally, the clip test is repeated whenever the layout is drawn
+					mRecordLayout->mCullable = true;
+					WriteWordWrappedHelper(this, theLine, theRect.mX + anIndentX, theRect.mY + aYOffset, theRect.mWidth,
+										   theJustification, true, aLineStartPos, aSpacePos - aLineStartPos,
+										   anOrigColorInt, theMaxChars);
+					mRecordLayout->mCullable = false;
+				}
+				else if ((aPhysPos >= mClipRect.mY) && (aPhysPos < mClipRect.mY + mClipRect.mHeight + theLineSpacing))
 				{
 					WriteWordWrappedHelper(this, theLine, theRect.mX + anIndentX, theRect.mY + aYOffset, theRect.mWidth,
 										   theJustification, true, aLineStartPos, aSpacePos - aLineStartPos,
@@ -1363,7 +1445,67 @@ int Graphics::WriteWordWrapped(const Rect &theRect, const PopString &theLine, in
 
 int Graphics::DrawStringColor(const PopString &theLine, int theX, int theY, int theOldColor)
 {
-	return WriteString(theLine, theX, theY, -1, -1, true, 0, -1, theOldColor);
+	if ((mRecordLayout != nullptr) || (GetFont() == nullptr))
+		return WriteString(theLine, theX, theY, -1, -1, true, 0, -1, theOldColor);
+
+	if (theOldColor == -1)
+		theOldColor = mColor.ToInt();
+
+	TextLayoutPtr aLayout = GetTextLayout(TextLayoutCache::LAYOUT_COLOR, -1, 0, theLine);
+	aLayout->Draw(this, theX, theY, -1, theOldColor, false);
+
+	return aLayout->mMaxWidth;
+}
+
+/// <summary>
+/// Looks up the cached layout of theLine in the current font, recording it first if needed. The cache is only
+/// locked for the lookup and the insert, the result can be drawn from without it.
+/// </summary>
+TextLayoutPtr Graphics::GetTextLayout(int theType, int theWidth, int theLineSpacing, const PopString &theLine)
+{
+	TextLayoutCache::Key aKey;
+	aKey.mFontLayoutId = mFont->mLayoutId;
+	aKey.mType = theType;
+	aKey.mWidth = theWidth;
+	aKey.mLineSpacing = theLineSpacing;
+	aKey.mColored = mWriteColoredString;
+	aKey.mString = theLine;
+
+	{
+		AutoCrit anAutoCrit(gTextLayoutCache.mCritSect);
+		TextLayoutPtr aLayout = gTextLayoutCache.Find(aKey);
+		if (aLayout != nullptr)
+			return aLayout;
+	}
+
+	// recorded outside the lock, if another thread records the same text meanwhile the last one in is kept
+	TextLayoutPtr aLayout = std::make_shared<TextLayout>();
+	aLayout->mWidth = theWidth;
+	aLayout->mLineSpacing = theLineSpacing;
+
+	// run the normal text code once against a recording Graphics at the origin
+	Graphics aRecordG;
+	aRecordG.SetFont(mFont);
+	aRecordG.mWriteColoredString = mWriteColoredString;
+	aRecordG.mRecordLayout = aLayout.get();
+
+	if (theType == TextLayoutCache::LAYOUT_WORDWRAP)
+	{
+		int aMaxWidth = 0;
+		aLayout->mHeight = aRecordG.WriteWordWrapped(Rect(0, 0, theWidth, 0), theLine, theLineSpacing, -1, &aMaxWidth);
+		aLayout->mMaxWidth = aMaxWidth;
+	}
+	else
+	{
+		aLayout->mMaxWidth = aRecordG.WriteString(theLine, 0, 0, -1, -1, true, 0, -1, 0);
+		aLayout->mHeight = 0;
+	}
+
+	aLayout->mEndColor = aLayout->mCurColor;
+
+	AutoCrit anAutoCrit(gTextLayoutCache.mCritSect);
+	gTextLayoutCache.Add(aKey, aLayout);
+	return aLayout;
 }
 
 int Graphics::DrawStringWordWrapped(const PopString &theLine, int theX, int theY, int theWrapWidth,
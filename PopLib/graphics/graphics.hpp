@@ -10,14 +10,19 @@
 #include "image.hpp"
 #include "math/trivertex.hpp"
 
+#include <memory>
+
 namespace PopLib
 {
 
 class Font;
+class TextLayout;
+class DisplayList;
 class Matrix3;
 class Transform;
 
 const int MAX_TEMP_SPANS = 8192;
+const int MAX_INLINE_STATES = 8; // PushState depth kept inside the Graphics itself
 
 struct Edge
 {
@@ -54,10 +59,12 @@ class GraphicsState
 	void CopyStateFrom(const GraphicsState *theState);
 };
 
-typedef std::list<GraphicsState> GraphicsStateList;
+typedef std::vector<GraphicsState> GraphicsStateVector;
 
 class Graphics : public GraphicsState
 {
+	friend class DisplayList;
+
   public:
 	enum
 	{
@@ -70,7 +77,14 @@ class Graphics : public GraphicsState
 	static const Point *mPFPoints;
 	int mPFNumVertices;
 
-	GraphicsStateList mStateStack;
+	// PushState history. The first MAX_INLINE_STATES live inline so pushing, popping and copying a Graphics never
+	// touch the heap, deeper nesting spills into mStateStackOverflow.
+	GraphicsState mStateStack[MAX_INLINE_STATES];
+	int mStateStackSize;
+	GraphicsStateVector mStateStackOverflow;
+
+	TextLayout *mRecordLayout; // when set, text calls record into it instead of drawing
+	DisplayList *mRecordList;  // when set, DrawString records into it instead of drawing, carried over to copies
 
   protected:
 	static int PFCompareInd(const void *u, const void *v);
@@ -81,6 +95,8 @@ class Graphics : public GraphicsState
 	void DrawImageTransformHelper(Image *theImage, const Transform &theTransform, const Rect &theSrcRect, float x,
 								  float y, bool useFloat);
 
+	std::shared_ptr<TextLayout> GetTextLayout(int theType, int theWidth, int theLineSpacing, const PopString &theLine);
+
   public:
 	Graphics(const Graphics &theGraphics);
 	Graphics(Image *theDestImage = NULL);
@@ -6,6 +6,8 @@
 #include "sdlimage.hpp"
 #include "misc/autocrit.hpp"
 
+#include <algorithm>
+
 using namespace PopLib;
 
 DataElement::DataElement() : mIsList(false)
@@ -76,13 +78,73 @@ DataElement *ListDataElement::Duplicate()
 
 ///
 
+// Reads one character from theString and advances theIndex past it. Well-formed UTF-8 sequences decode to their
+// codepoint, any other byte is taken as Latin-1 so existing 8-bit strings still draw as before.
+static uint32_t ReadChar(const PopString &theString, ulong &theIndex)
+{
+	uchar aLead = (uchar)theString[theIndex++];
+	if (aLead < 0x80)
+		return aLead;
+
+	int aLength;
+	uint32_t aChar;
+	if ((aLead & 0xE0) == 0xC0)
+	{
+		aLength = 1;
+		aChar = aLead & 0x1F;
+	}
+	else if ((aLead & 0xF0) == 0xE0)
+	{
+		aLength = 2;
+		aChar = aLead & 0x0F;
+	}
+	else if ((aLead & 0xF8) == 0xF0)
+	{
+		aLength = 3;
+		aChar = aLead & 0x07;
+	}
+	else
+		return aLead;
+
+	if (theIndex + aLength > theString.length())
+		return aLead;
+
+	for (int i = 0; i < aLength; i++)
+	{
+		uchar aByte = (uchar)theString[theIndex + i];
+		if ((aByte & 0xC0) != 0x80)
+			return aLead;
+		aChar = (aChar << 6) | (aByte & 0x3F);
+	}
+
+	static const uint32_t aMinChar[4] = {0, 0x80, 0x800, 0x10000};
+	if ((aChar < aMinChar[aLength]) || (aChar > 0x10FFFF))
+		return aLead;
+
+	theIndex += aLength;
+	return aChar;
+}
+
+// Splits a font descriptor string into exactly theCount characters
+static bool StringToChars(const std::string &theString, uint32_t *theChars, int theCount)
+{
+	ulong anIndex = 0;
+	for (int i = 0; i < theCount; i++)
+	{
+		if (anIndex >= theString.length())
+			return false;
+		theChars[i] = ReadChar(theString, anIndex);
+	}
+
+	return anIndex == theString.length();
+}
+
+static const CharData gEmptyCharData;
+
 CharData::CharData()
 {
 	mWidth = 0;
 	mOrder = 0;
-
-	for (ulong i = 0; i < 256; i++)
-		mKerningOffsets[i] = 0;
 }
 
 FontLayer::FontLayer(FontData *theFontData)
@@ -101,22 +163,85 @@ FontLayer::FontLayer(FontData *theFontData)
 	mColorAdd = Color(0, 0, 0, 0);
 	mLineSpacingOffset = 0;
 	mBaseOrder = 0;
+
+	for (int i = 0; i < 256; i++)
+		mLowCharIndex[i] = -1;
 }
 
 FontLayer::FontLayer(const FontLayer &theFontLayer)
 	: mFontData(theFontLayer.mFontData), mRequiredTags(theFontLayer.mRequiredTags),
-	  mExcludedTags(theFontLayer.mExcludedTags), mImage(theFontLayer.mImage), mDrawMode(theFontLayer.mDrawMode),
-	  mOffset(theFontLayer.mOffset), mSpacing(theFontLayer.mSpacing), mMinPointSize(theFontLayer.mMinPointSize),
-	  mMaxPointSize(theFontLayer.mMaxPointSize), mPointSize(theFontLayer.mPointSize), mAscent(theFontLayer.mAscent),
+	  mExcludedTags(theFontLayer.mExcludedTags), mCharData(theFontLayer.mCharData),
+	  mCharIndexMap(theFontLayer.mCharIndexMap), mKerningMap(theFontLayer.mKerningMap), mImage(theFontLayer.mImage),
+	  mDrawMode(theFontLayer.mDrawMode), mOffset(theFontLayer.mOffset), mSpacing(theFontLayer.mSpacing),
+	  mMinPointSize(theFontLayer.mMinPointSize), mMaxPointSize(theFontLayer.mMaxPointSize),
+	  mPointSize(theFontLayer.mPointSize), mAscent(theFontLayer.mAscent),
 	  mAscentPadding(theFontLayer.mAscentPadding), mHeight(theFontLayer.mHeight),
 	  mDefaultHeight(theFontLayer.mDefaultHeight), mColorMult(theFontLayer.mColorMult),
 	  mColorAdd(theFontLayer.mColorAdd), mLineSpacingOffset(theFontLayer.mLineSpacingOffset),
 	  mBaseOrder(theFontLayer.mBaseOrder)
 {
-	ulong i;
+	for (int i = 0; i < 256; i++)
+		mLowCharIndex[i] = theFontLayer.mLowCharIndex[i];
+}
+
+int FontLayer::GetCharIndex(uint32_t theChar) const
+{
+	if (theChar < 256)
+		return mLowCharIndex[theChar];
+
+	CharIndexMap::const_iterator anItr = mCharIndexMap.find(theChar);
+	if (anItr != mCharIndexMap.end())
+		return anItr->second;
 
-	for (i = 0; i < 256; i++)
-		mCharData[i] = theFontLayer.mCharData[i];
+	return -1;
+}
+
+/// Chars the layer doesn't define come back as an empty glyph, never nullptr
+const CharData *FontLayer::GetCharData(uint32_t theChar) const
+{
+	int anIndex = GetCharIndex(theChar);
+	if (anIndex < 0)
+		return &gEmptyCharData;
+
+	return &mCharData[anIndex];
+}
+
+CharData *FontLayer::AddCharData(uint32_t theChar)
+{
+	int anIndex = GetCharIndex(theChar);
+	if (anIndex < 0)
+	{
+		anIndex = (int)mCharData.size();
+		mCharData.push_back(CharData());
+
+		if (theChar < 256)
+			mLowCharIndex[theChar] = anIndex;
+		else
+			mCharIndexMap[theChar] = anIndex;
+	}
+
+	return &mCharData[anIndex];
+}
+
+int FontLayer::GetKerning(uint32_t theChar, uint32_t theNextChar) const
+{
+	if (mKerningMap.empty())
+		return 0;
+
+	KerningMap::const_iterator anItr = mKerningMap.find(((uint64_t)theChar << 32) | theNextChar);
+	if (anItr != mKerningMap.end())
+		return anItr->second;
+
+	return 0;
+}
+
+void FontLayer::SetKerning(uint32_t theChar, uint32_t theNextChar, int theOffset)
+{
+	uint64_t aKey = ((uint64_t)theChar << 32) | theNextChar;
+	if (theOffset != 0)
+		mKerningMap[aKey] = theOffset;
+	else
+		mKerningMap.erase(aKey);
 }
 
 FontData::FontData()
@@ -126,9 +251,7 @@ FontData::FontData()
 	mApp = nullptr;
 	mRefCount = 0;
 	mDefaultPointSize = 0;
-
-	for (ulong i = 0; i < 256; i++)
-		mCharMap[i] = (uchar)i;
+	mScaledLayerUseCount = 0;
 }
 
 FontData::~FontData()
@@ -142,6 +265,13 @@ FontData::~FontData()
 		delete aDataElement;
 		++anItr;
 	}
+
+	ScaledFontLayerMap::iterator aScaledItr = mScaledLayerMap.begin();
+	while (aScaledItr != mScaledLayerMap.end())
+	{
+		delete aScaledItr->second;
+		++aScaledItr;
+	}
 }
 
 void FontData::Ref()
@@ -360,9 +490,16 @@ bool FontData::HandleCommand(const ListDataElement &theParams)
 				{
 					for (ulong aMapIdx = 0; aMapIdx < aFromVector.size(); aMapIdx++)
 					{
-						if ((aFromVector[aMapIdx].length() == 1) && (aToVector[aMapIdx].length() == 1))
+						uint32_t aFromChar;
+						uint32_t aToChar;
+
+						if ((StringToChars(aFromVector[aMapIdx], &aFromChar, 1)) &&
+							(StringToChars(aToVector[aMapIdx], &aToChar, 1)))
 						{
-							mCharMap[(uchar)aFromVector[aMapIdx][0]] = (uchar)aToVector[aMapIdx][0];
+							if (aFromChar != aToChar)
+								mCharMap[aFromChar] = aToChar;
+							else
+								mCharMap.erase(aFromChar);
 						}
 						else
 							invalidParamFormat = true;
@@ -714,9 +851,10 @@ bool FontData::HandleCommand(const ListDataElement &theParams)
 				{
 					for (ulong i = 0; i < aCharsVector.size(); i++)
 					{
-						if (aCharsVector[i].length() == 1)
+						uint32_t aChar;
+						if (StringToChars(aCharsVector[i], &aChar, 1))
 						{
-							aLayer->mCharData[(uchar)aCharsVector[i][0]].mWidth = aCharWidthsVector[i];
+							aLayer->AddCharData(aChar)->mWidth = aCharWidthsVector[i];
 						}
 						else
 							invalidParamFormat = true;
@@ -777,8 +915,9 @@ bool FontData::HandleCommand(const ListDataElement &theParams)
 						for (ulong i = 0; i < aCharsVector.size(); i++)
 						{
 							IntVector aRectElement;
+							uint32_t aChar;
 
-							if ((aCharsVector[i].length() == 1) &&
+							if ((StringToChars(aCharsVector[i], &aChar, 1)) &&
 								(DataToIntVector(aRectList.mElementVector[i], &aRectElement)) &&
 								(aRectElement.size() == 4))
 
@@ -792,15 +931,14 @@ bool FontData::HandleCommand(const ListDataElement &theParams)
 									return false;
 								}
 
-								aLayer->mCharData[(uchar)aCharsVector[i][0]].mImageRect = aRect;
-								;
+								aLayer->AddCharData(aChar)->mImageRect = aRect;
 							}
 							else
 								invalidParamFormat = true;
 						}
 
 						aLayer->mDefaultHeight = 0;
-						for (int aCharNum = 0; aCharNum < 256; aCharNum++)
+						for (ulong aCharNum = 0; aCharNum < aLayer->mCharData.size(); aCharNum++)
 							if (aLayer->mCharData[aCharNum].mImageRect.mHeight +
 									aLayer->mCharData[aCharNum].mOffset.mY >
 								aLayer->mDefaultHeight)
@@ -839,12 +977,12 @@ bool FontData::HandleCommand(const ListDataElement &theParams)
 					for (ulong i = 0; i < aCharsVector.size(); i++)
 					{
 						IntVector aRectElement;
+						uint32_t aChar;
 
-						if ((aCharsVector[i].length() == 1) &&
+						if ((StringToChars(aCharsVector[i], &aChar, 1)) &&
 							(DataToIntVector(aRectList.mElementVector[i], &aRectElement)) && (aRectElement.size() == 2))
 						{
-							aLayer->mCharData[(uchar)aCharsVector[i][0]].mOffset =
-								Point(aRectElement[0], aRectElement[1]);
+							aLayer->AddCharData(aChar)->mOffset = Point(aRectElement[0], aRectElement[1]);
 						}
 						else
 							invalidParamFormat = true;
@@ -875,10 +1013,10 @@ bool FontData::HandleCommand(const ListDataElement &theParams)
 				{
 					for (ulong i = 0; i < aPairsVector.size(); i++)
 					{
-						if (aPairsVector[i].length() == 2)
+						uint32_t aPair[2];
+						if (StringToChars(aPairsVector[i], aPair, 2))
 						{
-							aLayer->mCharData[(uchar)aPairsVector[i][0]].mKerningOffsets[(uchar)aPairsVector[i][1]] =
-								anOffsetsVector[i];
+							aLayer->SetKerning(aPair[0], aPair[1], anOffsetsVector[i]);
 						}
 						else
 							invalidParamFormat = true;
@@ -930,9 +1068,10 @@ bool FontData::HandleCommand(const ListDataElement &theParams)
 				{
 					for (ulong i = 0; i < aCharsVector.size(); i++)
 					{
-						if (aCharsVector[i].length() == 1)
+						uint32_t aChar;
+						if (StringToChars(aCharsVector[i], &aChar, 1))
 						{
-							aLayer->mCharData[(uchar)aCharsVector[i][0]].mOrder = aCharOrdersVector[i];
+							aLayer->AddCharData(aChar)->mOrder = aCharOrdersVector[i];
 						}
 						else
 							invalidParamFormat = true;
@@ -1033,7 +1172,7 @@ bool FontData::LoadLegacy(Image *theFontImage, const std::string &theFontDescFil
 	mSourceFile = theFontDescFileName;
 
 	int aSpaceWidth = 0;
-	fscanf(aStream, "%d%d", &aFontLayer->mCharData[' '].mWidth, &aFontLayer->mAscent);
+	fscanf(aStream, "%d%d", &aFontLayer->AddCharData(' ')->mWidth, &aFontLayer->mAscent);
 
 	while (!feof(aStream))
 	{
@@ -1047,8 +1186,9 @@ bool FontData::LoadLegacy(Image *theFontImage, const std::string &theFontDescFil
 		if (aChar == 0)
 			break;
 
-		aFontLayer->mCharData[(uchar)aChar].mImageRect = Rect(aCharPos, 0, aWidth, aFontLayer->mImage->GetHeight());
-		aFontLayer->mCharData[(uchar)aChar].mWidth = aWidth;
+		CharData *aCharData = aFontLayer->AddCharData((uchar)aChar);
+		aCharData->mImageRect = Rect(aCharPos, 0, aWidth, aFontLayer->mImage->GetHeight());
+		aCharData->mWidth = aWidth;
 
 		aCharPos += aWidth;
 	}
@@ -1056,11 +1196,11 @@ bool FontData::LoadLegacy(Image *theFontImage, const std::string &theFontDescFil
 	char c;
 
 	for (c = 'A'; c <= 'Z'; c++)
-		if ((aFontLayer->mCharData[c].mWidth == 0) && (aFontLayer->mCharData[c - 'A' + 'a'].mWidth != 0))
+		if ((aFontLayer->GetCharData(c)->mWidth == 0) && (aFontLayer->GetCharData(c - 'A' + 'a')->mWidth != 0))
 			mCharMap[c] = c - 'A' + 'a';
 
 	for (c = 'a'; c <= 'z'; c++)
-		if ((aFontLayer->mCharData[c].mWidth == 0) && (aFontLayer->mCharData[c - 'a' + 'A'].mWidth != 0))
+		if ((aFontLayer->GetCharData(c)->mWidth == 0) && (aFontLayer->GetCharData(c - 'a' + 'A')->mWidth != 0))
 			mCharMap[c] = c - 'a' + 'A';
 
 	mInitialized = true;
@@ -1069,29 +1209,239 @@ bool FontData::LoadLegacy(Image *theFontImage, const std::string &theFontDescFil
 	return true;
 }
 
+uint32_t FontData::MapChar(uint32_t theChar) const
+{
+	if (mCharMap.empty())
+		return theChar;
+
+	CharMap::const_iterator anItr = mCharMap.find(theChar);
+	if (anItr != mCharMap.end())
+		return anItr->second;
+
+	return theChar;
+}
+
+////
+
+ScaledFontLayer::ScaledFontLayer()
+{
+	mImage = nullptr;
+	mOwnsImage = false;
+	mRefCount = 0;
+	mLastUsed = 0;
+}
+
+ScaledFontLayer::~ScaledFontLayer()
+{
+	if (mOwnsImage)
+		delete mImage;
+}
+
+bool ScaledFontLayerKey::operator<(const ScaledFontLayerKey &theKey) const
+{
+	if (mFontLayer != theKey.mFontLayer)
+		return mFontLayer < theKey.mFontLayer;
+	if (mPointSize != theKey.mPointSize)
+		return mPointSize < theKey.mPointSize;
+	return mForceWhite < theKey.mForceWhite;
+}
+
+/// <summary>
+/// Returns theFontLayer resized to thePointSize (-1 for its own image), building it the first time any ImageFont
+/// asks for that size. The result is referenced; give it back with ReleaseScaledLayer. Safe to call from a loader
+/// thread, e.g. through ImageFont::Prepare.
+/// </summary>
+ScaledFontLayer *FontData::GetScaledLayer(FontLayer *theFontLayer, double thePointSize, bool forceWhite)
+{
+	AutoCrit anAutoCrit(mScaledLayerCritSect);
+
+	ScaledFontLayerKey aKey;
+	aKey.mFontLayer = theFontLayer;
+	aKey.mPointSize = thePointSize;
+	aKey.mForceWhite = forceWhite;
+
+	ScaledFontLayerMap::iterator anItr = mScaledLayerMap.find(aKey);
+	if (anItr != mScaledLayerMap.end())
+	{
+		anItr->second->mRefCount++;
+		anItr->second->mLastUsed = ++mScaledLayerUseCount;
+		return anItr->second;
+	}
+
+	ScaledFontLayer *aScaledLayer = new ScaledFontLayer();
+	aScaledLayer->mRefCount = 1;
+	aScaledLayer->mLastUsed = ++mScaledLayerUseCount;
+	mScaledLayerMap[aKey] = aScaledLayer;
+
+	ulong aCharNum;
+	ulong aNumChars = theFontLayer->mCharData.size();
+	aScaledLayer->mCharImageRects.resize(aNumChars);
+
+	if (thePointSize < 0)
+	{
+		aScaledLayer->mImage = theFontLayer->mImage;
+		aScaledLayer->mOwnsImage = false;
+
+		for (aCharNum = 0; aCharNum < aNumChars; aCharNum++)
+			aScaledLayer->mCharImageRects[aCharNum] = theFontLayer->mCharData[aCharNum].mImageRect;
+
+		return aScaledLayer;
+	}
+
+	double aPointSize = thePointSize;
+	double aLayerPointSize = 1;
+	if (theFontLayer->mPointSize != 0)
+		aLayerPointSize = theFontLayer->mPointSize;
+
+	// Resize font elements
+	MemoryImage *aMemoryImage = new MemoryImage(mApp);
+
+	// Glyphs are laid out in rows so large character sets don't produce one absurdly wide image
+	const int aMaxRowWidth = 2048;
+	int aCurX = 0;
+	int aCurY = 0;
+	int aRowHeight = 0;
+	int aMaxWidth = 0;
+
+	for (aCharNum = 0; aCharNum < aNumChars; aCharNum++)
+	{
+		Rect *anOrigRect = &theFontLayer->mCharData[aCharNum].mImageRect;
+
+		int aScaledWidth = (int)((anOrigRect->mWidth * aPointSize) / aLayerPointSize);
+		int aScaledHeight = (int)((anOrigRect->mHeight * aPointSize) / aLayerPointSize);
+
+		if ((aCurX > 0) && (aCurX + aScaledWidth > aMaxRowWidth))
+		{
+			aCurX = 0;
+			aCurY += aRowHeight;
+			aRowHeight = 0;
+		}
+
+		Rect aScaledRect(aCurX, aCurY, aScaledWidth, aScaledHeight);
+
+		aScaledLayer->mCharImageRects[aCharNum] = aScaledRect;
+
+		if (aScaledRect.mHeight > aRowHeight)
+			aRowHeight = aScaledRect.mHeight;
+
+		aCurX += aScaledRect.mWidth;
+		if (aCurX > aMaxWidth)
+			aMaxWidth = aCurX;
+	}
+
+	aScaledLayer->mImage = aMemoryImage;
+	aScaledLayer->mOwnsImage = true;
+
+	// Create the image now
+
+	aMemoryImage->Create(aMaxWidth, aCurY + aRowHeight);
+
+	Graphics g(aMemoryImage);
+
+	for (aCharNum = 0; aCharNum < aNumChars; aCharNum++)
+	{
+		if ((Image *)theFontLayer->mImage != nullptr)
+			g.DrawImage(theFontLayer->mImage, aScaledLayer->mCharImageRects[aCharNum],
+						theFontLayer->mCharData[aCharNum].mImageRect);
+	}
+
+	if (forceWhite)
+	{
+		int aCount = aMemoryImage->mWidth * aMemoryImage->mHeight;
+		ulong *aBits = aMemoryImage->GetBits();
+
+		for (int i = 0; i < aCount; i++)
+			*(aBits++) = *aBits | 0x00FFFFFF;
+	}
+
+	aMemoryImage->Palletize();
+
+	return aScaledLayer;
+}
+
+/// <summary>
+/// Drops a reference taken by GetScaledLayer. A few unused sizes are kept around so fonts that flip between sizes
+/// don't rebuild them every time, older ones are freed.
+/// </summary>
+void FontData::ReleaseScaledLayer(ScaledFontLayer *theScaledLayer)
+{
+	AutoCrit anAutoCrit(mScaledLayerCritSect);
+
+	if (--theScaledLayer->mRefCount > 0)
+		return;
+
+	const int aMaxUnusedLayers = 8;
+
+	for (;;)
+	{
+		int aNumUnused = 0;
+		ScaledFontLayerMap::iterator anOldestItr = mScaledLayerMap.end();
+
+		ScaledFontLayerMap::iterator anItr = mScaledLayerMap.begin();
+		while (anItr != mScaledLayerMap.end())
+		{
+			if (anItr->second->mRefCount <= 0)
+			{
+				aNumUnused++;
+				if ((anOldestItr == mScaledLayerMap.end()) ||
+					(anItr->second->mLastUsed < anOldestItr->second->mLastUsed))
+					anOldestItr = anItr;
+			}
+			++anItr;
+		}
+
+		if (aNumUnused <= aMaxUnusedLayers)
+			break;
+
+		delete anOldestItr->second;
+		mScaledLayerMap.erase(anOldestItr);
+	}
+}
+
 ////
 
 ActiveFontLayer::ActiveFontLayer()
 {
+	mBaseFontLayer = nullptr;
+	mScaledLayer = nullptr;
 	mScaledImage = nullptr;
-	mOwnsImage = false;
 }
 
 ActiveFontLayer::ActiveFontLayer(const ActiveFontLayer &theActiveFontLayer)
-	: mBaseFontLayer(theActiveFontLayer.mBaseFontLayer), mScaledImage(theActiveFontLayer.mScaledImage),
-	  mOwnsImage(theActiveFontLayer.mOwnsImage)
+	: mBaseFontLayer(theActiveFontLayer.mBaseFontLayer), mScaledLayer(theActiveFontLayer.mScaledLayer),
+	  mScaledImage(theActiveFontLayer.mScaledImage)
 {
-	if (mOwnsImage)
-		mScaledImage = mBaseFontLayer->mFontData->mApp->CopyImage(mScaledImage);
+	if (mScaledLayer != nullptr)
+	{
+		AutoCrit anAutoCrit(mBaseFontLayer->mFontData->mScaledLayerCritSect);
+		mScaledLayer->mRefCount++;
+	}
+}
+
+ActiveFontLayer &ActiveFontLayer::operator=(const ActiveFontLayer &theActiveFontLayer)
+{
+	if (this == &theActiveFontLayer)
+		return *this;
+
+	if (theActiveFontLayer.mScaledLayer != nullptr)
+	{
+		AutoCrit anAutoCrit(theActiveFontLayer.mBaseFontLayer->mFontData->mScaledLayerCritSect);
+		theActiveFontLayer.mScaledLayer->mRefCount++;
+	}
 
-	for (int aCharNum = 0; aCharNum < 256; aCharNum++)
-		mScaledCharImageRects[aCharNum] = theActiveFontLayer.mScaledCharImageRects[aCharNum];
+	if (mScaledLayer != nullptr)
+		mBaseFontLayer->mFontData->ReleaseScaledLayer(mScaledLayer);
+
+	mBaseFontLayer = theActiveFontLayer.mBaseFontLayer;
+	mScaledLayer = theActiveFontLayer.mScaledLayer;
+	mScaledImage = theActiveFontLayer.mScaledImage;
+	return *this;
 }
 
 ActiveFontLayer::~ActiveFontLayer()
 {
-	if (mOwnsImage)
-		delete mScaledImage;
+	if (mScaledLayer != nullptr)
+		mBaseFontLayer->mFontData->ReleaseScaledLayer(mScaledLayer);
 }
 
 ////
@@ -1103,9 +1453,9 @@ ImageFont::ImageFont(AppBase *thePopLibApp, const std::string &theFontDescFileNa
 	mFontData->Ref();
 	mFontData->Load(thePopLibApp, theFontDescFileName);
 	mPointSize = mFontData->mDefaultPointSize;
+	mForceScaledImagesWhite = false;
 	GenerateActiveFontLayers();
 	mActiveListValid = true;
-	mForceScaledImagesWhite = false;
 }
 
 ImageFont::ImageFont(Image *theFontImage)
@@ -1146,22 +1496,20 @@ ImageFont::ImageFont(Image *theFontImage, const std::string &theFontDescFileName
 	mFontData->Ref();
 	mFontData->LoadLegacy(theFontImage, theFontDescFileName);
 	mPointSize = mFontData->mDefaultPointSize;
+	mForceScaledImagesWhite = false;
 	GenerateActiveFontLayers();
 	mActiveListValid = true;
 }
 
 PopChar ImageFont::GetMappedChar(char value)
 {
-	return mFontData->mCharMap[value];
-}
-
-CharData *FontLayer::GetCharData(PopChar value)
-{
-	return &mCharData[value];
+	return (PopChar)mFontData->MapChar((uchar)value);
 }
 
 ImageFont::~ImageFont()
 {
+	// the active layers hold references into mFontData
+	mActiveLayerList.clear();
 	mFontData->DeRef();
 }
 
@@ -1227,13 +1575,8 @@ void ImageFont::GenerateActiveFontLayers()
 
 				if ((mScale == 1.0) && ((aFontLayer->mPointSize == 0) || (mPointSize == aFontLayer->mPointSize)))
 				{
-					anActiveFontLayer->mScaledImage = aFontLayer->mImage;
-					anActiveFontLayer->mOwnsImage = false;
-
 					// Use the specified point size
-
-					for (int aCharNum = 0; aCharNum < 256; aCharNum++)
-						anActiveFontLayer->mScaledCharImageRects[aCharNum] = aFontLayer->mCharData[aCharNum].mImageRect;
+					anActiveFontLayer->mScaledLayer = mFontData->GetScaledLayer(aFontLayer, -1, false);
 				}
 				else
 				{
@@ -1243,57 +1586,12 @@ void ImageFont::GenerateActiveFontLayers()
 						aPointSize = mPointSize * mScale;
 					}
 
-					// Resize font elements
-					int aCharNum;
-
-					MemoryImage *aMemoryImage = new MemoryImage(mFontData->mApp);
-
-					int aCurX = 0;
-					int aMaxHeight = 0;
-
-					for (aCharNum = 0; aCharNum < 256; aCharNum++)
-					{
-						Rect *anOrigRect = &aFontLayer->mCharData[aCharNum].mImageRect;
-
-						Rect aScaledRect(aCurX, 0, (int)((anOrigRect->mWidth * aPointSize) / aLayerPointSize),
-										 (int)((anOrigRect->mHeight * aPointSize) / aLayerPointSize));
-
-						anActiveFontLayer->mScaledCharImageRects[aCharNum] = aScaledRect;
-
-						if (aScaledRect.mHeight > aMaxHeight)
-							aMaxHeight = aScaledRect.mHeight;
-
-						aCurX += aScaledRect.mWidth;
-					}
-
-					anActiveFontLayer->mScaledImage = aMemoryImage;
-					anActiveFontLayer->mOwnsImage = true;
-
-					// Create the image now
-
-					aMemoryImage->Create(aCurX, aMaxHeight);
-
-					Graphics g(aMemoryImage);
-
-					for (aCharNum = 0; aCharNum < 256; aCharNum++)
-					{
-						if ((Image *)aFontLayer->mImage != nullptr)
-							g.DrawImage(aFontLayer->mImage, anActiveFontLayer->mScaledCharImageRects[aCharNum],
-										aFontLayer->mCharData[aCharNum].mImageRect);
-					}
-
-					if (mForceScaledImagesWhite)
-					{
-						int aCount = aMemoryImage->mWidth * aMemoryImage->mHeight;
-						ulong *aBits = aMemoryImage->GetBits();
-
-						for (int i = 0; i < aCount; i++)
-							*(aBits++) = *aBits | 0x00FFFFFF;
-					}
-
-					aMemoryImage->Palletize();
+					anActiveFontLayer->mScaledLayer =
+						mFontData->GetScaledLayer(aFontLayer, aPointSize, mForceScaledImagesWhite);
 				}
 
+				anActiveFontLayer->mScaledImage = anActiveFontLayer->mScaledLayer->mImage;
+
 				int aLayerAscent = (aFontLayer->mAscent * aPointSize) / aLayerPointSize;
 				if (aLayerAscent > mAscent)
 					mAscent = aLayerAscent;
@@ -1330,11 +1628,12 @@ void ImageFont::GenerateActiveFontLayers()
 int ImageFont::StringWidth(const PopString &theString)
 {
 	int aWidth = 0;
-	char aPrevChar = 0;
-	for (int i = 0; i < (int)theString.length(); i++)
+	uint32_t aPrevChar = 0;
+	ulong anIndex = 0;
+	while (anIndex < theString.length())
 	{
-		char aChar = theString[i];
-		aWidth += CharWidthKern(aChar, aPrevChar);
+		uint32_t aChar = ReadChar(theString, anIndex);
+		aWidth += GlyphWidthKern(aChar, aPrevChar);
 		aPrevChar = aChar;
 	}
 
@@ -1342,54 +1641,50 @@ int ImageFont::StringWidth(const PopString &theString)
 }
 
 int ImageFont::CharWidthKern(char theChar, char thePrevChar)
+{
+	return GlyphWidthKern((uchar)theChar, (uchar)thePrevChar);
+}
+
+int ImageFont::GlyphWidthKern(uint32_t theChar, uint32_t thePrevChar)
 {
 	Prepare();
 
 	int aMaxXPos = 0;
 	double aPointSize = mPointSize * mScale;
 
-	theChar = mFontData->mCharMap[(uchar)theChar];
+	theChar = mFontData->MapChar(theChar);
 	if (thePrevChar != 0)
-		thePrevChar = mFontData->mCharMap[(uchar)thePrevChar];
+		thePrevChar = mFontData->MapChar(thePrevChar);
 
 	ActiveFontLayerList::iterator anItr = mActiveLayerList.begin();
 	while (anItr != mActiveLayerList.end())
 	{
 		ActiveFontLayer *anActiveFontLayer = &*anItr;
+		FontLayer *aBaseFontLayer = anActiveFontLayer->mBaseFontLayer;
 
 		int aLayerXPos = 0;
 
 		int aCharWidth;
 		int aSpacing;
 
-		int aLayerPointSize = anActiveFontLayer->mBaseFontLayer->mPointSize;
+		int aLayerPointSize = aBaseFontLayer->mPointSize;
 
 		if (aLayerPointSize == 0)
 		{
-			aCharWidth = anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)theChar].mWidth * mScale;
+			aCharWidth = aBaseFontLayer->GetCharData(theChar)->mWidth * mScale;
 
 			if (thePrevChar != 0)
-			{
-				aSpacing =
-					(anActiveFontLayer->mBaseFontLayer->mSpacing +
-					 anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)thePrevChar].mKerningOffsets[(uchar)theChar]) *
-					mScale;
-			}
+				aSpacing = (aBaseFontLayer->mSpacing + aBaseFontLayer->GetKerning(thePrevChar, theChar)) * mScale;
 			else
 				aSpacing = 0;
 		}
 		else
 		{
-			aCharWidth =
-				(anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)theChar].mWidth * aPointSize / aLayerPointSize);
+			aCharWidth = (aBaseFontLayer->GetCharData(theChar)->mWidth * aPointSize / aLayerPointSize);
 
 			if (thePrevChar != 0)
-			{
-				aSpacing =
-					(anActiveFontLayer->mBaseFontLayer->mSpacing +
-					 anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)thePrevChar].mKerningOffsets[(uchar)theChar]) *
-					aPointSize / aLayerPointSize;
-			}
+				aSpacing = (aBaseFontLayer->mSpacing + aBaseFontLayer->GetKerning(thePrevChar, theChar)) * aPointSize /
+						   aLayerPointSize;
 			else
 				aSpacing = 0;
 		}
@@ -1410,23 +1705,35 @@ int ImageFont::CharWidth(char theChar)
 	return CharWidthKern(theChar, 0);
 }
 
-CritSect gRenderCritSec;
-static const int POOL_SIZE = 4096;
-static RenderCommand gRenderCommandPool[POOL_SIZE];
-static RenderCommand *gRenderTail[256];
-static RenderCommand *gRenderHead[256];
+// Glyph commands are gathered into scratch storage owned by the calling thread, so DrawStringEx needs no
+// global lock. A nested call on the same thread (a custom Graphics drawing text while flushing, say)
+// finds the buffer taken and uses one of its own instead.
+struct RenderCommandBuffer
+{
+	RenderCommandVector mCommands;
+	bool mInUse;
+};
+
+static thread_local RenderCommandBuffer gRenderCommandBuffer;
+
+static bool RenderCommandLess(const RenderCommand &theCommand1, const RenderCommand &theCommand2)
+{
+	if (theCommand1.mOrder != theCommand2.mOrder)
+		return theCommand1.mOrder < theCommand2.mOrder;
+	return theCommand1.mLayer < theCommand2.mLayer;
+}
 
 void ImageFont::DrawStringEx(Graphics *g, int theX, int theY, const PopString &theString, const Color &theColor,
 							 const Rect *theClipRect, RectList *theDrawnAreas, int *theWidth)
 {
-	AutoCrit anAutoCrit(gRenderCritSec);
-
-	int aPoolIdx;
-
-	for (aPoolIdx = 0; aPoolIdx < 256; aPoolIdx++)
+	RenderCommandVector aLocalCommands;
+	RenderCommandVector *aCommands = &aLocalCommands;
+	bool ownsSharedBuffer = !gRenderCommandBuffer.mInUse;
+	if (ownsSharedBuffer)
 	{
-		gRenderHead[aPoolIdx] = nullptr;
-		gRenderTail[aPoolIdx] = nullptr;
+		gRenderCommandBuffer.mInUse = true;
+		aCommands = &gRenderCommandBuffer.mCommands;
+		aCommands->clear();
 	}
 
 	int aXPos = theX;
@@ -1441,6 +1748,8 @@ void ImageFont::DrawStringEx(Graphics *g, int theX, int theY, const PopString &t
 	{
 		if (theWidth != nullptr)
 			*theWidth = 0;
+		if (ownsSharedBuffer)
+			gRenderCommandBuffer.mInUse = false;
 		return;
 	}
 
@@ -1450,22 +1759,32 @@ void ImageFont::DrawStringEx(Graphics *g, int theX, int theY, const PopString &t
 	g->SetColorizeImages(true);
 
 	int aCurXPos = theX;
-	int aCurPoolIdx = 0;
 
-	for (ulong aCharNum = 0; aCharNum < theString.length(); aCharNum++)
+	ulong aReadPos = 0;
+	uint32_t aNextChar = 0;
+	if (theString.length() > 0)
+		aNextChar = mFontData->MapChar(ReadChar(theString, aReadPos));
+
+	for (bool hasChar = theString.length() > 0; hasChar;)
 	{
-		char aChar = mFontData->mCharMap[(uchar)theString[aCharNum]];
+		uint32_t aChar = aNextChar;
 
-		char aNextChar = 0;
-		if (aCharNum < theString.length() - 1)
-			aNextChar = mFontData->mCharMap[(uchar)theString[aCharNum + 1]];
+		hasChar = aReadPos < theString.length();
+		aNextChar = hasChar ? mFontData->MapChar(ReadChar(theString, aReadPos)) : 0;
 
 		int aMaxXPos = aCurXPos;
+		int aLayerIdx = 0;
 
 		ActiveFontLayerList::iterator anItr = mActiveLayerList.begin();
 		while (anItr != mActiveLayerList.end())
 		{
 			ActiveFontLayer *anActiveFontLayer = &*anItr;
+			FontLayer *aBaseFontLayer = anActiveFontLayer->mBaseFontLayer;
+
+			int aGlyphIdx = aBaseFontLayer->GetCharIndex(aChar);
+			const CharData *aCharData = (aGlyphIdx >= 0) ? &aBaseFontLayer->mCharData[aGlyphIdx] : &gEmptyCharData;
+			Rect aScaledCharRect =
+				(aGlyphIdx >= 0) ? anActiveFontLayer->mScaledLayer->mCharImageRects[aGlyphIdx] : Rect(0, 0, 0, 0);
 
 			int aLayerXPos = aCurXPos;
 
@@ -1482,40 +1801,25 @@ void ImageFont::DrawStringEx(Graphics *g, int theX, int theY, const PopString &t
 
 			if (aScale == 1.0)
 			{
-				anImageX = aLayerXPos + anActiveFontLayer->mBaseFontLayer->mOffset.mX +
-						   anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)aChar].mOffset.mX;
-				anImageY =
-					theY - (anActiveFontLayer->mBaseFontLayer->mAscent - anActiveFontLayer->mBaseFontLayer->mOffset.mY -
-							anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)aChar].mOffset.mY);
-				aCharWidth = anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)aChar].mWidth;
+				anImageX = aLayerXPos + aBaseFontLayer->mOffset.mX + aCharData->mOffset.mX;
+				anImageY = theY - (aBaseFontLayer->mAscent - aBaseFontLayer->mOffset.mY - aCharData->mOffset.mY);
+				aCharWidth = aCharData->mWidth;
 
 				if (aNextChar != 0)
-				{
-					aSpacing =
-						anActiveFontLayer->mBaseFontLayer->mSpacing +
-						anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)aChar].mKerningOffsets[(uchar)aNextChar];
-				}
+					aSpacing = aBaseFontLayer->mSpacing + aBaseFontLayer->GetKerning(aChar, aNextChar);
 				else
 					aSpacing = 0;
 			}
 			else
 			{
-				anImageX = aLayerXPos + (int)((anActiveFontLayer->mBaseFontLayer->mOffset.mX +
-											   anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)aChar].mOffset.mX) *
-											  aScale);
-				anImageY = theY - (int)((anActiveFontLayer->mBaseFontLayer->mAscent -
-										 anActiveFontLayer->mBaseFontLayer->mOffset.mY -
-										 anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)aChar].mOffset.mY) *
+				anImageX = aLayerXPos + (int)((aBaseFontLayer->mOffset.mX + aCharData->mOffset.mX) * aScale);
+				anImageY = theY - (int)((aBaseFontLayer->mAscent - aBaseFontLayer->mOffset.mY - aCharData->mOffset.mY) *
 										aScale);
-				aCharWidth = (anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)aChar].mWidth * aScale);
+				aCharWidth = (aCharData->mWidth * aScale);
 
 				if (aNextChar != 0)
-				{
-					aSpacing = (int)((anActiveFontLayer->mBaseFontLayer->mSpacing +
-									  anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)aChar]
-										  .mKerningOffsets[(uchar)aNextChar]) *
-									 aScale);
-				}
+					aSpacing =
+						(int)((aBaseFontLayer->mSpacing + aBaseFontLayer->GetKerning(aChar, aNextChar)) * aScale);
 				else
 					aSpacing = 0;
 			}
@@ -1534,37 +1838,22 @@ void ImageFont::DrawStringEx(Graphics *g, int theX, int theY, const PopString &t
 									anActiveFontLayer->mBaseFontLayer->mColorAdd.mAlpha,
 								255);
 
-			int anOrder = anActiveFontLayer->mBaseFontLayer->mBaseOrder +
-						  anActiveFontLayer->mBaseFontLayer->mCharData[(uchar)aChar].mOrder;
+			int anOrder = aBaseFontLayer->mBaseOrder + aCharData->mOrder;
 
-			if (aCurPoolIdx >= POOL_SIZE)
-				break;
-
-			RenderCommand *aRenderCommand = &gRenderCommandPool[aCurPoolIdx++];
+			aCommands->push_back(RenderCommand());
+			RenderCommand *aRenderCommand = &aCommands->back();
 
 			aRenderCommand->mImage = anActiveFontLayer->mScaledImage;
 			aRenderCommand->mColor = aColor;
 			aRenderCommand->mDest[0] = anImageX;
 			aRenderCommand->mDest[1] = anImageY;
-			aRenderCommand->mSrc[0] = anActiveFontLayer->mScaledCharImageRects[(uchar)aChar].mX;
-			aRenderCommand->mSrc[1] = anActiveFontLayer->mScaledCharImageRects[(uchar)aChar].mY;
-			aRenderCommand->mSrc[2] = anActiveFontLayer->mScaledCharImageRects[(uchar)aChar].mWidth;
-			aRenderCommand->mSrc[3] = anActiveFontLayer->mScaledCharImageRects[(uchar)aChar].mHeight;
+			aRenderCommand->mSrc[0] = aScaledCharRect.mX;
+			aRenderCommand->mSrc[1] = aScaledCharRect.mY;
+			aRenderCommand->mSrc[2] = aScaledCharRect.mWidth;
+			aRenderCommand->mSrc[3] = aScaledCharRect.mHeight;
 			aRenderCommand->mMode = anActiveFontLayer->mBaseFontLayer->mDrawMode;
-			aRenderCommand->mNext = nullptr;
-
-			int anOrderIdx = std::min(std::max(anOrder + 128, 0), 255);
-
-			if (gRenderTail[anOrderIdx] == nullptr)
-			{
-				gRenderTail[anOrderIdx] = aRenderCommand;
-				gRenderHead[anOrderIdx] = aRenderCommand;
-			}
-			else
-			{
-				gRenderTail[anOrderIdx]->mNext = aRenderCommand;
-				gRenderTail[anOrderIdx] = aRenderCommand;
-			}
+			aRenderCommand->mOrder = anOrder;
+			aRenderCommand->mLayer = aLayerIdx;
 
 			// aRenderCommandMap.insert(RenderCommandMap::value_type(aPriority, aRenderCommand));
 
@@ -1579,8 +1868,7 @@ void ImageFont::DrawStringEx(Graphics *g, int theX, int theY, const PopString &t
 
 			if (theDrawnAreas != nullptr)
 			{
-				Rect aDestRect = Rect(anImageX, anImageY, anActiveFontLayer->mScaledCharImageRects[(uchar)aChar].mWidth,
-									  anActiveFontLayer->mScaledCharImageRects[(uchar)aChar].mHeight);
+				Rect aDestRect = Rect(anImageX, anImageY, aScaledCharRect.mWidth, aScaledCharRect.mHeight);
 
 				theDrawnAreas->push_back(aDestRect);
 
@@ -1616,6 +1904,7 @@ void ImageFont::DrawStringEx(Graphics *g, int theX, int theY, const PopString &t
 				aMaxXPos = aLayerXPos;
 
 			++anItr;
+			++aLayerIdx;
 		}
 
 		aCurXPos = aMaxXPos;
@@ -1624,28 +1913,35 @@ void ImageFont::DrawStringEx(Graphics *g, int theX, int theY, const PopString &t
 	if (theWidth != nullptr)
 		*theWidth = aCurXPos - theX;
 
+	// Sorting by order and then by layer puts every glyph of one layer and order next to each other. Each such
+	// run shares an image, draw mode and (usually) color, so it reaches the renderer as a single batch.
+	std::stable_sort(aCommands->begin(), aCommands->end(), RenderCommandLess);
+
 	Color anOrigColor = g->GetColor();
+	int anOldDrawMode = g->GetDrawMode();
+	int aCurMode = anOldDrawMode;
 
-	for (aPoolIdx = 0; aPoolIdx < 256; aPoolIdx++)
+	for (RenderCommandVector::iterator aCmdItr = aCommands->begin(); aCmdItr != aCommands->end(); ++aCmdItr)
 	{
-		RenderCommand *aRenderCommand = gRenderHead[aPoolIdx];
+		RenderCommand *aRenderCommand = &*aCmdItr;
+		if (aRenderCommand->mImage == nullptr)
+			continue;
 
-		while (aRenderCommand != nullptr)
+		int aMode = (aRenderCommand->mMode != -1) ? aRenderCommand->mMode : anOldDrawMode;
+		if (aMode != aCurMode)
 		{
-			int anOldDrawMode = g->GetDrawMode();
-			if (aRenderCommand->mMode != -1)
-				g->SetDrawMode(aRenderCommand->mMode);
-			g->SetColor(Color(aRenderCommand->mColor));
-			if (aRenderCommand->mImage != nullptr)
-				g->DrawImage(aRenderCommand->mImage, aRenderCommand->mDest[0], aRenderCommand->mDest[1],
-							 Rect(aRenderCommand->mSrc[0], aRenderCommand->mSrc[1], aRenderCommand->mSrc[2],
-								  aRenderCommand->mSrc[3]));
-			g->SetDrawMode(anOldDrawMode);
-
-			aRenderCommand = aRenderCommand->mNext;
+			g->SetDrawMode(aMode);
+			aCurMode = aMode;
 		}
+		if (g->GetColor() != aRenderCommand->mColor)
+			g->SetColor(aRenderCommand->mColor);
+
+		g->DrawImage(aRenderCommand->mImage, aRenderCommand->mDest[0], aRenderCommand->mDest[1],
+					 Rect(aRenderCommand->mSrc[0], aRenderCommand->mSrc[1], aRenderCommand->mSrc[2],
+						  aRenderCommand->mSrc[3]));
 	}
 
+	g->SetDrawMode(anOldDrawMode);
 	g->SetColor(anOrigColor);
 
 	/*RenderCommandMap::iterator anItr = aRenderCommandMap.begin();
@@ -1666,6 +1962,9 @@ void ImageFont::DrawStringEx(Graphics *g, int theX, int theY, const PopString &t
 	}*/
 
 	g->SetColorizeImages(colorizeImages);
+
+	if (ownsSharedBuffer)
+		gRenderCommandBuffer.mInUse = false;
 }
 
 void ImageFont::DrawString(Graphics *g, int theX, int theY, const PopString &theString, const Color &theColor,
@@ -1683,12 +1982,14 @@ void ImageFont::SetPointSize(int thePointSize)
 {
 	mPointSize = thePointSize;
 	mActiveListValid = false;
+	LayoutChanged();
 }
 
 void ImageFont::SetScale(double theScale)
 {
 	mScale = theScale;
 	mActiveListValid = false;
+	LayoutChanged();
 }
 
 int ImageFont::GetPointSize()
@@ -1709,6 +2010,7 @@ bool ImageFont::AddTag(const std::string &theTagName)
 	std::string aTagName = StringToUpper(theTagName);
 	mTagVector.push_back(aTagName);
 	mActiveListValid = false;
+	LayoutChanged();
 	return true;
 }
 
@@ -1722,6 +2024,7 @@ bool ImageFont::RemoveTag(const std::string &theTagName)
 
 	mTagVector.erase(anItr);
 	mActiveListValid = false;
+	LayoutChanged();
 	return true;
 }
 
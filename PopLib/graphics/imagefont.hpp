@@ -7,6 +7,7 @@
 #include "font.hpp"
 #include "readwrite/descparser.hpp"
 #include "sharedimage.hpp"
+#include "misc/critsect.hpp"
 
 namespace PopLib
 {
@@ -19,7 +20,6 @@ class CharData
   public:
 	Rect mImageRect;
 	Point mOffset;
-	char mKerningOffsets[256];
 	int mWidth;
 	int mOrder;
 
@@ -27,6 +27,11 @@ class CharData
 	CharData();
 };
 
+typedef std::vector<CharData> CharDataVector;
+typedef std::map<uint32_t, int> CharIndexMap;
+typedef std::map<uint64_t, int> KerningMap; // (first char << 32) | second char -> offset
+typedef std::map<uint32_t, uint32_t> CharMap;
+
 class FontData;
 
 class FontLayer
@@ -35,7 +40,10 @@ class FontLayer
 	FontData *mFontData;
 	StringVector mRequiredTags;
 	StringVector mExcludedTags;
-	CharData mCharData[256];
+	CharDataVector mCharData;	// only the glyphs the layer defines, see GetCharIndex
+	int mLowCharIndex[256];		// index into mCharData for chars below 256, -1 if missing
+	CharIndexMap mCharIndexMap; // the same for every other codepoint
+	KerningMap mKerningMap;
 	Color mColorMult;
 	Color mColorAdd;
 	SharedImageRef mImage;
@@ -55,13 +63,45 @@ class FontLayer
   public:
 	FontLayer(FontData *theFontData);
 	FontLayer(const FontLayer &theFontLayer);
-	CharData *GetCharData(PopChar value);
+
+	int GetCharIndex(uint32_t theChar) const;
+	const CharData *GetCharData(uint32_t theChar) const;
+	CharData *AddCharData(uint32_t theChar);
+	int GetKerning(uint32_t theChar, uint32_t theNextChar) const;
+	void SetKerning(uint32_t theChar, uint32_t theNextChar, int theOffset);
 };
 
 typedef std::list<FontLayer> FontLayerList;
 typedef std::map<std::string, FontLayer *> FontLayerMap;
 typedef std::list<Rect> RectList;
 
+// A layer's glyphs resized for one point size. Owned by the FontData and shared by every ImageFont that draws the
+// layer at that size.
+class ScaledFontLayer
+{
+  public:
+	Image *mImage;
+	bool mOwnsImage;
+	std::vector<Rect> mCharImageRects; // parallel to the base layer's mCharData
+	int mRefCount;
+	int mLastUsed;
+
+  public:
+	ScaledFontLayer();
+	~ScaledFontLayer();
+};
+
+struct ScaledFontLayerKey
+{
+	FontLayer *mFontLayer;
+	double mPointSize; // -1 for the layer's own image
+	bool mForceWhite;
+
+	bool operator<(const ScaledFontLayerKey &theKey) const;
+};
+
+typedef std::map<ScaledFontLayerKey, ScaledFontLayer *> ScaledFontLayerMap;
+
 class FontData : public DescParser
 {
   public:
@@ -70,13 +110,17 @@ class FontData : public DescParser
 	AppBase *mApp;
 
 	int mDefaultPointSize;
-	uchar mCharMap[256];
+	CharMap mCharMap; // only chars that are remapped are stored
 	FontLayerList mFontLayerList;
 	FontLayerMap mFontLayerMap;
 
 	std::string mSourceFile;
 	std::string mFontErrorHeader;
 
+	CritSect mScaledLayerCritSect;
+	ScaledFontLayerMap mScaledLayerMap;
+	int mScaledLayerUseCount;
+
   public:
 	virtual bool Error(const std::string &theError);
 
@@ -93,6 +137,11 @@ class FontData : public DescParser
 
 	bool Load(AppBase *thePopLibApp, const std::string &theFontDescFileName);
 	bool LoadLegacy(Image *theFontImage, const std::string &theFontDescFileName);
+
+	uint32_t MapChar(uint32_t theChar) const;
+
+	ScaledFontLayer *GetScaledLayer(FontLayer *theFontLayer, double thePointSize, bool forceWhite);
+	void ReleaseScaledLayer(ScaledFontLayer *theScaledLayer);
 };
 
 class ActiveFontLayer
@@ -100,13 +149,13 @@ class ActiveFontLayer
   public:
 	FontLayer *mBaseFontLayer;
 
-	Image *mScaledImage;
-	bool mOwnsImage;
-	Rect mScaledCharImageRects[256];
+	ScaledFontLayer *mScaledLayer; // shared through mBaseFontLayer->mFontData
+	Image *mScaledImage;		   // mScaledLayer->mImage
 
   public:
 	ActiveFontLayer();
 	ActiveFontLayer(const ActiveFontLayer &theActiveFontLayer);
+	ActiveFontLayer &operator=(const ActiveFontLayer &theActiveFontLayer);
 	virtual ~ActiveFontLayer();
 };
 
@@ -120,9 +169,12 @@ class RenderCommand
 	int mSrc[4];
 	int mMode;
 	Color mColor;
-	RenderCommand *mNext;
+	int mOrder;
+	int mLayer;
 };
 
+typedef std::vector<RenderCommand> RenderCommandVector;
+
 typedef std::multimap<int, RenderCommand> RenderCommandMap;
 
 class ImageFont : public Font
@@ -154,6 +206,7 @@ class ImageFont : public Font
 
 	virtual int CharWidth(char theChar);
 	virtual int CharWidthKern(char theChar, char thePrevChar);
+	int GlyphWidthKern(uint32_t theChar, uint32_t thePrevChar);
 	virtual int StringWidth(const PopString &theString);
 	virtual void DrawString(Graphics *g, int theX, int theY, const PopString &theString, const Color &theColor,
 							const Rect &theClipRect);
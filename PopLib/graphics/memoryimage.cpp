@@ -155,10 +155,33 @@ void MemoryImage::Init()
 }
 
 void MemoryImage::BitsChanged()
+{
+	BitsChanged(Rect(0, 0, mWidth, mHeight));
+}
+
+/// <summary>
+/// Like BitsChanged(), but only theDirtyRect needs to be sent to the texture again
+/// </summary>
+void MemoryImage::BitsChanged(const Rect &theDirtyRect)
 {
 	mBitsChanged = true;
 	mBitsChangedCount++;
 
+	Rect aRect = theDirtyRect.Intersection(Rect(0, 0, mWidth, mHeight));
+	if (aRect.mWidth > 0 && aRect.mHeight > 0)
+	{
+		if (mDirtyRect.mWidth <= 0 || mDirtyRect.mHeight <= 0)
+			mDirtyRect = aRect;
+		else
+		{
+			int aLeft = std::min(mDirtyRect.mX, aRect.mX);
+			int aTop = std::min(mDirtyRect.mY, aRect.mY);
+			int aRight = std::max(mDirtyRect.mX + mDirtyRect.mWidth, aRect.mX + aRect.mWidth);
+			int aBottom = std::max(mDirtyRect.mY + mDirtyRect.mHeight, aRect.mY + aRect.mHeight);
+			mDirtyRect = Rect(aLeft, aTop, aRight - aLeft, aBottom - aTop);
+		}
+	}
+
 	delete[] mNativeAlphaData;
 	mNativeAlphaData = nullptr;
 
@@ -656,7 +679,8 @@ void MemoryImage::DrawLine(double theStartX, double theStartY, double theEndX, d
 		break;
 	}
 
-	BitsChanged();
+	BitsChanged(Rect((int)std::min(theStartX, theEndX) - 1, (int)std::min(theStartY, theEndY) - 1,
+					 (int)fabs(theEndX - theStartX) + 3, (int)fabs(theEndY - theStartY) + 3));
 }
 
 void MemoryImage::NormalDrawLineAA(double theStartX, double theStartY, double theEndX, double theEndY,
@@ -776,7 +800,8 @@ void MemoryImage::DrawLineAA(double theStartX, double theStartY, double theEndX,
 		break;
 	}
 
-	BitsChanged();
+	BitsChanged(Rect((int)std::min(theStartX, theEndX) - 1, (int)std::min(theStartY, theEndY) - 1,
+					 (int)fabs(theEndX - theStartX) + 3, (int)fabs(theEndY - theStartY) + 3));
 }
 
 void MemoryImage::CommitBits()
@@ -1308,7 +1333,7 @@ void MemoryImage::FillRect(const Rect &theRect, const Color &theColor, int theDr
 		}
 	}
 
-	BitsChanged();
+	BitsChanged(theRect);
 }
 
 void MemoryImage::ClearRect(const Rect &theRect)
@@ -1323,7 +1348,7 @@ void MemoryImage::ClearRect(const Rect &theRect)
 			*aDestPixels++ = 0;
 	}
 
-	BitsChanged();
+	BitsChanged(theRect);
 }
 
 void MemoryImage::Clear()
@@ -1374,7 +1399,7 @@ void MemoryImage::AdditiveBlt(Image *theImage, int theX, int theY, const Rect &t
 #undef SRC_TYPE
 		}
 
-		BitsChanged();
+		BitsChanged(Rect(theX, theY, theSrcRect.mWidth, theSrcRect.mHeight));
 	}
 }
 
@@ -1417,7 +1442,7 @@ void MemoryImage::NormalBlt(Image *theImage, int theX, int theY, const Rect &the
 #undef EACH_ROW
 		}
 
-		BitsChanged();
+		BitsChanged(Rect(theX, theY, theSrcRect.mWidth, theSrcRect.mHeight));
 	}
 }
 
@@ -1636,7 +1661,7 @@ void MemoryImage::SlowStretchBlt(Image *theImage, const Rect &theDestRect, const
 #undef READ_COLOR
 		}
 
-		BitsChanged();
+		BitsChanged(theDestRect);
 	}
 }
 
@@ -1706,7 +1731,7 @@ void MemoryImage::FastStretchBlt(Image *theImage, const Rect &theDestRect, const
 		}
 	}
 
-	BitsChanged();
+	BitsChanged(theDestRect);
 }
 
 void MemoryImage::StretchBlt(Image *theImage, const Rect &theDestRect, const Rect &theSrcRect, const Rect &theClipRect,
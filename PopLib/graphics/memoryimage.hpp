@@ -42,6 +42,7 @@ class MemoryImage : public Image
 	uchar *mRLAdditiveData;
 
 	bool mBitsChanged;
+	Rect mDirtyRect; // area changed since the texture last picked up the bits, empty when they match
 	AppBase *mApp;
 
   private:
@@ -58,6 +59,7 @@ class MemoryImage : public Image
 	virtual void ReInit();
 
 	virtual void BitsChanged();
+	void BitsChanged(const Rect &theDirtyRect);
 	virtual void CommitBits();
 
 	virtual void DeleteNativeData();
@@ -42,30 +42,42 @@ void SDLImage::Create(int theWidth, int theHeight)
 bool SDLImage::PolyFill3D(const Point theVertices[], int theNumVertices, const Rect *theClipRect, const Color &theColor,
 						  int theDrawMode, int tx, int ty)
 {
+	mInterface->SetDrawTarget(this);
 	mInterface->FillPoly(theVertices, theNumVertices, theClipRect, theColor, theDrawMode, tx, ty);
 	return true;
 }
 
 void SDLImage::FillRect(const Rect &theRect, const Color &theColor, int theDrawMode)
 {
+	mInterface->SetDrawTarget(this);
 	mInterface->FillRect(theRect, theColor, theDrawMode);
 }
 
+void SDLImage::ClearRect(const Rect &theRect)
+{
+	mInterface->SetDrawTarget(this);
+	mInterface->ClearRect(theRect);
+}
+
 void SDLImage::DrawLine(double theStartX, double theStartY, double theEndX, double theEndY,
 								 const Color &theColor, int theDrawMode)
 {
+	mInterface->SetDrawTarget(this);
 	mInterface->DrawLine(theStartX, theStartY, theEndX, theEndY, theColor, theDrawMode);
 }
 
 void SDLImage::DrawLineAA(double theStartX, double theStartY, double theEndX, double theEndY,
 								   const Color &theColor, int theDrawMode)
 {
+	mInterface->SetDrawTarget(this);
 	mInterface->DrawLine(theStartX, theStartY, theEndX, theEndY, theColor, theDrawMode);
 }
 
 void SDLImage::Blt(Image *theImage, int theX, int theY, const Rect &theSrcRect, const Color &theColor,
 							int theDrawMode)
 {
+	mInterface->SetDrawTarget(this);
+
 	theImage->mDrawn = true;
 
 	CommitBits();
@@ -76,6 +88,8 @@ void SDLImage::Blt(Image *theImage, int theX, int theY, const Rect &theSrcRect,
 void SDLImage::BltF(Image *theImage, float theX, float theY, const Rect &theSrcRect, const Rect &theClipRect,
 							 const Color &theColor, int theDrawMode)
 {
+	mInterface->SetDrawTarget(this);
+
 	theImage->mDrawn = true;
 
 	FRect aClipRect(theClipRect.mX, theClipRect.mY, theClipRect.mWidth, theClipRect.mHeight);
@@ -95,6 +109,8 @@ void SDLImage::BltRotated(Image *theImage, float theX, float theY, const Rect &t
 								   const Rect &theClipRect, const Color &theColor, int theDrawMode, double theRot,
 								   float theRotCenterX, float theRotCenterY)
 {
+	mInterface->SetDrawTarget(this);
+
 	theImage->mDrawn = true;
 
 	CommitBits();
@@ -106,6 +122,8 @@ void SDLImage::BltRotated(Image *theImage, float theX, float theY, const Rect &t
 void SDLImage::StretchBlt(Image *theImage, const Rect &theDestRect, const Rect &theSrcRect,
 								   const Rect &theClipRect, const Color &theColor, int theDrawMode, bool fastStretch)
 {
+	mInterface->SetDrawTarget(this);
+
 	theImage->mDrawn = true;
 
 	CommitBits();
@@ -117,6 +135,8 @@ void SDLImage::BltMatrix(Image *theImage, float x, float y, const Matrix3 &theMa
 								  const Rect &theClipRect, const Color &theColor, int theDrawMode,
 								  const Rect &theSrcRect, bool blend)
 {
+	mInterface->SetDrawTarget(this);
+
 	theImage->mDrawn = true;
 
 	mInterface->BltTransformed(theImage, &theClipRect, theColor, theDrawMode, theSrcRect, theMatrix, blend, x, y, true);
@@ -126,6 +146,8 @@ void SDLImage::BltTrianglesTex(Image *theTexture, const TriVertex theVertices[][
 										const Rect &theClipRect, const Color &theColor, int theDrawMode, float tx,
 										float ty, bool blend)
 {
+	mInterface->SetDrawTarget(this);
+
 	theTexture->mDrawn = true;
 
 	mInterface->DrawTrianglesTex(theVertices, theNumTriangles, theColor, theDrawMode, theTexture, tx, ty, blend);
@@ -134,6 +156,8 @@ void SDLImage::BltTrianglesTex(Image *theTexture, const TriVertex theVertices[][
 void SDLImage::BltMirror(Image *theImage, int theX, int theY, const Rect &theSrcRect, const Color &theColor,
 								  int theDrawMode)
 {
+	mInterface->SetDrawTarget(this);
+
 	theImage->mDrawn = true;
 
 	CommitBits();
@@ -145,6 +169,8 @@ void SDLImage::StretchBltMirror(Image *theImage, const Rect &theDestRectOrig, co
 										 const Rect &theClipRect, const Color &theColor, int theDrawMode,
 										 bool fastStretch)
 {
+	mInterface->SetDrawTarget(this);
+
 	theImage->mDrawn = true;
 
 	CommitBits();
@@ -194,6 +220,15 @@ bool SDLImage::Check3D(Image *theImage)
 	return anImage != nullptr;
 }
 
+ulong *SDLImage::GetBits()
+{
+	// a render target's pixels live on the GPU, pull them back before the CPU sees them
+	if (mBits != nullptr && mD3DData != nullptr && (mImageFlags & SDLImageFlag_RenderTarget))
+		mInterface->RecoverBits(this);
+
+	return MemoryImage::GetBits();
+}
+
 void SDLImage::PurgeBits()
 {
 	mPurgeBits = true;
@@ -203,3 +238,8 @@ void SDLImage::PurgeBits()
 
 	MemoryImage::PurgeBits();
 }
+
+bool SDLImage::IsTextureResident()
+{
+	return mInterface->IsTextureResident(this);
+}
@@ -37,6 +37,7 @@ class SDLImage : public MemoryImage
 	virtual bool PolyFill3D(const Point theVertices[], int theNumVertices, const Rect *theClipRect,
 							const Color &theColor, int theDrawMode, int tx, int ty);
 	virtual void FillRect(const Rect &theRect, const Color &theColor, int theDrawMode);
+	virtual void ClearRect(const Rect &theRect);
 	virtual void DrawLine(double theStartX, double theStartY, double theEndX, double theEndY, const Color &theColor,
 						  int theDrawMode);
 	virtual void DrawLineAA(double theStartX, double theStartY, double theEndX, double theEndY, const Color &theColor,
@@ -61,7 +62,10 @@ class SDLImage : public MemoryImage
 	virtual void StretchBltMirror(Image *theImage, const Rect &theDestRectOrig, const Rect &theSrcRect,
 								  const Rect &theClipRect, const Color &theColor, int theDrawMode, bool fastStretch);
 
+	virtual ulong *GetBits();
 	virtual void PurgeBits();
+
+	bool IsTextureResident();
 };
 } // namespace PopLib
 
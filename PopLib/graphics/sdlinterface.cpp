@@ -6,6 +6,7 @@
 #include "graphics.hpp"
 #include "memoryimage.hpp"
 #include "imgui/imguimanager.hpp"
+#include "debug/profiler.hpp"
 #include <SDL3_ttf/SDL_ttf.h>
 
 using namespace PopLib;
@@ -37,7 +38,28 @@ SDLInterface::SDLInterface(AppBase *theApp)
 	mRefreshRate = 0;
 	mRenderer = nullptr;
 	mScreenTexture = nullptr;
+	mDrawTarget = nullptr;
 	mWindow = nullptr;
+
+	mBatchTexture = nullptr;
+	mBatchBlendMode = SDL_BLENDMODE_BLEND;
+	mBatchScaleMode = SDL_SCALEMODE_LINEAR;
+	mBatchHasScaleMode = false;
+	mBatchHasClip = false;
+	mBatchTextureState = nullptr;
+
+	mCurrentTarget = nullptr;
+	mClipEnabled = false;
+	mDrawBlendMode = SDL_BLENDMODE_NONE;
+	mStatsHistoryCount = 0;
+	mLastDrawTexture = nullptr;
+	mTextureMemory = 0;
+	mTextureMemoryBudget = 0;
+	mFrameNum = 0;
+	mTexturesEvicted = 0;
+	mUploadBudgetMS = 4;
+	mUploadBudgetBytes = 8 * 1024 * 1024;
+	InvalidateRenderState();
 }
 
 SDLInterface::~SDLInterface()
@@ -48,6 +70,11 @@ SDLInterface::~SDLInterface()
 
 void SDLInterface::Cleanup()
 {
+	mBatchVertices.clear();
+	mBatchIndices.clear();
+	mBatchTexture = nullptr;
+	mBatchTextureState = nullptr;
+
 	ImageSet::iterator anItr;
 	for (anItr = mImageSet.begin(); anItr != mImageSet.end(); ++anItr)
 	{
@@ -57,9 +84,13 @@ void SDLInterface::Cleanup()
 		anImage->mD3DData = nullptr;
 	}
 	mImageSet.clear();
+	mUploadQueue.clear();
+	mTextureMemory = 0;
 
 	SDL_DestroyRenderer(mRenderer);
 	SDL_DestroyWindow(mWindow);
+	mScreenTexture = nullptr;
+	mDrawTarget = nullptr;
 	mHasInitiated = false;
 }
 
@@ -81,8 +112,23 @@ void SDLInterface::RemoveSDLImage(SDLImage *theSDLImage)
 
 void SDLInterface::Remove3DData(MemoryImage *theImage)
 {
+	{
+		AutoCrit aCrit(mCritSect);
+		mUploadQueue.remove(theImage);
+	}
+
 	if (theImage->mD3DData != nullptr)
 	{
+		SDL_Texture *aTexture = ((SDLTextureData *)theImage->mD3DData)->mTexture;
+		if (aTexture != nullptr && (aTexture == mBatchTexture || aTexture == mDrawTarget))
+			FlushBatch();
+
+		if (aTexture != nullptr && aTexture == mDrawTarget)
+			mDrawTarget = mScreenTexture;
+		if (aTexture != nullptr && aTexture == mCurrentTarget)
+			mTargetKnown = false;
+
+		mTextureMemory -= ((SDLTextureData *)theImage->mD3DData)->GetMemSize();
 		delete (SDLTextureData *)theImage->mD3DData;
 		theImage->mD3DData = nullptr;
 
@@ -167,6 +213,9 @@ bool SDLInterface::InitSDLRenderer()
 		return false;
 	}
 
+	InvalidateRenderState();
+	mScreenTextureState.Invalidate();
+
 	mScreenTexture = SDL_CreateTexture(mRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, mWidth, mHeight);
 	if (mScreenTexture == nullptr)
 	{
@@ -174,6 +223,7 @@ bool SDLInterface::InitSDLRenderer()
 								 nullptr);
 		return false;
 	}
+	mDrawTarget = mScreenTexture;
 
 	const SDL_DisplayMode *aMode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(mWindow));
 	mRefreshRate = aMode->refresh_rate;
@@ -194,28 +244,46 @@ namespace PopLib {
 
 bool SDLInterface::Redraw(Rect *theClipRect)
 {
+	FlushBatch();
+
 	// HACK: i dont know where to put this
-	mApp->mIGUIManager->Frame();
+	{
+		PROFILE_ZONE("ImGuiManager::Frame");
+		mApp->mIGUIManager->Frame();
+	}
 
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	SetRenderTarget(nullptr);
 
-	SDL_SetRenderDrawColor(mRenderer, 0, 0, 0, 0);
-	SDL_SetTextureBlendMode(mScreenTexture, SDL_BLENDMODE_BLEND);
+	SetRenderDrawColor(Color(0, 0, 0, 0));
+	SetTextureBlendMode(mScreenTexture, &mScreenTextureState, SDL_BLENDMODE_BLEND);
 	SDL_RenderClear(mRenderer);
 
-	SDL_Rect clipRect =
-		theClipRect
-			? SDL_Rect{theClipRect->mX, theClipRect->mY, theClipRect->mWidth, theClipRect->mHeight}
-			: SDL_Rect{mPresentationRect.mX, mPresentationRect.mY, mPresentationRect.mWidth, mPresentationRect.mHeight};
-
-	SDL_SetRenderClipRect(mRenderer, &clipRect);
+	SetRenderClipRect(theClipRect != nullptr ? theClipRect : &mPresentationRect);
 
 	PopLib::gSDLInterfacePreDrawError = (SDL_RenderTexture(mRenderer, mScreenTexture, nullptr, nullptr) < 0);
+	CountDrawCall(mScreenTexture, 4, 1);
 
 	if (ImGui::GetDrawData() != nullptr)
+	{
 		ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), mRenderer);
+		InvalidateRenderState(); // ImGui changes the renderer state behind our back
+	}
 
-	SDL_RenderPresent(mRenderer);
+	{
+		PROFILE_ZONE("SDL_RenderPresent");
+		SDL_RenderPresent(mRenderer);
+	}
+
+	mFrameNum++;
+	ProcessUploadQueue();
+	EnforceTextureBudget();
+
+	// the uploads and evictions above are charged to the frame that is ending
+	mFrameStats.mLiveTextures = SDLTextureData::gTextureCount + (mScreenTexture != nullptr ? 1 : 0);
+	mFrameStats.mTextureMemory = mTextureMemory + (int64_t)mWidth * mHeight * 4;
+	mStatsHistory[mStatsHistoryCount % STATS_HISTORY] = mFrameStats;
+	mStatsHistoryCount++;
+	mFrameStats.Reset();
 
 	return !PopLib::gSDLInterfacePreDrawError;
 }
@@ -352,7 +420,36 @@ bool SDLInterface::CreateImageTexture(MemoryImage *theImage)
 	}
 
 	SDLTextureData *aData = static_cast<SDLTextureData *>(theImage->mD3DData);
-	aData->CheckCreateTextures(theImage);
+	aData->mLastUsedFrame = mFrameNum;
+
+	// queued quads must still see the old contents of a texture that is about to change
+	if (aData->mTexture != nullptr && aData->mTexture == mBatchTexture &&
+		(aData->mWidth != theImage->mWidth || aData->mHeight != theImage->mHeight ||
+		 aData->mBitsChangedCount != theImage->mBitsChangedCount))
+		FlushBatch();
+
+	if (aData->mAtlasPage != nullptr)
+	{
+		// an image that was resized no longer fits its slot and gets a texture of its own
+		if (aData->mWidth == theImage->mWidth && aData->mHeight == theImage->mHeight &&
+			(theImage->mImageFlags & SDLImageFlag_RenderTarget) == 0)
+			return CreateAtlasTexture(theImage);
+
+		DetachFromAtlas(theImage);
+	}
+
+	int aOldSize = aData->GetMemSize();
+	int anUploadBytes = aData->CheckCreateTextures(theImage);
+	if (anUploadBytes > 0)
+	{
+		mFrameStats.mTextureUploads++;
+		mFrameStats.mUploadBytes += anUploadBytes;
+	}
+	int aNewSize = aData->GetMemSize();
+
+	mTextureMemory += aNewSize - aOldSize;
+	if (aNewSize > aOldSize && mTextureMemoryBudget > 0 && mTextureMemory > mTextureMemoryBudget)
+		EnforceTextureBudget();
 
 	if (wantPurge)
 		theImage->PurgeBits();
@@ -366,6 +463,59 @@ bool SDLInterface::RecoverBits(MemoryImage *theImage)
 		return false;
 
 	SDLTextureData *aData = (SDLTextureData *)theImage->mD3DData;
+
+	if (aData->mAtlasPage != nullptr)
+	{
+		// atlased images are copied back out of the page's bits
+		MemoryImage *aPage = aData->mAtlasPage;
+		if (aData->mBitsChangedCount != theImage->mBitsChangedCount || aPage->mBits == nullptr ||
+			theImage->mBits == nullptr)
+			return false;
+
+		for (int y = 0; y < theImage->mHeight; y++)
+			memcpy(theImage->mBits + y * theImage->mWidth,
+				   aPage->mBits + (aData->mAtlasY + y) * aPage->mWidth + aData->mAtlasX,
+				   theImage->mWidth * sizeof(ulong));
+		return true;
+	}
+
+	if (aData->mIsTarget)
+	{
+		// render targets are read back straight into the existing bits
+		if (aData->mTexture == nullptr || theImage->mBits == nullptr)
+			return false;
+		// a clean texture matches the bits, unless those were purged and GetBits has only just reallocated them
+		if (!aData->mTargetDirty && !theImage->mPurgeBits)
+			return true;
+
+		if (aData->mTexture == mDrawTarget)
+			FlushBatch();
+
+		SetRenderTarget(aData->mTexture);
+		SDL_Surface *aSurface = SDL_RenderReadPixels(mRenderer, nullptr);
+		if (aSurface == nullptr)
+			return false;
+
+		SDL_Surface *aConverted = SDL_ConvertSurface(aSurface, SDL_PIXELFORMAT_ARGB8888);
+		SDL_DestroySurface(aSurface);
+		if (aConverted == nullptr)
+			return false;
+
+		int aWidth = std::min(aConverted->w, theImage->mWidth);
+		int aHeight = std::min(aConverted->h, theImage->mHeight);
+		for (int y = 0; y < aHeight; y++)
+			memcpy(theImage->mBits + y * theImage->mWidth, (uchar *)aConverted->pixels + y * aConverted->pitch,
+				   aWidth * sizeof(ulong));
+		SDL_DestroySurface(aConverted);
+
+		// drop the derived software buffers, but the texture already matches the bits
+		theImage->BitsChanged();
+		theImage->mDirtyRect = Rect();
+		aData->mBitsChangedCount = theImage->mBitsChangedCount;
+		aData->mTargetDirty = false;
+		return true;
+	}
+
 	if (aData->mBitsChangedCount != theImage->mBitsChangedCount) // bits have changed since texture was created
 		return false;
 
@@ -385,6 +535,300 @@ bool SDLInterface::RecoverBits(MemoryImage *theImage)
 	return true;
 }
 
+/// <summary>
+/// Direct the following draw calls at theImage, or at the screen if theImage is nullptr
+/// or the screen image. Off-screen images are turned into render target textures on first use.
+/// </summary>
+void SDLInterface::SetDrawTarget(SDLImage *theImage)
+{
+	SDL_Texture *aTarget = mScreenTexture;
+
+	if (theImage != nullptr && theImage != mScreenImage)
+	{
+		if ((theImage->mImageFlags & SDLImageFlag_RenderTarget) == 0)
+		{
+			// keep the current pixels, they get uploaded into the new target texture
+			theImage->GetBits();
+			theImage->mImageFlags |= SDLImageFlag_RenderTarget;
+			Remove3DData(theImage);
+		}
+
+		CreateImageTexture(theImage);
+
+		SDLTextureData *aData = (SDLTextureData *)theImage->mD3DData;
+		if (aData != nullptr && aData->mTexture != nullptr)
+		{
+			aData->mTargetDirty = true;
+			aTarget = aData->mTexture;
+		}
+	}
+
+	if (aTarget != mDrawTarget)
+	{
+		FlushBatch();
+		mDrawTarget = aTarget;
+	}
+}
+
+void SDLInterface::SetTextureMemoryBudget(int64_t theBytes)
+{
+	mTextureMemoryBudget = theBytes;
+	EnforceTextureBudget();
+}
+
+/// <summary>
+/// Release least recently drawn textures until mTextureMemory fits mTextureMemoryBudget. Only textures
+/// not drawn this frame whose image still has its bits are candidates, they get recreated on next use.
+/// Images that purged their bits stay resident.
+/// </summary>
+void SDLInterface::EnforceTextureBudget()
+{
+	if (mTextureMemoryBudget <= 0 || mTextureMemory <= mTextureMemoryBudget)
+		return;
+
+	typedef std::multimap<int, MemoryImage *> ImageAgeMap;
+	ImageAgeMap aCandidates;
+	{
+		AutoCrit aCrit(mCritSect);
+
+		ImageSet::iterator anItr;
+		for (anItr = mImageSet.begin(); anItr != mImageSet.end(); ++anItr)
+		{
+			MemoryImage *anImage = *anItr;
+			SDLTextureData *aData = (SDLTextureData *)anImage->mD3DData;
+			if (aData == nullptr || aData->GetMemSize() == 0 || aData->mLastUsedFrame >= mFrameNum)
+				continue;
+			if (aData->mTexture == mDrawTarget || anImage == (MemoryImage *)mScreenImage)
+				continue;
+			if (anImage->mBits == nullptr && anImage->mColorIndices == nullptr)
+				continue;
+
+			aCandidates.insert(ImageAgeMap::value_type(aData->mLastUsedFrame, anImage));
+		}
+	}
+
+	ImageAgeMap::iterator anItr;
+	for (anItr = aCandidates.begin(); anItr != aCandidates.end(); ++anItr)
+	{
+		if (mTextureMemory <= mTextureMemoryBudget)
+			break;
+
+		MemoryImage *anImage = anItr->second;
+
+		// render targets may hold pixels that only exist on the GPU
+		if (((SDLTextureData *)anImage->mD3DData)->mIsTarget)
+			anImage->GetBits();
+
+		Remove3DData(anImage);
+		mTexturesEvicted++;
+	}
+}
+
+/// <summary>
+/// Ask for theImage's texture to be created ahead of its first draw. Safe to call from the
+/// loading thread, which also does the CPU-side preparation here so the render thread only uploads.
+/// </summary>
+void SDLInterface::QueueTextureUpload(MemoryImage *theImage)
+{
+	if (theImage == nullptr || theImage->mWidth <= 0 || theImage->mHeight <= 0)
+		return;
+
+	if (theImage->mD3DData == nullptr)
+	{
+		theImage->DeleteSWBuffers();
+		theImage->CommitBits();
+	}
+
+	AutoCrit aCrit(mCritSect);
+	mUploadQueue.push_back(theImage);
+}
+
+/// <summary>
+/// Create queued textures until the frame's time or byte budget runs out. At least one
+/// image is handled every frame so the queue always drains.
+/// </summary>
+void SDLInterface::ProcessUploadQueue()
+{
+	if (mRenderer == nullptr)
+		return;
+
+	PROFILE_ZONE("SDLInterface::ProcessUploadQueue");
+
+	Uint64 aStartTime = SDL_GetTicksNS();
+	int aStartBytes = mFrameStats.mUploadBytes;
+
+	for (;;)
+	{
+		MemoryImage *anImage;
+		{
+			AutoCrit aCrit(mCritSect);
+			if (mUploadQueue.empty())
+				break;
+
+			anImage = mUploadQueue.front();
+			mUploadQueue.pop_front();
+		}
+
+		CreateImageTexture(anImage);
+
+		if (mUploadBudgetBytes > 0 && mFrameStats.mUploadBytes - aStartBytes >= mUploadBudgetBytes)
+			break;
+		if (mUploadBudgetMS > 0 && SDL_GetTicksNS() - aStartTime >= (Uint64)mUploadBudgetMS * 1000000)
+			break;
+	}
+}
+
+int SDLInterface::GetUploadQueueSize()
+{
+	AutoCrit aCrit(mCritSect);
+	return (int)mUploadQueue.size();
+}
+
+/// <summary>
+/// Stats of a presented frame out of the mStatsHistory ring, an empty record for frames it doesn't hold anymore
+/// </summary>
+const RenderStats &SDLInterface::GetRenderStats(int theFramesAgo)
+{
+	static RenderStats anEmptyStats;
+
+	if (theFramesAgo < 0 || theFramesAgo >= GetRenderStatsCount())
+		return anEmptyStats;
+
+	return mStatsHistory[(mStatsHistoryCount - 1 - theFramesAgo) % STATS_HISTORY];
+}
+
+int SDLInterface::GetRenderStatsCount()
+{
+	return std::min(mStatsHistoryCount, (int)STATS_HISTORY);
+}
+
+/// <summary>
+/// True once theImage has a texture it can be drawn from without an upload stall
+/// </summary>
+bool SDLInterface::IsTextureResident(MemoryImage *theImage)
+{
+	SDLTextureData *aData = (SDLTextureData *)theImage->mD3DData;
+	if (aData == nullptr)
+		return false;
+
+	if (aData->mAtlasPage != nullptr)
+		return IsTextureResident(aData->mAtlasPage) && aData->mBitsChangedCount == theImage->mBitsChangedCount;
+
+	return aData->mTexture != nullptr && aData->mWidth == theImage->mWidth && aData->mHeight == theImage->mHeight &&
+		   aData->mBitsChangedCount == theImage->mBitsChangedCount;
+}
+
+/// <summary>
+/// Make theImage draw from a sub-rect of thePage instead of its own texture. The pixels
+/// must already have been copied into thePage's bits at (theX, theY).
+/// </summary>
+void SDLInterface::AddToAtlas(MemoryImage *theImage, MemoryImage *thePage, int theX, int theY)
+{
+	if (theImage->mD3DData == nullptr)
+	{
+		theImage->mD3DData = new SDLTextureData(mRenderer);
+
+		AutoCrit aCrit(mCritSect); // Make images thread safe
+		mImageSet.insert(theImage);
+	}
+
+	SDLTextureData *aData = (SDLTextureData *)theImage->mD3DData;
+	aData->ReleaseTextures();
+	aData->mAtlasPage = thePage;
+	aData->mAtlasX = theX;
+	aData->mAtlasY = theY;
+	aData->mWidth = theImage->mWidth;
+	aData->mHeight = theImage->mHeight;
+	aData->mBitsChangedCount = theImage->mBitsChangedCount;
+
+	// the page holds the pixels now, so a deferred purge can happen right away
+	if (theImage->mPurgeBits)
+		theImage->PurgeBits();
+}
+
+/// <summary>
+/// Give an atlased image its own texture again, e.g. because it changed size or its page is going away.
+/// </summary>
+void SDLInterface::DetachFromAtlas(MemoryImage *theImage)
+{
+	SDLTextureData *aData = (SDLTextureData *)theImage->mD3DData;
+	if (aData == nullptr || aData->mAtlasPage == nullptr)
+		return;
+
+	if (aData->mTexture != nullptr && aData->mTexture == mBatchTexture)
+		FlushBatch();
+
+	// take a private copy of the pixels while the page still has them
+	if (theImage->mBits == nullptr && theImage->mColorIndices == nullptr)
+		theImage->GetBits();
+
+	aData->mAtlasPage = nullptr;
+	aData->mAtlasX = 0;
+	aData->mAtlasY = 0;
+	aData->mTexture = nullptr;
+}
+
+void SDLInterface::RemoveAtlasPage(MemoryImage *thePage)
+{
+	ImageSet::iterator anItr;
+	for (anItr = mImageSet.begin(); anItr != mImageSet.end(); ++anItr)
+	{
+		SDLTextureData *aData = (SDLTextureData *)(*anItr)->mD3DData;
+		if (aData != nullptr && aData->mAtlasPage == thePage)
+			DetachFromAtlas(*anItr);
+	}
+}
+
+/// <summary>
+/// Point an atlased image at its page's texture, uploading the page first if needed.
+/// Changed bits only re-upload the image's own slot.
+/// </summary>
+bool SDLInterface::CreateAtlasTexture(MemoryImage *theImage)
+{
+	SDLTextureData *aData = (SDLTextureData *)theImage->mD3DData;
+	MemoryImage *aPage = aData->mAtlasPage;
+
+	if (!CreateImageTexture(aPage))
+		return false;
+
+	SDLTextureData *aPageData = (SDLTextureData *)aPage->mD3DData;
+	aData->mTexture = aPageData->mTexture;
+	aData->mTexWidth = aPageData->mTexWidth;
+	aData->mTexHeight = aPageData->mTexHeight;
+
+	if (aData->mTexture == nullptr)
+		return false;
+
+	if (aData->mBitsChangedCount != theImage->mBitsChangedCount)
+	{
+		theImage->CommitBits();
+		ulong *aBits = theImage->GetBits();
+		Rect aDirtyRect = theImage->mDirtyRect;
+
+		if (aData->mTexture == mBatchTexture)
+			FlushBatch();
+
+		if (aBits != nullptr && aDirtyRect.mWidth > 0 && aDirtyRect.mHeight > 0)
+		{
+			// keep the page's bits in sync so RecoverBits stays correct, the page texture is patched directly
+			if (aPage->mBits != nullptr)
+			{
+				for (int y = aDirtyRect.mY; y < aDirtyRect.mY + aDirtyRect.mHeight; y++)
+					memcpy(aPage->mBits + (aData->mAtlasY + y) * aPage->mWidth + aData->mAtlasX + aDirtyRect.mX,
+						   aBits + y * theImage->mWidth + aDirtyRect.mX, aDirtyRect.mWidth * sizeof(ulong));
+			}
+
+			mFrameStats.mTextureUploads++;
+			mFrameStats.mUploadBytes += aData->UploadRect(theImage, aDirtyRect);
+		}
+
+		theImage->mDirtyRect = Rect();
+		aData->mBitsChangedCount = theImage->mBitsChangedCount;
+	}
+
+	return true;
+}
+
 SDL_BlendMode SDLInterface::ChooseBlendMode(int theBlendMode)
 {
 	SDL_BlendMode theSDLBlendMode;
@@ -401,13 +845,263 @@ SDL_BlendMode SDLInterface::ChooseBlendMode(int theBlendMode)
 	return theSDLBlendMode;
 }
 
+/// <summary>
+/// Queue a textured quad. The pending batch is flushed first if the texture, blend mode,
+/// scale mode or clip rect differ from the quads already queued, so draw order is kept.
+/// </summary>
+void SDLInterface::BatchQuad(SDL_Texture *theTexture, SDLTextureState *theTextureState, int theTexWidth,
+							 int theTexHeight, const SDL_FRect &theSrcRect, const SDL_FRect &theDestRect,
+							 const Color &theColor, int theDrawMode, const Rect *theClipRect, bool hasScaleMode,
+							 SDL_ScaleMode theScaleMode, bool mirror)
+{
+	if (theTexture == nullptr || theTexWidth <= 0 || theTexHeight <= 0)
+		return;
+
+	SDL_BlendMode aBlendMode = ChooseBlendMode(theDrawMode);
+
+	if (!mBatchIndices.empty())
+	{
+		bool sameClip =
+			mBatchHasClip == (theClipRect != nullptr) && (!mBatchHasClip || mBatchClipRect == *theClipRect);
+		bool sameScale = !hasScaleMode || !mBatchHasScaleMode || mBatchScaleMode == theScaleMode;
+
+		if (mBatchTexture != theTexture || mBatchBlendMode != aBlendMode || !sameClip || !sameScale)
+			FlushBatch();
+	}
+
+	if (mBatchIndices.empty())
+	{
+		mBatchTexture = theTexture;
+		mBatchTextureState = theTextureState;
+		mBatchBlendMode = aBlendMode;
+		mBatchHasClip = theClipRect != nullptr;
+		if (mBatchHasClip)
+			mBatchClipRect = *theClipRect;
+		mBatchHasScaleMode = false;
+	}
+
+	if (hasScaleMode)
+	{
+		mBatchHasScaleMode = true;
+		mBatchScaleMode = theScaleMode;
+	}
+
+	float u1 = theSrcRect.x / theTexWidth;
+	float v1 = theSrcRect.y / theTexHeight;
+	float u2 = (theSrcRect.x + theSrcRect.w) / theTexWidth;
+	float v2 = (theSrcRect.y + theSrcRect.h) / theTexHeight;
+	if (mirror)
+		std::swap(u1, u2);
+
+	float x1 = theDestRect.x;
+	float y1 = theDestRect.y;
+	float x2 = theDestRect.x + theDestRect.w;
+	float y2 = theDestRect.y + theDestRect.h;
+
+	SDL_FColor aColor = {theColor.GetRed() / 255.0f, theColor.GetGreen() / 255.0f, theColor.GetBlue() / 255.0f,
+						 theColor.GetAlpha() / 255.0f};
+
+	int aBase = (int)mBatchVertices.size();
+	mBatchVertices.push_back(SDL_Vertex{{x1, y1}, aColor, {u1, v1}}); // TL
+	mBatchVertices.push_back(SDL_Vertex{{x2, y1}, aColor, {u2, v1}}); // TR
+	mBatchVertices.push_back(SDL_Vertex{{x1, y2}, aColor, {u1, v2}}); // BL
+	mBatchVertices.push_back(SDL_Vertex{{x2, y2}, aColor, {u2, v2}}); // BR
+
+	const int aQuadIndices[6] = {0, 1, 2, 1, 3, 2};
+	for (int i = 0; i < 6; i++)
+		mBatchIndices.push_back(aBase + aQuadIndices[i]);
+}
+
+/// <summary>
+/// Submit all queued quads. Called whenever the batch state changes, before any
+/// non-batched draw, and at Redraw.
+/// </summary>
+void SDLInterface::FlushBatch()
+{
+	if (mBatchIndices.empty())
+		return;
+
+	SetRenderTarget(mDrawTarget);
+	SetRenderClipRect(mBatchHasClip ? &mBatchClipRect : nullptr);
+
+	// the per-vertex colors carry the color/alpha modulation
+	SetTextureColorMod(mBatchTexture, mBatchTextureState, Color::White);
+	SetTextureBlendMode(mBatchTexture, mBatchTextureState, mBatchBlendMode);
+	if (mBatchHasScaleMode)
+		SetTextureScaleMode(mBatchTexture, mBatchTextureState, mBatchScaleMode);
+
+	SDL_RenderGeometry(mRenderer, mBatchTexture, mBatchVertices.data(), (int)mBatchVertices.size(),
+					   mBatchIndices.data(), (int)mBatchIndices.size());
+	CountDrawCall(mBatchTexture, (int)mBatchVertices.size(), (int)mBatchVertices.size() / 4);
+	mFrameStats.mBatches++;
+
+	mBatchVertices.clear();
+	mBatchIndices.clear();
+	mBatchTexture = nullptr;
+	mBatchTextureState = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Render-state cache. Each setter compares against the shadow copy and only
+// calls into SDL on an actual change; skipped calls are counted per frame.
+///////////////////////////////////////////////////////////////////////////////
+
+void SDLInterface::InvalidateRenderState()
+{
+	mTargetKnown = false;
+	mClipKnown = false;
+	mDrawColorKnown = false;
+	mDrawBlendModeKnown = false;
+	mLastDrawTexture = nullptr;
+}
+
+void SDLInterface::SetRenderTarget(SDL_Texture *theTarget)
+{
+	if (mTargetKnown && mCurrentTarget == theTarget)
+	{
+		mFrameStats.mStateChangesAvoided++;
+		return;
+	}
+
+	SDL_SetRenderTarget(mRenderer, theTarget);
+	mCurrentTarget = theTarget;
+	mFrameStats.mTargetSwitches++;
+	mTargetKnown = true;
+
+	// SDL keeps a separate clip rect per target
+	mClipKnown = false;
+}
+
+void SDLInterface::SetRenderClipRect(const Rect *theClipRect)
+{
+	if (mClipKnown && mClipEnabled == (theClipRect != nullptr) && (!mClipEnabled || mClipRect == *theClipRect))
+	{
+		mFrameStats.mStateChangesAvoided++;
+		return;
+	}
+
+	if (theClipRect != nullptr)
+	{
+		SDL_Rect aClipRect = {theClipRect->mX, theClipRect->mY, theClipRect->mWidth, theClipRect->mHeight};
+		SDL_SetRenderClipRect(mRenderer, &aClipRect);
+		mClipRect = *theClipRect;
+	}
+	else
+		SDL_SetRenderClipRect(mRenderer, nullptr);
+
+	mClipEnabled = theClipRect != nullptr;
+	mClipKnown = true;
+	mFrameStats.mClipChanges++;
+}
+
+void SDLInterface::SetRenderDrawColor(const Color &theColor)
+{
+	if (mDrawColorKnown && mDrawColor == theColor)
+	{
+		mFrameStats.mStateChangesAvoided++;
+		return;
+	}
+
+	SDL_SetRenderDrawColor(mRenderer, theColor.mRed, theColor.mGreen, theColor.mBlue, theColor.mAlpha);
+	mDrawColor = theColor;
+	mDrawColorKnown = true;
+}
+
+void SDLInterface::SetRenderDrawBlendMode(SDL_BlendMode theBlendMode)
+{
+	if (mDrawBlendModeKnown && mDrawBlendMode == theBlendMode)
+	{
+		mFrameStats.mStateChangesAvoided++;
+		return;
+	}
+
+	SDL_SetRenderDrawBlendMode(mRenderer, theBlendMode);
+	mDrawBlendMode = theBlendMode;
+	mDrawBlendModeKnown = true;
+}
+
+void SDLInterface::SetTextureColorMod(SDL_Texture *theTexture, SDLTextureState *theState, const Color &theColor)
+{
+	if (theState != nullptr && theState->mColorModKnown && theState->mColorMod == theColor)
+	{
+		mFrameStats.mStateChangesAvoided++;
+		return;
+	}
+
+	SDL_SetTextureColorMod(theTexture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
+	SDL_SetTextureAlphaMod(theTexture, theColor.GetAlpha());
+
+	if (theState != nullptr)
+	{
+		theState->mColorMod = theColor;
+		theState->mColorModKnown = true;
+	}
+}
+
+void SDLInterface::SetTextureBlendMode(SDL_Texture *theTexture, SDLTextureState *theState, SDL_BlendMode theBlendMode)
+{
+	if (theState != nullptr && theState->mBlendModeKnown && theState->mBlendMode == theBlendMode)
+	{
+		mFrameStats.mStateChangesAvoided++;
+		return;
+	}
+
+	SDL_SetTextureBlendMode(theTexture, theBlendMode);
+
+	if (theState != nullptr)
+	{
+		theState->mBlendMode = theBlendMode;
+		theState->mBlendModeKnown = true;
+	}
+}
+
+void SDLInterface::SetTextureScaleMode(SDL_Texture *theTexture, SDLTextureState *theState, SDL_ScaleMode theScaleMode)
+{
+	if (theState != nullptr && theState->mScaleModeKnown && theState->mScaleMode == theScaleMode)
+	{
+		mFrameStats.mStateChangesAvoided++;
+		return;
+	}
+
+	SDL_SetTextureScaleMode(theTexture, theScaleMode);
+
+	if (theState != nullptr)
+	{
+		theState->mScaleMode = theScaleMode;
+		theState->mScaleModeKnown = true;
+	}
+}
+
+SDLTextureState::SDLTextureState()
+{
+	mBlendMode = SDL_BLENDMODE_NONE;
+	mScaleMode = SDL_SCALEMODE_LINEAR;
+	Invalidate();
+}
+
+void SDLTextureState::Invalidate()
+{
+	mColorModKnown = false;
+	mBlendModeKnown = false;
+	mScaleModeKnown = false;
+}
+
 SDLTextureData::SDLTextureData(SDL_Renderer *theRenderer)
 {
 	mWidth = 0;
 	mHeight = 0;
 	mBitsChangedCount = 0;
+	mTexWidth = 0;
+	mTexHeight = 0;
 	mRenderer = theRenderer;
 	mTexture = nullptr;
+	mIsTarget = false;
+	mIsStreaming = false;
+	mTargetDirty = false;
+	mLastUsedFrame = 0;
+	mAtlasPage = nullptr;
+	mAtlasX = 0;
+	mAtlasY = 0;
 }
 
 SDLTextureData::~SDLTextureData()
@@ -417,48 +1111,89 @@ SDLTextureData::~SDLTextureData()
 
 void SDLTextureData::ReleaseTextures()
 {
-	if (mTexture != nullptr)
+	// an atlased image only borrows the page's texture
+	if (mTexture != nullptr && mAtlasPage == nullptr)
+	{
 		SDL_DestroyTexture(mTexture);
+		gTextureCount--;
+	}
+	mTexture = nullptr;
+}
+
+SDLTextureState *SDLTextureData::GetState()
+{
+	if (mAtlasPage != nullptr && mAtlasPage->mD3DData != nullptr)
+		return &((SDLTextureData *)mAtlasPage->mD3DData)->mState;
+
+	return &mState;
 }
 
-void SDLTextureData::CreateTextures(MemoryImage *theImage)
+SDL_FRect SDLTextureData::MapRect(const Rect &theRect) const
+{
+	return SDL_FRect{(float)(theRect.mX + mAtlasX), (float)(theRect.mY + mAtlasY), (float)theRect.mWidth,
+					 (float)theRect.mHeight};
+}
+
+void SDLTextureData::MapUV(float &theU, float &theV) const
+{
+	if (mAtlasPage == nullptr || mTexWidth <= 0 || mTexHeight <= 0)
+		return;
+
+	theU = (mAtlasX + theU * mWidth) / mTexWidth;
+	theV = (mAtlasY + theV * mHeight) / mTexHeight;
+}
+
+int SDLTextureData::CreateTextures(MemoryImage *theImage)
 {
 	theImage->DeleteSWBuffers(); // we don't need the software buffers anymore
 	theImage->CommitBits();
 
 	bool createTexture = false;
+	bool isTarget = (theImage->mImageFlags & SDLImageFlag_RenderTarget) != 0;
+	bool isStreaming = !isTarget && theImage->mIsVolatile;
 
-	// only recreate the texture if the dimensions or image data have changed
-	if (mWidth != theImage->mWidth || mHeight != theImage->mHeight || mBitsChangedCount != theImage->mBitsChangedCount)
+	// only recreate the texture if its kind or dimensions have changed,
+	// changed bits are uploaded into the existing texture instead
+	if (mTexture == nullptr || mIsTarget != isTarget || mIsStreaming != isStreaming || mWidth != theImage->mWidth ||
+		mHeight != theImage->mHeight)
 	{
 		ReleaseTextures();
 		createTexture = true;
 	}
+	else if (isTarget && mTargetDirty)
+	{
+		// the GPU copy is newer than the bits, nobody read it back before bumping the count
+		mBitsChangedCount = theImage->mBitsChangedCount;
+		theImage->mDirtyRect = Rect();
+		return 0;
+	}
 
 	int aWidth = theImage->GetWidth();
 	int aHeight = theImage->GetHeight();
+	int anUploadSize = 0;
 
 	if (createTexture)
 	{
-		mTexture = SDL_CreateTexture(mRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, aWidth, aHeight);
+		SDL_TextureAccess anAccess = isTarget ? SDL_TEXTUREACCESS_TARGET
+											  : (isStreaming ? SDL_TEXTUREACCESS_STREAMING : SDL_TEXTUREACCESS_STATIC);
+		mTexture = SDL_CreateTexture(mRenderer, SDL_PIXELFORMAT_ARGB8888, anAccess, aWidth, aHeight);
+		mIsTarget = isTarget;
+		mIsStreaming = isStreaming;
+		mTargetDirty = false;
 
 		if (mTexture)
 		{
+			gTextureCount++;
+
 			const char *rendererName = SDL_GetRendererName(mRenderer);
 
-			SDL_SetTextureScaleMode(mTexture, (rendererName && strcmp(rendererName, "software") == 0)
-												  ? SDL_SCALEMODE_NEAREST
-												  : SDL_SCALEMODE_LINEAR);
+			mState.Invalidate();
+			mState.mScaleMode = (rendererName && strcmp(rendererName, "software") == 0) ? SDL_SCALEMODE_NEAREST
+																						: SDL_SCALEMODE_LINEAR;
+			mState.mScaleModeKnown = true;
+			SDL_SetTextureScaleMode(mTexture, mState.mScaleMode);
 
-			void *bits = theImage->GetBits();
-			if (bits)
-			{
-				SDL_UpdateTexture(mTexture, nullptr, bits, aWidth * SDL_BYTESPERPIXEL(SDL_PIXELFORMAT_ARGB8888));
-			}
-			else
-			{
-				SDL_Log("Error: Image bits are nullptr, cannot update texture.");
-			}
+			anUploadSize = UploadRect(theImage, Rect(0, 0, aWidth, aHeight));
 		}
 		else
 		{
@@ -467,41 +1202,76 @@ void SDLTextureData::CreateTextures(MemoryImage *theImage)
 	}
 	else if (mBitsChangedCount != theImage->mBitsChangedCount)
 	{
-		void *bits = theImage->GetBits();
-		if (bits)
-		{
-			SDL_UpdateTexture(mTexture, nullptr, bits, aWidth * SDL_BYTESPERPIXEL(SDL_PIXELFORMAT_ARGB8888));
-		}
-		else
-		{
-			SDL_Log("Error: Image bits are nullptr, cannot update texture.");
-		}
+		const Rect &aDirtyRect = theImage->mDirtyRect;
+		if (aDirtyRect.mWidth > 0 && aDirtyRect.mHeight > 0)
+			anUploadSize = UploadRect(theImage, aDirtyRect);
 	}
 
+	theImage->mDirtyRect = Rect();
 	mWidth = theImage->mWidth;
 	mHeight = theImage->mHeight;
+	mTexWidth = mWidth;
+	mTexHeight = mHeight;
 	mBitsChangedCount = theImage->mBitsChangedCount;
+
+	return anUploadSize;
 }
 
-void SDLTextureData::CheckCreateTextures(MemoryImage *theImage)
+/// <summary>
+/// Copy theRect of the image's bits into the texture, offset by the atlas position.
+/// Streaming textures are written through a lock, everything else with SDL_UpdateTexture.
+/// Returns the number of bytes sent.
+/// </summary>
+int SDLTextureData::UploadRect(MemoryImage *theImage, const Rect &theRect)
+{
+	ulong *aBits = theImage->GetBits();
+	if (aBits == nullptr)
+	{
+		SDL_Log("Error: Image bits are nullptr, cannot update texture.");
+		return 0;
+	}
+
+	const ulong *aSrc = aBits + theRect.mY * theImage->mWidth + theRect.mX;
+	int aRowSize = theRect.mWidth * SDL_BYTESPERPIXEL(SDL_PIXELFORMAT_ARGB8888);
+	SDL_Rect aDestRect = {theRect.mX + mAtlasX, theRect.mY + mAtlasY, theRect.mWidth, theRect.mHeight};
+
+	if (mIsStreaming)
+	{
+		void *aPixels;
+		int aPitch;
+		if (!SDL_LockTexture(mTexture, &aDestRect, &aPixels, &aPitch))
+			return 0;
+
+		for (int y = 0; y < theRect.mHeight; y++)
+			memcpy((uchar *)aPixels + y * aPitch, aSrc + y * theImage->mWidth, aRowSize);
+
+		SDL_UnlockTexture(mTexture);
+	}
+	else
+		SDL_UpdateTexture(mTexture, &aDestRect, aSrc, theImage->mWidth * SDL_BYTESPERPIXEL(SDL_PIXELFORMAT_ARGB8888));
+
+	return aRowSize * theRect.mHeight;
+}
+
+int SDLTextureData::CheckCreateTextures(MemoryImage *theImage)
 {
 	if (mTexture != nullptr)
 	{
 		if (mWidth != theImage->mWidth || mHeight != theImage->mHeight ||
 			mBitsChangedCount != theImage->mBitsChangedCount)
-			CreateTextures(theImage);
-		return;
+			return CreateTextures(theImage);
+		return 0;
 	}
-	CreateTextures(theImage);
+	return CreateTextures(theImage);
 }
 
 int SDLTextureData::GetMemSize()
 {
-	int aSize = 0;
+	// atlased images borrow their page's texture, the page accounts for it
+	if (mTexture == nullptr || mAtlasPage != nullptr)
+		return 0;
 
-	aSize = (SDL_BYTESPERPIXEL(SDL_PIXELFORMAT_ARGB8888) / 8) * mWidth * mHeight;
-
-	return aSize;
+	return SDL_BYTESPERPIXEL(SDL_PIXELFORMAT_ARGB8888) * mTexWidth * mTexHeight;
 }
 
 /////////////////////////////////////////////////////////////////
@@ -516,22 +1286,12 @@ void SDLInterface::Blt(Image *theImage, int theX, int theY, const Rect &theSrcRe
 		return;
 
 	SDLTextureData *texData = static_cast<SDLTextureData *>(memImg->mD3DData);
-	SDL_Texture *texture = texData->mTexture;
-
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
-
-	SDL_SetTextureColorMod(texture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
-	SDL_SetTextureAlphaMod(texture, theColor.GetAlpha());
-	SDL_SetTextureBlendMode(texture, ChooseBlendMode(theDrawMode));
 
-	SDL_FRect srcF = {(float)theSrcRect.mX, (float)theSrcRect.mY, (float)theSrcRect.mWidth, (float)theSrcRect.mHeight};
+	SDL_FRect srcF = texData->MapRect(theSrcRect);
 	SDL_FRect dstF = {(float)theX, (float)theY, (float)theSrcRect.mWidth, (float)theSrcRect.mHeight};
 
-	bool ok = SDL_RenderTexture(mRenderer, texture, &srcF, &dstF);
-	if (ok)
-		SDL_SetRenderTarget(mRenderer, nullptr);
-
-	return;
+	BatchQuad(texData->mTexture, texData->GetState(), texData->mTexWidth, texData->mTexHeight, srcF, dstF, theColor,
+			  theDrawMode, nullptr, false, SDL_SCALEMODE_LINEAR);
 }
 
 void SDLInterface::BltClipF(Image *theImage, float theX, float theY, const Rect &theSrcRect, const Rect *theClipRect,
@@ -544,27 +1304,11 @@ void SDLInterface::BltClipF(Image *theImage, float theX, float theY, const Rect
 
 	SDLTextureData *aData = (SDLTextureData *)aSrcMemoryImage->mD3DData;
 
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
-
-	SDL_Texture *aTexture = aData->mTexture;
-	SDL_SetTextureColorMod(aTexture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
-	SDL_SetTextureAlphaMod(aTexture, theColor.GetAlpha());
-	SDL_SetTextureScaleMode(aTexture, theDrawMode ? SDL_SCALEMODE_LINEAR : SDL_SCALEMODE_NEAREST);
-
-	SDL_FRect destRect = {theX, theY, theSrcRect.mWidth, theSrcRect.mHeight};
-	if (theClipRect != nullptr)
-	{
-		SDL_Rect clipRect;
-		clipRect = {theClipRect->mX, theClipRect->mY, theClipRect->mWidth, theClipRect->mHeight};
-		SDL_SetRenderClipRect(mRenderer, &clipRect);
-	}
-
-	SDL_FRect srcRect = {theSrcRect.mX, theSrcRect.mY, theSrcRect.mWidth, theSrcRect.mHeight};
+	SDL_FRect destRect = {theX, theY, (float)theSrcRect.mWidth, (float)theSrcRect.mHeight};
+	SDL_FRect srcRect = aData->MapRect(theSrcRect);
 
-	SDL_SetTextureBlendMode(aTexture, ChooseBlendMode(theDrawMode));
-	SDL_RenderTexture(mRenderer, aTexture, &srcRect, &destRect);
-	SDL_SetRenderClipRect(mRenderer, nullptr);
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	BatchQuad(aData->mTexture, aData->GetState(), aData->mTexWidth, aData->mTexHeight, srcRect, destRect, theColor,
+			  theDrawMode, theClipRect, true, theDrawMode ? SDL_SCALEMODE_LINEAR : SDL_SCALEMODE_NEAREST);
 }
 
 void SDLInterface::BltMirror(Image *theImage, float theX, float theY, const Rect &theSrcRect, const Color &theColor,
@@ -577,19 +1321,11 @@ void SDLInterface::BltMirror(Image *theImage, float theX, float theY, const Rect
 
 	SDLTextureData *aData = (SDLTextureData *)aSrcMemoryImage->mD3DData;
 
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
+	SDL_FRect destRect = {theX, theY, (float)theSrcRect.mWidth, (float)theSrcRect.mHeight};
+	SDL_FRect srcRect = aData->MapRect(theSrcRect);
 
-	SDL_Texture *aTexture = aData->mTexture;
-	SDL_SetTextureColorMod(aTexture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
-	SDL_SetTextureAlphaMod(aTexture, theColor.GetAlpha());
-
-	SDL_FRect destRect = {theX, theY, theSrcRect.mWidth, theSrcRect.mHeight};
-	SDL_FRect srcRect = {theSrcRect.mX, theSrcRect.mY, theSrcRect.mWidth, theSrcRect.mHeight};
-
-	SDL_SetTextureBlendMode(aTexture, ChooseBlendMode(theDrawMode));
-
-	SDL_RenderTextureRotated(mRenderer, aTexture, &srcRect, &destRect, 0, nullptr, SDL_FLIP_HORIZONTAL);
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	BatchQuad(aData->mTexture, aData->GetState(), aData->mTexWidth, aData->mTexHeight, srcRect, destRect, theColor,
+			  theDrawMode, nullptr, false, SDL_SCALEMODE_LINEAR, true);
 }
 
 void SDLInterface::StretchBlt(Image *theImage, const Rect &theDestRect, const Rect &theSrcRect, const Rect *theClipRect,
@@ -600,37 +1336,21 @@ void SDLInterface::StretchBlt(Image *theImage, const Rect &theDestRect, const Re
 		return;
 
 	SDLTextureData *aData = static_cast<SDLTextureData *>(aSrcMemoryImage->mD3DData);
-	SDL_Texture *aTexture = aData->mTexture;
-
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
-	SDL_SetTextureColorMod(aTexture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
-	SDL_SetTextureAlphaMod(aTexture, theColor.GetAlpha());
-	SDL_SetTextureScaleMode(aTexture, fastStretch ? SDL_SCALEMODE_NEAREST : SDL_SCALEMODE_LINEAR);
 
 	SDL_FRect destRect = {(float)theDestRect.mX, (float)theDestRect.mY, (float)theDestRect.mWidth,
 						  (float)theDestRect.mHeight};
+	SDL_FRect srcRect = aData->MapRect(theSrcRect);
 
-	if (theClipRect != nullptr)
-	{
-		SDL_Rect clipRect;
-		clipRect = {theClipRect->mX, theClipRect->mY, theClipRect->mWidth, theClipRect->mHeight};
-		SDL_SetRenderClipRect(mRenderer, &clipRect);
-	}
-
-	SDL_FRect srcRect = {(float)theSrcRect.mX, (float)theSrcRect.mY, (float)theSrcRect.mWidth,
-						 (float)theSrcRect.mHeight};
-
-	SDL_SetTextureBlendMode(aTexture, ChooseBlendMode(theDrawMode));
-	SDL_RenderTextureRotated(mRenderer, aTexture, &srcRect, &destRect, 0.0, nullptr,
-							 mirror ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE);
-	SDL_SetRenderClipRect(mRenderer, nullptr);
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	BatchQuad(aData->mTexture, aData->GetState(), aData->mTexWidth, aData->mTexHeight, srcRect, destRect, theColor,
+			  theDrawMode, theClipRect, true, fastStretch ? SDL_SCALEMODE_NEAREST : SDL_SCALEMODE_LINEAR, mirror);
 }
 
 void SDLInterface::BltRotated(Image *theImage, float theX, float theY, const Rect *theClipRect, const Color &theColor,
 							  int theDrawMode, double theRot, float theRotCenterX, float theRotCenterY,
 							  const Rect &theSrcRect)
 {
+	FlushBatch();
+
 	MemoryImage *aSrcMemoryImage = static_cast<MemoryImage *>(theImage);
 	if (!CreateImageTexture(aSrcMemoryImage))
 		return;
@@ -640,34 +1360,28 @@ void SDLInterface::BltRotated(Image *theImage, float theX, float theY, const Rec
 	if (!aTexture)
 		return;
 
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
+	SetRenderTarget(mDrawTarget);
 
-	SDL_SetTextureColorMod(aTexture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
-	SDL_SetTextureAlphaMod(aTexture, theColor.GetAlpha());
+	SetTextureColorMod(aTexture, aData->GetState(), theColor);
 
 	SDL_FRect destRect = {theX, theY, static_cast<float>(theSrcRect.mWidth), static_cast<float>(theSrcRect.mHeight)};
-	SDL_FRect srcRect = {static_cast<float>(theSrcRect.mX), static_cast<float>(theSrcRect.mY),
-						 static_cast<float>(theSrcRect.mWidth), static_cast<float>(theSrcRect.mHeight)};
+	SDL_FRect srcRect = aData->MapRect(theSrcRect);
 
-	if (theClipRect != nullptr)
-	{
-		SDL_Rect clipRect;
-		clipRect = {theClipRect->mX, theClipRect->mY, theClipRect->mWidth, theClipRect->mHeight};
-		SDL_SetRenderClipRect(mRenderer, &clipRect);
-	}
+	SetRenderClipRect(theClipRect);
 
 	SDL_FPoint rotationCenter = {theRotCenterX, theRotCenterY};
 
-	SDL_SetTextureBlendMode(aTexture, ChooseBlendMode(theDrawMode));
+	SetTextureBlendMode(aTexture, aData->GetState(), ChooseBlendMode(theDrawMode));
 	SDL_RenderTextureRotated(mRenderer, aTexture, &srcRect, &destRect, theRot, &rotationCenter, SDL_FLIP_NONE);
-	SDL_SetRenderClipRect(mRenderer, nullptr);
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	CountDrawCall(aTexture, 4, 1);
 }
 
 void SDLInterface::BltTransformed(Image *theImage, const Rect *theClipRect, const Color &theColor, int theDrawMode,
 								  const Rect &theSrcRect, const Matrix3 &theTransform, bool linearFilter,
 								  float theX, float theY, bool center)
 {
+	FlushBatch();
+
 	MemoryImage *aSrcMemoryImage = static_cast<MemoryImage *>(theImage);
 
 	if (!CreateImageTexture(aSrcMemoryImage))
@@ -678,19 +1392,13 @@ void SDLInterface::BltTransformed(Image *theImage, const Rect *theClipRect, cons
 		return;
 
 	SDL_Texture *aTexture = aData->mTexture;
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
+	SetRenderTarget(mDrawTarget);
 
-	SDL_SetTextureColorMod(aTexture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
-	SDL_SetTextureAlphaMod(aTexture, theColor.GetAlpha());
+	SetTextureColorMod(aTexture, aData->GetState(), theColor);
 
-	if (theClipRect != nullptr)
-	{
-		SDL_Rect clipRect;
-		clipRect = {theClipRect->mX, theClipRect->mY, theClipRect->mWidth, theClipRect->mHeight};
-		SDL_SetRenderClipRect(mRenderer, &clipRect);
-	}
+	SetRenderClipRect(theClipRect);
 
-	SDL_SetTextureBlendMode(aTexture, ChooseBlendMode(theDrawMode));
+	SetTextureBlendMode(aTexture, aData->GetState(), ChooseBlendMode(theDrawMode));
 
 	float halfWidth = theSrcRect.mWidth * 0.5f;
 	float halfHeight = theSrcRect.mHeight * 0.5f;
@@ -704,10 +1412,11 @@ void SDLInterface::BltTransformed(Image *theImage, const Rect *theClipRect, cons
 	float x4 = x2;
 	float y4 = y3;
 
-	float u1 = static_cast<float>(theSrcRect.mX) / theImage->mWidth;
-	float v1 = static_cast<float>(theSrcRect.mY) / theImage->mHeight;
-	float u2 = static_cast<float>(theSrcRect.mX + theSrcRect.mWidth) / theImage->mWidth;
-	float v2 = static_cast<float>(theSrcRect.mY + theSrcRect.mHeight) / theImage->mHeight;
+	SDL_FRect aTexRect = aData->MapRect(theSrcRect);
+	float u1 = aTexRect.x / aData->mTexWidth;
+	float v1 = aTexRect.y / aData->mTexHeight;
+	float u2 = (aTexRect.x + aTexRect.w) / aData->mTexWidth;
+	float v2 = (aTexRect.y + aTexRect.h) / aData->mTexHeight;
 
 	SDL_FColor aColor = {theColor.GetRed() / 255.0f, theColor.GetGreen() / 255.0f, theColor.GetBlue() / 255.0f,
 						 theColor.GetAlpha() / 255.0f};
@@ -722,49 +1431,71 @@ void SDLInterface::BltTransformed(Image *theImage, const Rect *theClipRect, cons
 	int indices[] = {0, 1, 2, 1, 3, 2};
 
 	SDL_RenderGeometry(mRenderer, aTexture, vertices, 4, indices, 6);
-	SDL_SetRenderClipRect(mRenderer, nullptr);
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	CountDrawCall(aTexture, 4, 1);
 }
 
 void SDLInterface::DrawLine(double theStartX, double theStartY, double theEndX, double theEndY, const Color &theColor,
 							int theDrawMode)
 {
+	FlushBatch();
+
 	if (!mRenderer)
 		return;
 
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
+	SetRenderTarget(mDrawTarget);
+	SetRenderClipRect(nullptr);
 
-	SDL_SetRenderDrawBlendMode(mRenderer, ChooseBlendMode(theDrawMode));
-	SDL_SetRenderDrawColor(mRenderer, theColor.mRed, theColor.mGreen, theColor.mBlue, theColor.mAlpha);
+	SetRenderDrawBlendMode(ChooseBlendMode(theDrawMode));
+	SetRenderDrawColor(theColor);
 
 	SDL_RenderLine(mRenderer, theStartX, theStartY, theEndX, theEndY);
-
-	SDL_SetRenderDrawBlendMode(mRenderer, ChooseBlendMode(Graphics::DRAWMODE_NORMAL));
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	CountDrawCall(nullptr, 2, 0);
 }
 
 void SDLInterface::FillRect(const Rect &theRect, const Color &theColor, int theDrawMode)
 {
+	FlushBatch();
+
 	if (!mRenderer)
 		return;
 
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
+	SetRenderTarget(mDrawTarget);
+	SetRenderClipRect(nullptr);
 
 	SDL_FRect theSDLRect = {theRect.mX, theRect.mY, theRect.mWidth, theRect.mHeight};
 
-	SDL_SetRenderDrawColor(mRenderer, theColor.mRed, theColor.mGreen, theColor.mBlue, theColor.mAlpha);
+	SetRenderDrawColor(theColor);
 
-	SDL_SetRenderDrawBlendMode(mRenderer, ChooseBlendMode(theDrawMode));
+	SetRenderDrawBlendMode(ChooseBlendMode(theDrawMode));
 	SDL_RenderFillRect(mRenderer, &theSDLRect);
+	CountDrawCall(nullptr, 4, 0);
+}
+
+void SDLInterface::ClearRect(const Rect &theRect)
+{
+	FlushBatch();
+
+	if (!mRenderer)
+		return;
 
-	SDL_SetRenderDrawBlendMode(mRenderer, ChooseBlendMode(Graphics::DRAWMODE_NORMAL));
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	SetRenderTarget(mDrawTarget);
+	SetRenderClipRect(nullptr);
+
+	SDL_FRect theSDLRect = {(float)theRect.mX, (float)theRect.mY, (float)theRect.mWidth, (float)theRect.mHeight};
+
+	SetRenderDrawColor(Color(0, 0, 0, 0));
+	SetRenderDrawBlendMode(SDL_BLENDMODE_NONE);
+	SDL_RenderFillRect(mRenderer, &theSDLRect);
+	CountDrawCall(nullptr, 4, 0);
 }
 
 void SDLInterface::DrawTriangle(const TriVertex &p1, const TriVertex &p2, const TriVertex &p3, const Color &theColor,
 								int theDrawMode)
 {
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
+	FlushBatch();
+
+	SetRenderTarget(mDrawTarget);
+	SetRenderClipRect(nullptr);
 
 	SDL_FColor aColor = {theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue(), theColor.GetAlpha()};
 
@@ -775,12 +1506,14 @@ void SDLInterface::DrawTriangle(const TriVertex &p1, const TriVertex &p2, const
 							  {SDL_FPoint{p3.x, p3.y}, aColor, {p3.u, p3.v}}};
 
 	SDL_RenderGeometry(mRenderer, nullptr, vertices, 3, indices, 3);
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	CountDrawCall(nullptr, 3, 0);
 }
 
 void SDLInterface::DrawTriangleTex(const TriVertex &p1, const TriVertex &p2, const TriVertex &p3, const Color &theColor,
 								   int theDrawMode, Image *theTexture, bool blend)
 {
+	FlushBatch();
+
 	MemoryImage *aSrcMemoryImage = (MemoryImage *)theTexture;
 
 	if (!CreateImageTexture(aSrcMemoryImage))
@@ -788,12 +1521,12 @@ void SDLInterface::DrawTriangleTex(const TriVertex &p1, const TriVertex &p2, con
 
 	SDLTextureData *aData = (SDLTextureData *)aSrcMemoryImage->mD3DData;
 
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
+	SetRenderTarget(mDrawTarget);
+	SetRenderClipRect(nullptr);
 
 	SDL_Texture *aTexture = aData->mTexture;
-	SDL_SetTextureColorMod(aTexture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
-	SDL_SetTextureAlphaMod(aTexture, theColor.GetAlpha());
-	SDL_SetTextureBlendMode(aTexture, ChooseBlendMode(theDrawMode));
+	SetTextureColorMod(aTexture, aData->GetState(), theColor);
+	SetTextureBlendMode(aTexture, aData->GetState(), ChooseBlendMode(theDrawMode));
 
 	SDL_FColor aColor = {theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue(), theColor.GetAlpha()};
 
@@ -802,14 +1535,18 @@ void SDLInterface::DrawTriangleTex(const TriVertex &p1, const TriVertex &p2, con
 	SDL_Vertex vertices[3] = {{SDL_FPoint{p1.x, p1.y}, aColor, {p1.u, p1.v}},
 							  {SDL_FPoint{p2.x, p2.y}, aColor, {p2.u, p2.v}},
 							  {SDL_FPoint{p3.x, p3.y}, aColor, {p3.u, p3.v}}};
+	for (int i = 0; i < 3; i++)
+		aData->MapUV(vertices[i].tex_coord.x, vertices[i].tex_coord.y);
 
 	SDL_RenderGeometry(mRenderer, aTexture, vertices, 3, indices, 3);
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	CountDrawCall(aTexture, 3, 0);
 }
 
 void SDLInterface::DrawTrianglesTex(const TriVertex theVertices[][3], int theNumTriangles, const Color &theColor,
 									int theDrawMode, Image *theTexture, float tx, float ty, bool blend)
 {
+	FlushBatch();
+
 	MemoryImage *aSrcMemoryImage = (MemoryImage *)theTexture;
 
 	if (!CreateImageTexture(aSrcMemoryImage))
@@ -817,12 +1554,12 @@ void SDLInterface::DrawTrianglesTex(const TriVertex theVertices[][3], int theNum
 
 	SDLTextureData *aData = (SDLTextureData *)aSrcMemoryImage->mD3DData;
 
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
+	SetRenderTarget(mDrawTarget);
+	SetRenderClipRect(nullptr);
 
 	SDL_Texture *aTexture = aData->mTexture;
-	SDL_SetTextureColorMod(aTexture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
-	SDL_SetTextureAlphaMod(aTexture, theColor.GetAlpha());
-	SDL_SetTextureBlendMode(aTexture, ChooseBlendMode(theDrawMode));
+	SetTextureColorMod(aTexture, aData->GetState(), theColor);
+	SetTextureBlendMode(aTexture, aData->GetState(), ChooseBlendMode(theDrawMode));
 
 	for (int aTriangleNum = 0; aTriangleNum < theNumTriangles; aTriangleNum++)
 	{
@@ -858,16 +1595,22 @@ void SDLInterface::DrawTrianglesTex(const TriVertex theVertices[][3], int theNum
 		vertices[0].color = aColor[0];
 		vertices[1].color = aColor[1];
 		vertices[2].color = aColor[2];
+		for (int i = 0; i < 3; i++)
+		{
+			vertices[i].tex_coord = SDL_FPoint{theCurrentVertex[i].u, theCurrentVertex[i].v};
+			aData->MapUV(vertices[i].tex_coord.x, vertices[i].tex_coord.y);
+		}
 
 		SDL_RenderGeometry(mRenderer, aTexture, vertices, 3, nullptr, 3);
+		CountDrawCall(aTexture, 3, 0);
 	}
-
-	SDL_SetRenderTarget(mRenderer, nullptr);
 }
 
 void SDLInterface::DrawTrianglesTexStrip(const TriVertex theVertices[], int theNumTriangles, const Color &theColor,
 										 int theDrawMode, Image *theTexture, float tx, float ty, bool blend)
 {
+	FlushBatch();
+
 	if (theNumTriangles < 3)
 		return;
 
@@ -886,27 +1629,31 @@ void SDLInterface::DrawTrianglesTexStrip(const TriVertex theVertices[], int theN
 		const TriVertex &v = theVertices[i];
 		positions.push_back(v.x + tx);
 		positions.push_back(v.y + ty);
-		uvs.push_back(v.u);
-		uvs.push_back(v.v);
+		float aU = v.u;
+		float aV = v.v;
+		aData->MapUV(aU, aV);
+		uvs.push_back(aU);
+		uvs.push_back(aV);
 
 		SDL_FColor color = {(v.color >> 16) & 0xFF, (v.color >> 8) & 0xFF, v.color & 0xFF, (v.color >> 24) & 0xFF};
 		colors.push_back(color);
 	}
 
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
-	SDL_SetTextureBlendMode(aTexture, ChooseBlendMode(theDrawMode));
-	SDL_SetTextureColorMod(aTexture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
-	SDL_SetTextureAlphaMod(aTexture, theColor.GetAlpha());
+	SetRenderTarget(mDrawTarget);
+	SetRenderClipRect(nullptr);
+	SetTextureBlendMode(aTexture, aData->GetState(), ChooseBlendMode(theDrawMode));
+	SetTextureColorMod(aTexture, aData->GetState(), theColor);
 
 	SDL_RenderGeometryRaw(mRenderer, aTexture, positions.data(), sizeof(float) * 2, colors.data(), sizeof(SDL_FColor),
 						  uvs.data(), sizeof(float) * 2, positions.size() / 2, nullptr, 0, 0);
-
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	CountDrawCall(aTexture, (int)positions.size() / 2, 0);
 }
 
 void SDLInterface::FillPoly(const Point theVertices[], int theNumVertices, const Rect *theClipRect,
 							const Color &theColor, int theDrawMode, int tx, int ty)
 {
+	FlushBatch();
+
 	if (theNumVertices < 3)
 		if (theNumVertices == 2)
 		{
@@ -915,35 +1662,30 @@ void SDLInterface::FillPoly(const Point theVertices[], int theNumVertices, const
 		}
 			
 
-	if (theClipRect != nullptr)
+	SetRenderTarget(mDrawTarget);
+	SetRenderClipRect(theClipRect);
+	SetRenderDrawBlendMode(ChooseBlendMode(theDrawMode));
+	SetRenderDrawColor(theColor);
+
+	for (int i = 0; i < theNumVertices; i++)
 	{
-		SDL_Rect clipRect;
-		clipRect = {theClipRect->mX, theClipRect->mY, theClipRect->mWidth, theClipRect->mHeight};
-		SDL_SetRenderClipRect(mRenderer, &clipRect);
+		const Point &aStart = theVertices[i];
+		const Point &anEnd = theVertices[(i + 1) % theNumVertices];
+		SDL_RenderLine(mRenderer, aStart.mX + tx, aStart.mY + ty, anEnd.mX + tx, anEnd.mY + ty);
+		CountDrawCall(nullptr, 2, 0);
 	}
-
-	for (int i = 0; i < theNumVertices - 1; i++)
-		DrawLine(theVertices[i].mX + tx, theVertices[i].mY + ty, theVertices[i + 1].mX + tx, theVertices[i + 1].mY + ty, theColor,
-				 theDrawMode);
-
-	DrawLine(theVertices[theNumVertices - 1].mX + tx, theVertices[theNumVertices - 1].mY + ty, theVertices[0].mX + tx,
-			 theVertices[0].mY + ty, theColor, theDrawMode);
-
-	SDL_SetRenderClipRect(mRenderer, nullptr);
 }
 
 void SDLInterface::BltTexture(SDL_Texture *theTexture, const SDL_FRect &theSrcRect, const SDL_FRect &theDestRect,
 				const Color &theColor, int theDrawMode)
 {
-	SDL_SetRenderTarget(mRenderer, mScreenTexture);
+	FlushBatch();
 
-	SDL_SetTextureColorMod(theTexture, theColor.GetRed(), theColor.GetGreen(), theColor.GetBlue());
-	SDL_SetTextureAlphaMod(theTexture, theColor.GetAlpha());
+	SetRenderTarget(mDrawTarget);
+	SetRenderClipRect(nullptr);
 
-	SDL_SetTextureBlendMode(theTexture, ChooseBlendMode(theDrawMode));
+	SetTextureColorMod(theTexture, nullptr, theColor);
+	SetTextureBlendMode(theTexture, nullptr, ChooseBlendMode(theDrawMode));
 	SDL_RenderTexture(mRenderer, theTexture, &theSrcRect, &theDestRect);
-
-	SDL_SetTextureBlendMode(theTexture, SDL_BLENDMODE_NONE);
-
-	SDL_SetRenderTarget(mRenderer, nullptr);
+	CountDrawCall(theTexture, 4, 1);
 }
\ No newline at end of file
@@ -25,35 +25,103 @@ class TriVertex;
 typedef std::set<SDLImage *> SDLImageSet;
 typedef std::set<MemoryImage *> ImageSet;
 typedef std::list<Matrix3> TransformStack;
+typedef std::list<MemoryImage *> ImageList;
 
 enum SDLImageFlags
 {
 	SDLImageFlag_NearestFiltering = 0x0001, // Uses nearest filtering for the texture
-											// 0x0002
+	SDLImageFlag_RenderTarget = 0x0002,		// Texture is a render target that SDLImage draws go into
 											// 0x0004
 											// 0x0008
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// Shadow copy of the per-texture SDL state, so unchanged mods aren't re-applied
+///////////////////////////////////////////////////////////////////////////////
+struct SDLTextureState
+{
+  public:
+	Color mColorMod;
+	SDL_BlendMode mBlendMode;
+	SDL_ScaleMode mScaleMode;
+	bool mColorModKnown;
+	bool mBlendModeKnown;
+	bool mScaleModeKnown;
+
+	SDLTextureState();
+
+	void Invalidate();
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 struct SDLTextureData
 {
   public:
 	SDL_Texture *mTexture;
+	SDLTextureState mState;
 	int mWidth;
 	int mHeight;
+	int mTexWidth;	// size of mTexture, the page size for atlased images
+	int mTexHeight;
 	int mBitsChangedCount;
 	SDL_Renderer *mRenderer;
+	bool mIsTarget;		// created with SDL_TEXTUREACCESS_TARGET
+	bool mIsStreaming; // created with SDL_TEXTUREACCESS_STREAMING for a volatile image
+	bool mTargetDirty; // the GPU copy has been drawn to since the bits were last read back
+
+	int mLastUsedFrame; // SDLInterface::mFrameNum of the last draw, for LRU eviction
+
+	MemoryImage *mAtlasPage; // shared page this image was packed into, mTexture is then borrowed from it
+	int mAtlasX;			 // position of the image inside mAtlasPage
+	int mAtlasY;
 
 	SDLTextureData(SDL_Renderer *theRenderer);
 	~SDLTextureData();
 
 	void ReleaseTextures();
 
-	void CreateTextures(MemoryImage *theImage);
-	void CheckCreateTextures(MemoryImage *theImage);
+	SDLTextureState *GetState();
+	SDL_FRect MapRect(const Rect &theRect) const;
+	void MapUV(float &theU, float &theV) const;
+
+	// These return the number of bytes uploaded
+	int CreateTextures(MemoryImage *theImage);
+	int CheckCreateTextures(MemoryImage *theImage);
+	int UploadRect(MemoryImage *theImage, const Rect &theRect);
 
 	int GetMemSize();
+
+	static inline int gTextureCount = 0; // SDL textures currently owned by any SDLTextureData
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// What one frame sent to the renderer, counted by SDLInterface as it submits
+///////////////////////////////////////////////////////////////////////////////
+struct RenderStats
+{
+	int mDrawCalls;			  // SDL_Render* calls that draw something
+	int mBatches;			  // of those, batched quad flushes
+	int mVertices;			  // vertices submitted
+	int mQuads;				  // textured quads submitted, batched or not
+	int mTextureBinds;		  // draw calls using a different texture than the draw before
+	int mTargetSwitches;	  // render target changes
+	int mClipChanges;		  // clip rect changes
+	int mStateChangesAvoided; // redundant SDL state calls skipped
+	int mTextureUploads;	  // texture creations and sub-rect updates
+	int mUploadBytes;		  // bytes sent by those uploads
+	int mLiveTextures;		  // textures alive at the end of the frame
+	int64_t mTextureMemory;	  // estimated VRAM in use at the end of the frame, the screen texture included
+
+	RenderStats()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		memset(this, 0, sizeof(*this));
+	}
 };
 
 class SDLInterface : public NativeDisplay
@@ -98,10 +166,59 @@ class SDLInterface : public NativeDisplay
 	SDLImageSet mSDLImageSet;
 	TransformStack mTransformStack;
 
+	// Sprite batching: quads sharing a texture, blend mode, scale mode and clip
+	// are accumulated here and submitted with a single SDL_RenderGeometry call.
+	std::vector<SDL_Vertex> mBatchVertices;
+	std::vector<int> mBatchIndices;
+	SDL_Texture *mBatchTexture;
+	SDLTextureState *mBatchTextureState;
+	SDL_BlendMode mBatchBlendMode;
+	SDL_ScaleMode mBatchScaleMode;
+	bool mBatchHasScaleMode;
+	bool mBatchHasClip;
+	Rect mBatchClipRect;
+
+	// Render-state cache: shadow copy of the renderer state last sent to SDL
+	SDL_Texture *mCurrentTarget;
+	bool mTargetKnown;
+	Rect mClipRect;
+	bool mClipEnabled;
+	bool mClipKnown;
+	Color mDrawColor;
+	bool mDrawColorKnown;
+	SDL_BlendMode mDrawBlendMode;
+	bool mDrawBlendModeKnown;
+	SDLTextureState mScreenTextureState;
+
+	// Per-frame counters: mFrameStats fills up during the frame and is pushed into the
+	// mStatsHistory ring at Redraw, see GetRenderStats
+	enum
+	{
+		STATS_HISTORY = 120
+	};
+	RenderStats mFrameStats;
+	RenderStats mStatsHistory[STATS_HISTORY];
+	int mStatsHistoryCount; // frames pushed into mStatsHistory so far
+	SDL_Texture *mLastDrawTexture;
+
+	// Texture memory budget: once mTextureMemory exceeds a non-zero mTextureMemoryBudget, the least
+	// recently drawn textures that can be rebuilt from their bits are released until it fits again
+	int64_t mTextureMemory;
+	int64_t mTextureMemoryBudget;
+	int mFrameNum;
+	int mTexturesEvicted;
+
+	// Upload queue: images queued from any thread get their textures created at the end of
+	// Redraw, within mUploadBudgetMS milliseconds and mUploadBudgetBytes bytes per frame
+	ImageList mUploadQueue;
+	int mUploadBudgetMS;
+	int mUploadBudgetBytes;
+
   public:
 	SDL_Renderer *mRenderer;
 	SDL_Window *mWindow;
 	SDL_Texture *mScreenTexture;
+	SDL_Texture *mDrawTarget; // where the draw functions currently render, mScreenTexture or an SDLImage target
 
   public:
 	void AddSDLImage(SDLImage *theSDLImage);
@@ -141,9 +258,54 @@ class SDLInterface : public NativeDisplay
 
 	bool CreateImageTexture(MemoryImage *theImage);
 	bool RecoverBits(MemoryImage *theImage);
+	void SetDrawTarget(SDLImage *theImage);
+
+	void SetTextureMemoryBudget(int64_t theBytes);
+	void EnforceTextureBudget();
+
+	void QueueTextureUpload(MemoryImage *theImage);
+	void ProcessUploadQueue();
+	int GetUploadQueueSize();
+	bool IsTextureResident(MemoryImage *theImage);
+
+	// Texture atlases, see TextureAtlas
+	void AddToAtlas(MemoryImage *theImage, MemoryImage *thePage, int theX, int theY);
+	void DetachFromAtlas(MemoryImage *theImage);
+	void RemoveAtlasPage(MemoryImage *thePage);
+	bool CreateAtlasTexture(MemoryImage *theImage);
 
 	SDL_BlendMode ChooseBlendMode(int theBlendMode);
 
+	void BatchQuad(SDL_Texture *theTexture, SDLTextureState *theTextureState, int theTexWidth, int theTexHeight,
+				   const SDL_FRect &theSrcRect, const SDL_FRect &theDestRect, const Color &theColor, int theDrawMode,
+				   const Rect *theClipRect, bool hasScaleMode, SDL_ScaleMode theScaleMode, bool mirror = false);
+	void FlushBatch();
+
+	// Counts one SDL draw call against mFrameStats
+	void CountDrawCall(SDL_Texture *theTexture, int theVertexCount, int theQuadCount)
+	{
+		mFrameStats.mDrawCalls++;
+		mFrameStats.mVertices += theVertexCount;
+		mFrameStats.mQuads += theQuadCount;
+		if (theTexture != nullptr && theTexture != mLastDrawTexture)
+			mFrameStats.mTextureBinds++;
+		mLastDrawTexture = theTexture;
+	}
+
+	// Stats of a presented frame, 0 being the last one. Frames that aren't kept anymore come back empty.
+	const RenderStats &GetRenderStats(int theFramesAgo = 0);
+	int GetRenderStatsCount();
+
+	// Cached state setters, theState may be nullptr for textures we don't track
+	void InvalidateRenderState();
+	void SetRenderTarget(SDL_Texture *theTarget);
+	void SetRenderClipRect(const Rect *theClipRect);
+	void SetRenderDrawColor(const Color &theColor);
+	void SetRenderDrawBlendMode(SDL_BlendMode theBlendMode);
+	void SetTextureColorMod(SDL_Texture *theTexture, SDLTextureState *theState, const Color &theColor);
+	void SetTextureBlendMode(SDL_Texture *theTexture, SDLTextureState *theState, SDL_BlendMode theBlendMode);
+	void SetTextureScaleMode(SDL_Texture *theTexture, SDLTextureState *theState, SDL_ScaleMode theScaleMode);
+
 	// Draw Funcs
 	void Blt(Image *theImage, int theX, int theY, const Rect &theSrcRect, const Color &theColor, int theDrawMode,
 			 bool linearFilter = false);
@@ -161,6 +323,7 @@ class SDLInterface : public NativeDisplay
 	void DrawLine(double theStartX, double theStartY, double theEndX, double theEndY, const Color &theColor,
 				  int theDrawMode);
 	void FillRect(const Rect &theRect, const Color &theColor, int theDrawMode);
+	void ClearRect(const Rect &theRect);
 	void DrawTriangle(const TriVertex &p1, const TriVertex &p2, const TriVertex &p3, const Color &theColor,
 					  int theDrawMode);
 	void DrawTriangleTex(const TriVertex &p1, const TriVertex &p2, const TriVertex &p3, const Color &theColor,
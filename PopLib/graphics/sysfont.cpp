@@ -8,23 +8,28 @@
 #include "widget/widgetmanager.hpp"
 
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 
 using namespace PopLib;
 
 SysFont::SysFont(const std::string &theFace, int thePointSize, bool bold, bool italics, bool underline)
 {
+	InitGlyphCache();
 	Init(gAppBase, theFace, thePointSize, 0, bold, italics, underline, false);
 }
 
 SysFont::SysFont(AppBase *theApp, const std::string &theFace, int thePointSize, int theScript, bool bold, bool italics,
 				 bool underline)
 {
+	InitGlyphCache();
 	Init(theApp, theFace, thePointSize, theScript, bold, italics, underline, true);
 }
 
 SysFont::SysFont(AppBase *theApp, const unsigned char aData[], size_t aDataSize, int thePointSize, int theScript,
 				 bool bold, bool italics, bool underline)
 {
+	InitGlyphCache();
 	mApp = theApp;
 	SDL_IOStream *io = SDL_IOFromConstMem((void *)aData, aDataSize);
 	if (!io)
@@ -71,8 +76,17 @@ void SysFont::Init(AppBase *theApp, const std::string &theFace, int thePointSize
 	mSimulateBold = false;
 }
 
+void SysFont::InitGlyphCache()
+{
+	mGlyphImage = nullptr;
+	mGlyphPackX = 0;
+	mGlyphPackY = 0;
+	mGlyphRowHeight = 0;
+}
+
 SysFont::SysFont(const SysFont &theSysFont)
 {
+	InitGlyphCache();
 	mTTFFont = theSysFont.mTTFFont;
 	mApp = theSysFont.mApp;
 	mHeight = theSysFont.mHeight;
@@ -84,6 +98,7 @@ SysFont::SysFont(const SysFont &theSysFont)
 
 SysFont::~SysFont()
 {
+	delete mGlyphImage;
 	TTF_CloseFont(mTTFFont);
 }
 
@@ -181,47 +196,210 @@ ImageFont *SysFont::CreateImageFont()
 	return nullptr; // TODO: implement
 }
 
-int SysFont::StringWidth(const PopString &theString)
+/// <summary>
+/// Clears every cached glyph, the image keeps its size so it can be refilled without reallocating
+/// </summary>
+void SysFont::ClearGlyphCache()
 {
-	int w = 0;
-	TTF_GetStringSize(mTTFFont, theString.c_str(), 0, &w, nullptr);
+	mGlyphMap.clear();
+	mGlyphPackX = 0;
+	mGlyphPackY = 0;
+	mGlyphRowHeight = 0;
 
-	return w;
+	if (mGlyphImage != nullptr)
+	{
+		memset(mGlyphImage->GetBits(), 0, mGlyphImage->mWidth * mGlyphImage->mHeight * sizeof(ulong));
+		mGlyphImage->BitsChanged();
+	}
 }
 
-void SysFont::DrawString(Graphics *g, int theX, int theY, const PopString &theString, const Color &theColor,
-						 const Rect &theClipRect)
+/// <summary>
+/// Finds room for a glyph in the glyph image, growing it (or starting over once it is at its max size)
+/// </summary>
+bool SysFont::PackGlyph(int theWidth, int theHeight, Rect &theRect)
 {
-	SDL_Renderer *renderer = mApp->mSDLInterface->mRenderer;
-	SDL_Color aColor = {(Uint8)theColor.mRed, (Uint8)theColor.mGreen, (Uint8)theColor.mBlue, (Uint8)theColor.mAlpha};
-	SDL_Surface *textSurface =
-		TTF_RenderText_Blended(mTTFFont, theString.c_str(), 0, aColor);
-	if (!textSurface)
+	// leave a transparent gap around each glyph so filtering doesn't pick up its neighbours
+	int aWidth = theWidth + 1;
+	int aHeight = theHeight + 1;
+
+	if (aWidth > GLYPH_IMAGE_WIDTH || aHeight > GLYPH_IMAGE_MAX_HEIGHT)
+		return false;
+
+	if (mGlyphImage == nullptr)
 	{
-		mApp->mSDLInterface->MakeSimpleMessageBox("Failed to render text: ", SDL_GetError(), SDL_MESSAGEBOX_ERROR);
-		return;
+		mGlyphImage = new SDLImage(mApp->mSDLInterface);
+		mGlyphImage->mPurgeBits = false;
+		mGlyphImage->Create(GLYPH_IMAGE_WIDTH, GLYPH_IMAGE_START_HEIGHT);
+		memset(mGlyphImage->GetBits(), 0, GLYPH_IMAGE_WIDTH * GLYPH_IMAGE_START_HEIGHT * sizeof(ulong));
 	}
 
-	SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-	SDL_FRect dstRect = {(float)theX, (float)theY - (float)mAscent, (float)textSurface->w, (float)textSurface->h};
-	SDL_FRect srcRect = {0, 0, dstRect.w, dstRect.h};
-	SDL_DestroySurface(textSurface);
+	if (mGlyphPackX + aWidth > mGlyphImage->mWidth)
+	{
+		mGlyphPackX = 0;
+		mGlyphPackY += mGlyphRowHeight;
+		mGlyphRowHeight = 0;
+	}
 
-	if (!textTexture)
+	while (mGlyphPackY + aHeight > mGlyphImage->mHeight)
 	{
-		mApp->mSDLInterface->MakeSimpleMessageBox("Failed to create texture from surface: ", SDL_GetError(),
-												  SDL_MESSAGEBOX_ERROR);
+		if (mGlyphImage->mHeight >= GLYPH_IMAGE_MAX_HEIGHT)
+		{
+			// full, only the glyphs still in use will be rasterized again
+			ClearGlyphCache();
+			break;
+		}
+
+		int aNewHeight = std::min(mGlyphImage->mHeight * 2, (int)GLYPH_IMAGE_MAX_HEIGHT);
+		int anOldSize = mGlyphImage->mWidth * mGlyphImage->mHeight;
+		int aNewSize = mGlyphImage->mWidth * aNewHeight;
+
+		ulong *aNewBits = new ulong[aNewSize];
+		memcpy(aNewBits, mGlyphImage->GetBits(), anOldSize * sizeof(ulong));
+		memset(aNewBits + anOldSize, 0, (aNewSize - anOldSize) * sizeof(ulong));
+		mGlyphImage->SetBits(aNewBits, mGlyphImage->mWidth, aNewHeight, false);
+		delete[] aNewBits;
 	}
 
-	if (mDrawShadow)
+	theRect = Rect(mGlyphPackX, mGlyphPackY, theWidth, theHeight);
+	mGlyphPackX += aWidth;
+	mGlyphRowHeight = std::max(mGlyphRowHeight, aHeight);
+	return true;
+}
+
+/// <summary>
+/// Returns the cached glyph for a codepoint, rasterizing it into the glyph image the first time it is seen
+/// </summary>
+const SysFont::GlyphInfo *SysFont::GetGlyph(uint32_t theChar)
+{
+	GlyphMap::iterator anItr = mGlyphMap.find(theChar);
+	if (anItr != mGlyphMap.end())
+		return &anItr->second;
+
+	if (mTTFFont == nullptr)
+		return nullptr;
+
+	GlyphInfo aGlyph;
+	aGlyph.mAdvance = 0;
+	TTF_GetGlyphMetrics(mTTFFont, theChar, nullptr, nullptr, nullptr, nullptr, &aGlyph.mAdvance);
+
+	// rendered in white and tinted at draw time, so one copy serves every color
+	SDL_Color aWhite = {255, 255, 255, 255};
+	SDL_Surface *aSurface = TTF_RenderGlyph_Blended(mTTFFont, theChar, aWhite);
+	if (aSurface != nullptr && aSurface->format != SDL_PIXELFORMAT_ARGB8888)
+	{
+		SDL_Surface *aConverted = SDL_ConvertSurface(aSurface, SDL_PIXELFORMAT_ARGB8888);
+		SDL_DestroySurface(aSurface);
+		aSurface = aConverted;
+	}
+
+	if (aSurface != nullptr && aSurface->w > 0 && aSurface->h > 0 &&
+		PackGlyph(aSurface->w, aSurface->h, aGlyph.mImageRect))
+	{
+		ulong *aBits = mGlyphImage->GetBits();
+		for (int y = 0; y < aSurface->h; y++)
+		{
+			memcpy(aBits + (aGlyph.mImageRect.mY + y) * mGlyphImage->mWidth + aGlyph.mImageRect.mX,
+				   (uchar *)aSurface->pixels + y * aSurface->pitch, aSurface->w * sizeof(ulong));
+		}
+		mGlyphImage->BitsChanged(aGlyph.mImageRect);
+	}
+	else
 	{
-		SDL_FRect shadowRect = {(float)theX + 1.f, (float)theY - (float)mAscent + 1.f, dstRect.w, dstRect.h};
-		mApp->mSDLInterface->BltTexture(textTexture, srcRect, shadowRect, Color(0, 0, 0), g->GetDrawMode());
+		aGlyph.mImageRect = Rect(0, 0, 0, 0);
 	}
 
-	mApp->mSDLInterface->BltTexture(textTexture, srcRect, dstRect, theColor, g->GetDrawMode());
+	if (aSurface != nullptr)
+		SDL_DestroySurface(aSurface);
+
+	return &mGlyphMap.insert(GlyphMap::value_type(theChar, aGlyph)).first->second;
+}
+
+/// <summary>
+/// The same advance GetGlyph caches, without rasterizing a glyph that's only being measured
+/// </summary>
+int SysFont::GetGlyphAdvance(uint32_t theChar)
+{
+	GlyphMap::iterator anItr = mGlyphMap.find(theChar);
+	if (anItr != mGlyphMap.end())
+		return anItr->second.mAdvance;
+
+	int anAdvance = 0;
+	TTF_GetGlyphMetrics(mTTFFont, theChar, nullptr, nullptr, nullptr, nullptr, &anAdvance);
+	return anAdvance;
+}
+
+int SysFont::StringWidth(const PopString &theString)
+{
+	WidthCache::iterator anItr = mWidthCache.find(theString);
+	if (anItr != mWidthCache.end())
+		return anItr->second;
+
+	// walks the string exactly like DrawString places it, so measured and drawn text line up
+	int w = 0;
+	uint32_t aPrevChar = 0;
+	const char *aPtr = theString.c_str();
+	size_t aLength = theString.length();
+	while (mTTFFont != nullptr && aLength > 0)
+	{
+		uint32_t aChar = SDL_StepUTF8(&aPtr, &aLength);
+		if (aChar == 0)
+			break;
+
+		int aKerning = 0;
+		if (aPrevChar != 0 && TTF_GetGlyphKerning(mTTFFont, aPrevChar, aChar, &aKerning))
+			w += aKerning;
+		aPrevChar = aChar;
+
+		w += GetGlyphAdvance(aChar);
+	}
+
+	if (mWidthCache.size() >= WIDTH_CACHE_MAX_SIZE)
+		mWidthCache.clear();
+	mWidthCache.insert(WidthCache::value_type(theString, w));
+
+	return w;
+}
+
+void SysFont::DrawString(Graphics *g, int theX, int theY, const PopString &theString, const Color &theColor,
+						 const Rect &theClipRect)
+{
+	Color anOrigColor = g->GetColor();
+	bool colorizeImages = g->GetColorizeImages();
+	g->SetColorizeImages(true);
+
+	// the shadow pass goes first so both passes come out of the same texture back to back
+	for (int aPass = mDrawShadow ? 0 : 1; aPass < 2; aPass++)
+	{
+		int anOffset = (aPass == 0) ? 1 : 0;
+		g->SetColor((aPass == 0) ? Color(0, 0, 0, theColor.mAlpha) : theColor);
+
+		int aPenX = theX;
+		uint32_t aPrevChar = 0;
+		const char *aPtr = theString.c_str();
+		size_t aLength = theString.length();
+		while (aLength > 0)
+		{
+			uint32_t aChar = SDL_StepUTF8(&aPtr, &aLength);
+			if (aChar == 0)
+				break;
+
+			int aKerning = 0;
+			if (aPrevChar != 0 && TTF_GetGlyphKerning(mTTFFont, aPrevChar, aChar, &aKerning))
+				aPenX += aKerning;
+			aPrevChar = aChar;
+
+			const GlyphInfo *aGlyph = GetGlyph(aChar);
+			if (aGlyph == nullptr)
+				continue;
+
+			if (aGlyph->mImageRect.mWidth > 0)
+				g->DrawImage(mGlyphImage, aPenX + anOffset, theY - mAscent + anOffset, aGlyph->mImageRect);
+			aPenX += aGlyph->mAdvance;
+		}
+	}
 
-	SDL_DestroyTexture(textTexture);
+	g->SetColor(anOrigColor);
+	g->SetColorizeImages(colorizeImages);
 }
 
 Font *SysFont::Duplicate()
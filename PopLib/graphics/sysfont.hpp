@@ -8,23 +8,59 @@
 #include "common.hpp"
 
 #include <SDL3_ttf/SDL_ttf.h>
+#include <map>
 
 namespace PopLib
 {
 
 class ImageFont;
 class AppBase;
+class SDLImage;
 
 class SysFont : public Font
 {
+  public:
+	struct GlyphInfo
+	{
+		Rect mImageRect; // area inside mGlyphImage, empty for blank glyphs
+		int mAdvance;
+	};
+
+	typedef std::map<uint32_t, GlyphInfo> GlyphMap;
+	typedef std::map<PopString, int> WidthCache;
+
+	enum
+	{
+		GLYPH_IMAGE_WIDTH = 512,
+		GLYPH_IMAGE_START_HEIGHT = 128,
+		GLYPH_IMAGE_MAX_HEIGHT = 2048,
+		WIDTH_CACHE_MAX_SIZE = 1024
+	};
+
   public:
 	TTF_Font *mTTFFont;
 	AppBase *mApp;
 	bool mDrawShadow;
 	bool mSimulateBold;
 
+	// Glyphs are rasterized once in white and packed into mGlyphImage in rows,
+	// strings are then drawn as colorized quads out of that one texture
+	SDLImage *mGlyphImage;
+	GlyphMap mGlyphMap;
+	int mGlyphPackX;
+	int mGlyphPackY;
+	int mGlyphRowHeight;
+
+	WidthCache mWidthCache;
+
 	void Init(AppBase *theApp, const std::string &theFace, int thePointSize, int theScript, bool bold, bool italics,
 			  bool underline, bool useDevCaps);
+	void InitGlyphCache();
+
+	const GlyphInfo *GetGlyph(uint32_t theChar);
+	int GetGlyphAdvance(uint32_t theChar);
+	bool PackGlyph(int theWidth, int theHeight, Rect &theRect);
+	void ClearGlyphCache();
 
   public:
 	SysFont(const std::string &theFace, int thePointSize, bool bold = false, bool italics = false,
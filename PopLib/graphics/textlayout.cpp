@@ -0,0 +1,165 @@
+#include "textlayout.hpp"
+#include "graphics.hpp"
+
+using namespace PopLib;
+
+TextLayoutCache PopLib::gTextLayoutCache;
+
+TextLayout::TextLayout()
+{
+	mWidth = 0;
+	mLineSpacing = 0;
+	mHeight = 0;
+	mMaxWidth = 0;
+	mEndColor = COLOR_ORIGINAL;
+	mCurColor = COLOR_ORIGINAL;
+	mCullable = false;
+}
+
+void TextLayout::AddRun(const PopString &theString, int theX, int theY)
+{
+	mRuns.push_back(Run());
+
+	Run &aRun = mRuns.back();
+	aRun.mString = theString;
+	aRun.mX = theX;
+	aRun.mY = theY;
+	aRun.mLineWidth = 0;
+	aRun.mColor = mCurColor;
+	aRun.mCullable = mCullable;
+}
+
+void TextLayout::SetLineWidth(int theFirstRun, int theLineWidth)
+{
+	for (ulong i = theFirstRun; i < mRuns.size(); i++)
+		mRuns[i].mLineWidth = theLineWidth;
+}
+
+/// <summary>
+/// Replays the layout with its origin at theX, theY. theJustification is -1 (left), 0 (centered) or 1 (right)
+/// within mWidth, same as WriteString.
+/// </summary>
+void TextLayout::Draw(Graphics *g, int theX, int theY, int theJustification, int theOldColor, bool restoreColor)
+{
+	Color anOrigColor = g->GetColor();
+	Color anOldColor((theOldColor >> 16) & 0xFF, (theOldColor >> 8) & 0xFF, theOldColor & 0xFF, anOrigColor.mAlpha);
+	int aCurColor = COLOR_ORIGINAL;
+
+	for (ulong i = 0; i < mRuns.size(); i++)
+	{
+		const Run &aRun = mRuns[i];
+
+		if (aRun.mCullable)
+		{
+			int aPhysPos = theY + aRun.mY + g->mTransY;
+			if ((aPhysPos < g->mClipRect.mY) || (aPhysPos >= g->mClipRect.mY + g->mClipRect.mHeight + mLineSpacing))
+				continue;
+		}
+
+		if (aRun.mColor != aCurColor)
+		{
+			if (aRun.mColor == COLOR_ORIGINAL)
+				g->SetColor(anOrigColor);
+			else if (aRun.mColor == COLOR_OLD)
+				g->SetColor(anOldColor);
+			else
+				g->SetColor(Color((aRun.mColor >> 16) & 0xFF, (aRun.mColor >> 8) & 0xFF, aRun.mColor & 0xFF,
+								  anOrigColor.mAlpha));
+			aCurColor = aRun.mColor;
+		}
+
+		int aX = theX + aRun.mX;
+		if (theJustification == 0)
+			aX += (mWidth - aRun.mLineWidth) / 2;
+		else if (theJustification == 1)
+			aX += mWidth - aRun.mLineWidth;
+
+		g->DrawString(aRun.mString, aX, theY + aRun.mY);
+	}
+
+	if (restoreColor || mEndColor == COLOR_ORIGINAL)
+		g->SetColor(anOrigColor);
+	else if (mEndColor == COLOR_OLD)
+		g->SetColor(anOldColor);
+	else
+		g->SetColor(Color((mEndColor >> 16) & 0xFF, (mEndColor >> 8) & 0xFF, mEndColor & 0xFF, anOrigColor.mAlpha));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TextLayoutCache::Key::operator<(const Key &theKey) const
+{
+	if (mFontLayoutId != theKey.mFontLayoutId)
+		return mFontLayoutId < theKey.mFontLayoutId;
+	if (mType != theKey.mType)
+		return mType < theKey.mType;
+	if (mWidth != theKey.mWidth)
+		return mWidth < theKey.mWidth;
+	if (mLineSpacing != theKey.mLineSpacing)
+		return mLineSpacing < theKey.mLineSpacing;
+	if (mColored != theKey.mColored)
+		return mColored < theKey.mColored;
+	return mString < theKey.mString;
+}
+
+TextLayoutCache::TextLayoutCache()
+{
+	mMaxLayouts = 256;
+	mHits = 0;
+	mMisses = 0;
+}
+
+TextLayoutPtr TextLayoutCache::Find(const Key &theKey)
+{
+	LayoutMap::iterator anItr = mLayoutMap.find(theKey);
+	if (anItr == mLayoutMap.end())
+	{
+		mMisses++;
+		return nullptr;
+	}
+
+	mHits++;
+	if (anItr->second != mLayoutList.begin())
+		mLayoutList.splice(mLayoutList.begin(), mLayoutList, anItr->second);
+
+	return anItr->second->second;
+}
+
+/// <summary>
+/// Adds theLayout, already recorded, for theKey (replacing any existing one)
+/// </summary>
+void TextLayoutCache::Add(const Key &theKey, const TextLayoutPtr &theLayout)
+{
+	LayoutMap::iterator anItr = mLayoutMap.find(theKey);
+	if (anItr != mLayoutMap.end())
+	{
+		mLayoutList.erase(anItr->second);
+		mLayoutMap.erase(anItr);
+	}
+
+	while ((int)mLayoutList.size() >= mMaxLayouts && !mLayoutList.empty())
+	{
+		mLayoutMap.erase(mLayoutList.back().first);
+		mLayoutList.pop_back();
+	}
+
+	mLayoutList.push_front(std::make_pair(theKey, theLayout));
+	mLayoutMap[theKey] = mLayoutList.begin();
+}
+
+void TextLayoutCache::SetMaxLayouts(int theMaxLayouts)
+{
+	mMaxLayouts = std::max(theMaxLayouts, 1);
+
+	while ((int)mLayoutList.size() > mMaxLayouts)
+	{
+		mLayoutMap.erase(mLayoutList.back().first);
+		mLayoutList.pop_back();
+	}
+}
+
+void TextLayoutCache::Clear()
+{
+	mLayoutMap.clear();
+	mLayoutList.clear();
+}
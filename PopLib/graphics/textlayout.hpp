@@ -0,0 +1,116 @@
+#ifndef __TEXTLAYOUT_HPP__
+#define __TEXTLAYOUT_HPP__
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "common.hpp"
+#include "color.hpp"
+#include "misc/critsect.hpp"
+
+#include <memory>
+
+namespace PopLib
+{
+
+class Graphics;
+
+/// <summary>
+/// The result of laying out a word wrapped or color tagged string: where each piece of text goes and in which color.
+/// Positions are relative to the layout origin and justification is applied when drawing, so one layout serves
+/// both measuring and drawing.
+/// </summary>
+class TextLayout
+{
+  public:
+	enum
+	{
+		COLOR_ORIGINAL = -1, // the color the Graphics had when the draw started
+		COLOR_OLD = -2		 // ^oldclr^, the caller's theOldColor
+	};
+
+	struct Run
+	{
+		PopString mString;
+		int mX;
+		int mY;
+		int mLineWidth; // full width of the line the run is on, for justification
+		int mColor;		// 0xRRGGBB or one of the COLOR_ values
+		bool mCullable; // skipped when its line is outside the clip rect, as WriteWordWrapped does
+	};
+
+	typedef std::vector<Run> RunVector;
+
+  public:
+	RunVector mRuns;
+	int mWidth;
+	int mLineSpacing;
+	int mHeight;   // what WriteWordWrapped returns
+	int mMaxWidth; // widest line
+	int mEndColor; // color left set after the last run
+
+	// state while recording
+	int mCurColor;
+	bool mCullable;
+
+  public:
+	TextLayout();
+
+	void AddRun(const PopString &theString, int theX, int theY);
+	void SetLineWidth(int theFirstRun, int theLineWidth);
+
+	void Draw(Graphics *g, int theX, int theY, int theJustification, int theOldColor, bool restoreColor);
+};
+
+typedef std::shared_ptr<TextLayout> TextLayoutPtr;
+
+/// <summary>
+/// Least recently used cache of text layouts shared by every Graphics. Lock mCritSect around Find/Add only: layouts
+/// are never changed once added, and holding the returned pointer keeps one alive if it's evicted meanwhile.
+/// </summary>
+class TextLayoutCache
+{
+  public:
+	enum
+	{
+		LAYOUT_WORDWRAP,
+		LAYOUT_COLOR
+	};
+
+	struct Key
+	{
+		uint32_t mFontLayoutId;
+		int mType;
+		int mWidth;
+		int mLineSpacing;
+		bool mColored;
+		PopString mString;
+
+		bool operator<(const Key &theKey) const;
+	};
+
+	typedef std::list<std::pair<Key, TextLayoutPtr>> LayoutList;
+	typedef std::map<Key, LayoutList::iterator> LayoutMap;
+
+  public:
+	CritSect mCritSect;
+	LayoutList mLayoutList; // most recently used first
+	LayoutMap mLayoutMap;
+	int mMaxLayouts;
+	int mHits;
+	int mMisses;
+
+  public:
+	TextLayoutCache();
+
+	TextLayoutPtr Find(const Key &theKey);
+	void Add(const Key &theKey, const TextLayoutPtr &theLayout);
+	void SetMaxLayouts(int theMaxLayouts);
+	void Clear();
+};
+
+extern TextLayoutCache gTextLayoutCache;
+
+} // namespace PopLib
+
+#endif // __TEXTLAYOUT_HPP__
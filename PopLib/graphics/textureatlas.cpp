@@ -0,0 +1,128 @@
+#include "textureatlas.hpp"
+#include "sdlimage.hpp"
+#include "sdlinterface.hpp"
+
+// imgui_draw.cpp compiles its own private copy, this one is ours
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imgui/core/imstb_rectpack.h"
+
+using namespace PopLib;
+
+TextureAtlas::TextureAtlas(SDLInterface *theInterface, int thePageSize, int thePadding)
+{
+	mInterface = theInterface;
+	mPageSize = thePageSize;
+	mPadding = thePadding;
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	Clear();
+}
+
+/// <summary>
+/// Queue theImage for the next Build. Images that are already on the GPU, are render
+/// targets or can't fit on a page are refused and keep their own texture.
+/// </summary>
+bool TextureAtlas::AddImage(MemoryImage *theImage)
+{
+	if (theImage == nullptr || theImage->mD3DData != nullptr ||
+		(theImage->mImageFlags & SDLImageFlag_RenderTarget) != 0)
+		return false;
+
+	if (theImage->mWidth <= 0 || theImage->mHeight <= 0 || theImage->mWidth + mPadding * 2 > mPageSize ||
+		theImage->mHeight + mPadding * 2 > mPageSize)
+		return false;
+
+	mImages.push_back(theImage);
+	return true;
+}
+
+/// <summary>
+/// Pack the queued images into as many pages as needed. Returns the number of images packed.
+/// </summary>
+int TextureAtlas::Build()
+{
+	std::vector<MemoryImage *> anImages(mImages.begin(), mImages.end());
+	mImages.clear();
+
+	std::vector<stbrp_rect> aRects(anImages.size());
+	for (int i = 0; i < (int)anImages.size(); i++)
+	{
+		aRects[i].id = i;
+		aRects[i].w = anImages[i]->mWidth + mPadding * 2;
+		aRects[i].h = anImages[i]->mHeight + mPadding * 2;
+	}
+
+	std::vector<stbrp_node> aNodes(mPageSize);
+	int aNumPacked = 0;
+
+	while (!aRects.empty())
+	{
+		stbrp_context aContext;
+		stbrp_init_target(&aContext, mPageSize, mPageSize, aNodes.data(), (int)aNodes.size());
+		stbrp_pack_rects(&aContext, aRects.data(), (int)aRects.size());
+
+		// trim the page to the area actually used
+		int aPageWidth = 0;
+		int aPageHeight = 0;
+		std::vector<stbrp_rect> aLeftOver;
+		for (int i = 0; i < (int)aRects.size(); i++)
+		{
+			if (aRects[i].was_packed)
+			{
+				aPageWidth = std::max(aPageWidth, aRects[i].x + aRects[i].w);
+				aPageHeight = std::max(aPageHeight, aRects[i].y + aRects[i].h);
+			}
+			else
+				aLeftOver.push_back(aRects[i]);
+		}
+
+		if (aLeftOver.size() == aRects.size())
+			break;
+
+		SDLImage *aPage = new SDLImage(mInterface);
+		aPage->Create(aPageWidth, aPageHeight);
+		ulong *aPageBits = aPage->GetBits(); // starts out fully transparent
+
+		for (int i = 0; i < (int)aRects.size(); i++)
+		{
+			if (!aRects[i].was_packed)
+				continue;
+
+			MemoryImage *anImage = anImages[aRects[i].id];
+			int aX = aRects[i].x + mPadding;
+			int aY = aRects[i].y + mPadding;
+
+			ulong *aBits = anImage->GetBits();
+			for (int y = 0; y < anImage->mHeight; y++)
+				memcpy(aPageBits + (aY + y) * aPageWidth + aX, aBits + y * anImage->mWidth,
+					   anImage->mWidth * sizeof(ulong));
+
+			mInterface->AddToAtlas(anImage, aPage, aX, aY);
+			aNumPacked++;
+		}
+
+		aPage->BitsChanged();
+		mPages.push_back(aPage);
+		aRects.swap(aLeftOver);
+	}
+
+	return aNumPacked;
+}
+
+/// <summary>
+/// Delete all pages. Images still alive at this point get their own textures back.
+/// </summary>
+void TextureAtlas::Clear()
+{
+	for (int i = 0; i < (int)mPages.size(); i++)
+	{
+		mInterface->RemoveAtlasPage(mPages[i]);
+		delete mPages[i];
+	}
+
+	mPages.clear();
+	mImages.clear();
+}
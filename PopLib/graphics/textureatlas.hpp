@@ -0,0 +1,44 @@
+#ifndef __TEXTUREATLAS_HPP__
+#define __TEXTUREATLAS_HPP__
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "common.hpp"
+
+namespace PopLib
+{
+
+class MemoryImage;
+class SDLImage;
+class SDLInterface;
+
+///////////////////////////////////////////////////////////////////////////////
+// Packs many small images into a few large page textures so they can share a
+// single SDL_Texture (and therefore a single batch). Each packed image keeps
+// drawing as before, SDLInterface maps its source rects into the page.
+///////////////////////////////////////////////////////////////////////////////
+class TextureAtlas
+{
+  public:
+	typedef std::list<MemoryImage *> ImageList;
+	typedef std::vector<SDLImage *> PageVector;
+
+	SDLInterface *mInterface;
+	int mPageSize; // maximum page width and height, pages are trimmed to what they use
+	int mPadding;  // transparent border around every image to keep filtering from bleeding
+	ImageList mImages;
+	PageVector mPages;
+
+  public:
+	TextureAtlas(SDLInterface *theInterface, int thePageSize = 2048, int thePadding = 2);
+	virtual ~TextureAtlas();
+
+	bool AddImage(MemoryImage *theImage);
+	int Build();
+	void Clear();
+};
+
+} // namespace PopLib
+
+#endif // __TEXTUREATLAS_HPP__
@@ -44,18 +44,20 @@ Image *GetImageSTB(const std::string &theFileName)
 {
 	PFILE *fp;
 
-	if ((fp = p_fopen(theFileName.c_str(), "rb")) == nullptr)
+	if ((fp = p_fopen_probe(theFileName.c_str())) == nullptr)
 		return nullptr;
 
-	p_fseek(fp, 0, SEEK_END);
-	size_t fileSize = p_ftell(fp);
-	p_fseek(fp, 0, SEEK_SET);
-	std::vector<uint8_t> data(fileSize);
-	p_fread(data.data(), 1, fileSize, fp);
-	p_fclose(fp);
+	// decoded straight out of the pak (or the file read once), no copy of the compressed image is made
+	size_t fileSize;
+	const stbi_uc *data = (const stbi_uc *)p_fmap(fp, &fileSize);
 
 	int width, height, num_channels;
-	unsigned char *stb_image = stbi_load_from_memory(data.data(), fileSize, &width, &height, &num_channels, NULL);
+	unsigned char *stb_image =
+		data ? stbi_load_from_memory(data, (int)fileSize, &width, &height, &num_channels, NULL) : nullptr;
+	p_fclose(fp);
+
+	if (stb_image == nullptr)
+		return nullptr;
 
 	ulong *aBits = new ulong[width * height];
 	for (int i = 0; i < width * height; ++i)
@@ -110,7 +112,7 @@ Image *GetGIFImage(const std::string &theFileName)
 
 	PFILE *fp;
 
-	if ((fp = p_fopen(theFileName.c_str(), "rb")) == nullptr)
+	if ((fp = p_fopen_probe(theFileName.c_str())) == nullptr)
 		return nullptr;
 	/*
 	Determine if this is a GIF file.
@@ -665,6 +667,11 @@ int ImageLib::gAlphaComposeColor = 0xFFFFFF;
 bool ImageLib::gAutoLoadAlpha = true;
 
 Image *ImageLib::GetImage(const std::string &theFilename, bool lookForAlphaImage)
+{
+	return GetImage(theFilename, lookForAlphaImage, gAlphaComposeColor);
+}
+
+Image *ImageLib::GetImage(const std::string &theFilename, bool lookForAlphaImage, int theAlphaComposeColor)
 {
 	if (!gAutoLoadAlpha)
 		lookForAlphaImage = false;
@@ -704,11 +711,11 @@ Image *ImageLib::GetImage(const std::string &theFilename, bool lookForAlphaImage
 		// Check _ImageName
 		anAlphaImage = GetImage(theFilename.substr(0, aLastSlashPos + 1) + "_" +
 									theFilename.substr(aLastSlashPos + 1, theFilename.length() - aLastSlashPos - 1),
-								false);
+								false, theAlphaComposeColor);
 
 		// Check ImageName_
 		if (anAlphaImage == nullptr)
-			anAlphaImage = GetImage(theFilename + "_", false);
+			anAlphaImage = GetImage(theFilename + "_", false, theAlphaComposeColor);
 	}
 
 	// Compose alpha channel with image
@@ -732,7 +739,7 @@ Image *ImageLib::GetImage(const std::string &theFilename, bool lookForAlphaImage
 
 			delete anAlphaImage;
 		}
-		else if (gAlphaComposeColor == 0xFFFFFF)
+		else if (theAlphaComposeColor == 0xFFFFFF)
 		{
 			anImage = anAlphaImage;
 
@@ -747,7 +754,7 @@ Image *ImageLib::GetImage(const std::string &theFilename, bool lookForAlphaImage
 		}
 		else
 		{
-			const int aColor = gAlphaComposeColor;
+			const int aColor = theAlphaComposeColor;
 			anImage = anAlphaImage;
 
 			ulong *aBits1 = anImage->mBits;
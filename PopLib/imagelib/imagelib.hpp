@@ -34,6 +34,9 @@ extern int gAlphaComposeColor;
 extern bool gAutoLoadAlpha;
 
 Image *GetImage(const std::string &theFileName, bool lookForAlphaImage = true);
+// Same as above with the color for alpha-only images passed in instead of read from gAlphaComposeColor,
+// so it can be called from any thread
+Image *GetImage(const std::string &theFileName, bool lookForAlphaImage, int theAlphaComposeColor);
 
 } // namespace ImageLib
 
@@ -1,5 +1,7 @@
 #include "imguimanager.hpp"
 #include "appbase.hpp"
+#include "graphics/sdlinterface.hpp"
+#include "graphics/textlayout.hpp"
 
 using namespace PopLib;
 
@@ -14,6 +16,61 @@ static Uint64 lastTime = SDL_GetPerformanceCounter();
 static int frameCount = 0;
 static float fps = 0.0f;
 
+struct RenderStatGraph
+{
+	const char *mName;
+	int RenderStats::*mField;
+};
+
+static const RenderStatGraph gRenderStatGraphs[] = {
+	{"Draw Calls", &RenderStats::mDrawCalls},
+	{"Batches", &RenderStats::mBatches},
+	{"Vertices", &RenderStats::mVertices},
+	{"Quads", &RenderStats::mQuads},
+	{"Texture Binds", &RenderStats::mTextureBinds},
+	{"Target Switches", &RenderStats::mTargetSwitches},
+	{"Clip Changes", &RenderStats::mClipChanges},
+	{"State Changes Avoided", &RenderStats::mStateChangesAvoided},
+	{"Texture Uploads", &RenderStats::mTextureUploads},
+	{"Upload Bytes", &RenderStats::mUploadBytes},
+	{"Live Textures", &RenderStats::mLiveTextures},
+};
+
+static float GetRenderStatValue(void *theData, int theIndex)
+{
+	SDLInterface *anInterface = gAppBase->mSDLInterface;
+	const RenderStatGraph *aGraph = (const RenderStatGraph *)theData;
+
+	// oldest first, so the graph scrolls to the left
+	return (float)(anInterface->GetRenderStats(anInterface->GetRenderStatsCount() - 1 - theIndex).*(aGraph->mField));
+}
+
+static void DrawRenderStats()
+{
+	SDLInterface *anInterface = gAppBase->mSDLInterface;
+	if (anInterface == nullptr || !ImGui::CollapsingHeader("Render Stats"))
+		return;
+
+	const RenderStats &aStats = anInterface->GetRenderStats();
+	int aHistoryCount = anInterface->GetRenderStatsCount();
+
+	for (int i = 0; i < (int)(sizeof(gRenderStatGraphs) / sizeof(gRenderStatGraphs[0])); i++)
+	{
+		const RenderStatGraph &aGraph = gRenderStatGraphs[i];
+		std::string aLabel = StrFormat("%s: %d", aGraph.mName, aStats.*(aGraph.mField));
+
+		ImGui::PlotLines(StrFormat("##%s", aGraph.mName).c_str(), GetRenderStatValue, (void *)&aGraph, aHistoryCount,
+						 0, aLabel.c_str(), 0.0f, FLT_MAX, ImVec2(0, 40.0f));
+	}
+
+	ImGui::Text("VRAM Estimate: %.1f MB", aStats.mTextureMemory / (1024.0 * 1024.0));
+	if (anInterface->mTextureMemoryBudget > 0)
+		ImGui::Text("Texture Budget: %.1f MB", anInterface->mTextureMemoryBudget / (1024.0 * 1024.0));
+	ImGui::Text("Textures Evicted: %d", anInterface->mTexturesEvicted);
+	ImGui::Text("Upload Queue: %d", anInterface->GetUploadQueueSize());
+	ImGui::Text("Text Layout Cache: %d hits, %d misses", gTextLayoutCache.mHits, gTextLayoutCache.mMisses);
+}
+
 static struct RegisterDebugWindow
 {
 	RegisterDebugWindow()
@@ -50,6 +107,8 @@ static struct RegisterDebugWindow
 
 			ImGui::Text("FPS: %.2f", fps);
 
+			DrawRenderStats();
+
 			// quit button
 			const float padding = 10.0f;
 			ImVec2 windowSize = ImGui::GetWindowSize();
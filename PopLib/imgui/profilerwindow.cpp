@@ -0,0 +1,180 @@
+#include "imguimanager.hpp"
+#include "appbase.hpp"
+#include "debug/profiler.hpp"
+
+#include <algorithm>
+#include <map>
+
+using namespace PopLib;
+
+bool profilerWind = false;
+
+static bool gProfilerFreeze = false;
+static int gProfilerFramesAgo = 0;
+static uint64_t gProfilerFrameStart = 0;
+static uint64_t gProfilerFrameEnd = 0;
+
+static ImU32 ZoneColor(const char *theName)
+{
+	// stable per name, so a zone keeps its color from frame to frame
+	uint32_t aHash = 2166136261u;
+	for (const char *p = theName; *p != 0; p++)
+		aHash = (aHash ^ (uint8_t)*p) * 16777619u;
+
+	return IM_COL32(80 + (aHash & 0x7F), 80 + ((aHash >> 8) & 0x7F), 80 + ((aHash >> 16) & 0x7F), 255);
+}
+
+static void DrawTimeline(const ProfileEventVector &theEvents, uint64_t theStart, uint64_t theEnd)
+{
+	const float aRowHeight = ImGui::GetTextLineHeight() + 4.0f;
+	const float aLabelWidth = 90.0f;
+
+	ImDrawList *aDrawList = ImGui::GetWindowDrawList();
+	float aWidth = std::max(ImGui::GetContentRegionAvail().x - aLabelWidth, 50.0f);
+	double aPixelsPerTick = aWidth / (double)std::max(theEnd - theStart, (uint64_t)1);
+
+	size_t i = 0;
+	while (i < theEvents.size())
+	{
+		int aThread = theEvents[i].mThread;
+		int aMaxDepth = 0;
+		size_t anEnd = i;
+		while ((anEnd < theEvents.size()) && (theEvents[anEnd].mThread == aThread))
+			aMaxDepth = std::max(aMaxDepth, theEvents[anEnd++].mDepth);
+
+		ImVec2 anOrigin = ImGui::GetCursorScreenPos();
+		ImGui::TextUnformatted(Profiler::GetThreadName(aThread).c_str());
+
+		float aLeft = anOrigin.x + aLabelWidth;
+		aDrawList->AddRectFilled(ImVec2(aLeft, anOrigin.y),
+								 ImVec2(aLeft + aWidth, anOrigin.y + aRowHeight * (aMaxDepth + 1)),
+								 IM_COL32(40, 40, 40, 255));
+
+		for (; i < anEnd; i++)
+		{
+			const ProfileEvent &anEvent = theEvents[i];
+
+			uint64_t aZoneStart = std::max(anEvent.mStart, theStart);
+			uint64_t aZoneEnd = std::min(anEvent.mEnd, theEnd);
+			ImVec2 aMin(aLeft + (float)((aZoneStart - theStart) * aPixelsPerTick),
+						anOrigin.y + anEvent.mDepth * aRowHeight);
+			ImVec2 aMax(std::max(aLeft + (float)((aZoneEnd - theStart) * aPixelsPerTick), aMin.x + 1.0f),
+						aMin.y + aRowHeight - 1.0f);
+
+			aDrawList->AddRectFilled(aMin, aMax, ZoneColor(anEvent.mName));
+
+			aDrawList->PushClipRect(aMin, aMax, true);
+			aDrawList->AddText(ImVec2(aMin.x + 2.0f, aMin.y + 2.0f), IM_COL32_WHITE, anEvent.mName);
+			aDrawList->PopClipRect();
+
+			if (ImGui::IsMouseHoveringRect(aMin, aMax))
+				ImGui::SetTooltip("%s\n%.3f ms", anEvent.mName,
+								  Profiler::TicksToMilliseconds(anEvent.mEnd - anEvent.mStart));
+		}
+
+		ImGui::SetCursorScreenPos(anOrigin);
+		ImGui::Dummy(ImVec2(aLabelWidth + aWidth, aRowHeight * (aMaxDepth + 1) + 4.0f));
+	}
+}
+
+static void DrawZoneTable(const ProfileEventVector &theEvents, uint64_t theStart, uint64_t theEnd)
+{
+	struct ZoneTotal
+	{
+		uint64_t mTicks;
+		int mCalls;
+	};
+
+	std::map<std::string, ZoneTotal> aTotals;
+	for (size_t i = 0; i < theEvents.size(); i++)
+	{
+		const ProfileEvent &anEvent = theEvents[i];
+		ZoneTotal &aTotal = aTotals[anEvent.mName];
+		aTotal.mTicks += std::min(anEvent.mEnd, theEnd) - std::max(anEvent.mStart, theStart);
+		aTotal.mCalls++;
+	}
+
+	std::vector<std::pair<std::string, ZoneTotal>> aSorted(aTotals.begin(), aTotals.end());
+	std::sort(aSorted.begin(), aSorted.end(),
+			  [](const std::pair<std::string, ZoneTotal> &a, const std::pair<std::string, ZoneTotal> &b) {
+				  return a.second.mTicks > b.second.mTicks;
+			  });
+
+	if (ImGui::BeginTable("Zones", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders))
+	{
+		ImGui::TableSetupColumn("Zone");
+		ImGui::TableSetupColumn("ms");
+		ImGui::TableSetupColumn("Calls");
+		ImGui::TableHeadersRow();
+
+		for (size_t i = 0; i < aSorted.size(); i++)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(aSorted[i].first.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", Profiler::TicksToMilliseconds(aSorted[i].second.mTicks));
+			ImGui::TableNextColumn();
+			ImGui::Text("%d", aSorted[i].second.mCalls);
+		}
+
+		ImGui::EndTable();
+	}
+}
+
+static struct RegisterProfilerWindow
+{
+	RegisterProfilerWindow()
+	{
+		RegisterImGuiWindow("Profiler", &profilerWind, [] {
+			ImGui::Begin("Profiler", &profilerWind);
+
+			bool enabled = Profiler::IsEnabled();
+			if (ImGui::Checkbox("Enabled", &enabled))
+				Profiler::SetEnabled(enabled);
+
+			ImGui::SameLine();
+			ImGui::Checkbox("Freeze", &gProfilerFreeze);
+
+			ImGui::SameLine();
+			if (ImGui::Button("Dump Chrome Trace (F4)"))
+				gAppBase->DumpProfile();
+
+			// frame times, oldest first
+			int aFrameCount = Profiler::GetFrameCount();
+			float aFrameTimes[Profiler::FRAME_HISTORY];
+			for (int i = 0; i < aFrameCount; i++)
+			{
+				uint64_t aStart, anEnd;
+				Profiler::GetFrame(aFrameCount - 1 - i, aStart, anEnd);
+				aFrameTimes[i] = (float)Profiler::TicksToMilliseconds(anEnd - aStart);
+			}
+
+			if (aFrameCount > 0)
+				ImGui::PlotHistogram("##FrameTimes", aFrameTimes, aFrameCount, 0, "Frame ms", 0.0f, 50.0f,
+									 ImVec2(-1.0f, 60.0f));
+
+			if (!gProfilerFreeze)
+			{
+				ImGui::SliderInt("Frames Ago", &gProfilerFramesAgo, 0, std::max(aFrameCount - 1, 0));
+				if (!Profiler::GetFrame(gProfilerFramesAgo, gProfilerFrameStart, gProfilerFrameEnd))
+					gProfilerFrameStart = gProfilerFrameEnd = 0;
+			}
+
+			if (gProfilerFrameEnd > gProfilerFrameStart)
+			{
+				ImGui::Text("Frame: %.3f ms", Profiler::TicksToMilliseconds(gProfilerFrameEnd - gProfilerFrameStart));
+
+				ProfileEventVector anEvents;
+				Profiler::GetEvents(gProfilerFrameStart, gProfilerFrameEnd, anEvents);
+
+				DrawTimeline(anEvents, gProfilerFrameStart, gProfilerFrameEnd);
+				DrawZoneTable(anEvents, gProfilerFrameStart, gProfilerFrameEnd);
+			}
+			else
+				ImGui::Text("No frames recorded");
+
+			ImGui::End();
+		});
+	}
+} registerProfilerWindow;
@@ -0,0 +1,278 @@
+#include "jobsystem.hpp"
+#include "debug/profiler.hpp"
+
+#include <algorithm>
+
+using namespace PopLib;
+
+JobSystem *PopLib::gJobSystem = nullptr;
+
+struct JobWorkerStart
+{
+	JobSystem *mJobSystem;
+	int mIndex;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+JobSystem::JobSystem(int theThreadCount) : mQueuedJobs(0), mSleepers(0), mStopped(false)
+{
+	if (theThreadCount < 0)
+		theThreadCount = SDL_GetNumLogicalCPUCores() - 1;
+
+	// at least one, jobs nobody waits on still have to run somewhere
+	theThreadCount = std::max(theThreadCount, 1);
+
+	for (int i = 0; i <= theThreadCount; i++)
+		mQueues.push_back(new WorkerQueue());
+
+	for (int i = 0; i < theThreadCount; i++)
+	{
+		JobWorkerStart *aStart = new JobWorkerStart();
+		aStart->mJobSystem = this;
+		aStart->mIndex = i;
+
+		SDL_Thread *aThread = SDL_CreateThread(WorkerProcStub, "JobWorker", aStart);
+		if (aThread == nullptr)
+		{
+			delete aStart;
+			continue;
+		}
+		mThreads.push_back(aThread);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+JobSystem::~JobSystem()
+{
+	mStopped = true;
+	Wake(true);
+
+	for (size_t i = 0; i < mThreads.size(); i++)
+		SDL_WaitThread(mThreads[i], nullptr);
+
+	for (size_t i = 0; i < mQueues.size(); i++)
+		delete mQueues[i];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+int JobSystem::WorkerProcStub(void *theArg)
+{
+	JobWorkerStart *aStart = (JobWorkerStart *)theArg;
+	JobSystem *aJobSystem = aStart->mJobSystem;
+	int anIndex = aStart->mIndex;
+	delete aStart;
+
+	aJobSystem->WorkerProc(anIndex);
+	return 0;
+}
+
+void JobSystem::WorkerProc(int theIndex)
+{
+	gWorkerIndex = theIndex;
+	Profiler::SetThreadName(StrFormat("Job Worker %d", theIndex));
+
+	while (!mStopped)
+	{
+		JobHandle aJob = TakeJob();
+		if (aJob != nullptr)
+		{
+			RunJob(aJob);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> aLock(mSleepMutex);
+		mSleepers++;
+		mSleepCond.wait(aLock, [this] { return mStopped || (mQueuedJobs > 0); });
+		mSleepers--;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::Wake(bool all)
+{
+	// Taking the lock orders this against a sleeper that has checked its condition but not started waiting yet
+	{
+		std::lock_guard<std::mutex> aLock(mSleepMutex);
+	}
+
+	if (all)
+		mSleepCond.notify_all();
+	else
+		mSleepCond.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::Enqueue(const JobHandle &theJob)
+{
+	// a worker keeps what it schedules to itself until someone steals it, everyone else shares the last queue
+	int aSharedIndex = (int)mQueues.size() - 1;
+	int anIndex = ((gWorkerIndex >= 0) && (gWorkerIndex < aSharedIndex)) ? gWorkerIndex : aSharedIndex;
+
+	WorkerQueue *aQueue = mQueues[anIndex];
+	{
+		std::lock_guard<std::mutex> aLock(aQueue->mMutex);
+		aQueue->mJobs.push_back(theJob);
+	}
+
+	mQueuedJobs++;
+	if (mSleepers > 0)
+		Wake(false);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+JobHandle JobSystem::TakeJob()
+{
+	JobHandle aJob;
+	int aSharedIndex = (int)mQueues.size() - 1;
+
+	// newest first from our own queue, it's the one most likely still in cache
+	if ((gWorkerIndex >= 0) && (gWorkerIndex < aSharedIndex))
+	{
+		WorkerQueue *aQueue = mQueues[gWorkerIndex];
+		std::lock_guard<std::mutex> aLock(aQueue->mMutex);
+		if (!aQueue->mJobs.empty())
+		{
+			aJob = aQueue->mJobs.back();
+			aQueue->mJobs.pop_back();
+		}
+	}
+
+	// then oldest first from the shared queue, then steal from everyone else's
+	for (int i = 0; (aJob == nullptr) && (i <= aSharedIndex); i++)
+	{
+		int anIndex = (i == 0) ? aSharedIndex : (std::max(gWorkerIndex, 0) + i) % aSharedIndex;
+		if (anIndex == gWorkerIndex)
+			continue;
+
+		WorkerQueue *aQueue = mQueues[anIndex];
+		std::lock_guard<std::mutex> aLock(aQueue->mMutex);
+		if (!aQueue->mJobs.empty())
+		{
+			aJob = aQueue->mJobs.front();
+			aQueue->mJobs.pop_front();
+		}
+	}
+
+	if (aJob != nullptr)
+		mQueuedJobs--;
+	return aJob;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::RunJob(const JobHandle &theJob)
+{
+	{
+		PROFILE_ZONE("JobSystem::RunJob");
+		theJob->mFunc();
+	}
+	theJob->mFunc = nullptr;
+
+	std::vector<JobHandle> aContinuations;
+	{
+		std::lock_guard<std::mutex> aLock(theJob->mMutex);
+		theJob->mDone.store(true);
+		aContinuations.swap(theJob->mContinuations);
+	}
+
+	for (size_t i = 0; i < aContinuations.size(); i++)
+		DependencyDone(aContinuations[i]);
+
+	// whoever sleeps in Wait might be waiting on this one
+	if (mSleepers > 0)
+		Wake(true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::DependencyDone(const JobHandle &theJob)
+{
+	if (--theJob->mPendingDependencies == 0)
+		Enqueue(theJob);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+JobHandle JobSystem::Schedule(std::function<void()> theFunc, const JobHandleVector &theDependencies)
+{
+	JobHandle aJob = std::make_shared<Job>();
+	aJob->mFunc = std::move(theFunc);
+
+	for (size_t i = 0; i < theDependencies.size(); i++)
+	{
+		const JobHandle &aDependency = theDependencies[i];
+		if (IsDone(aDependency))
+			continue;
+
+		std::lock_guard<std::mutex> aLock(aDependency->mMutex);
+		if (!aDependency->mDone)
+		{
+			aJob->mPendingDependencies++;
+			aDependency->mContinuations.push_back(aJob);
+		}
+	}
+
+	// drops the reference the job was created with, queueing it if nothing else is outstanding
+	DependencyDone(aJob);
+	return aJob;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+JobHandle JobSystem::ParallelFor(int theCount, int theGrainSize, std::function<void(int, int)> theFunc,
+								 const JobHandleVector &theDependencies)
+{
+	theGrainSize = std::max(theGrainSize, 1);
+
+	std::shared_ptr<std::function<void(int, int)>> aFunc =
+		std::make_shared<std::function<void(int, int)>>(std::move(theFunc));
+
+	JobHandleVector aRanges;
+	for (int aBegin = 0; aBegin < theCount; aBegin += theGrainSize)
+	{
+		int anEnd = std::min(aBegin + theGrainSize, theCount);
+		aRanges.push_back(Schedule([aFunc, aBegin, anEnd] { (*aFunc)(aBegin, anEnd); }, theDependencies));
+	}
+
+	if (aRanges.empty())
+		return Schedule([] {}, theDependencies);
+	if (aRanges.size() == 1)
+		return aRanges[0];
+	return Schedule([] {}, aRanges);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::Wait(const JobHandle &theJob)
+{
+	while (!IsDone(theJob))
+	{
+		JobHandle aJob = TakeJob();
+		if (aJob != nullptr)
+		{
+			RunJob(aJob);
+			continue;
+		}
+
+		// nothing to help with, whatever we wait on is running somewhere else
+		std::unique_lock<std::mutex> aLock(mSleepMutex);
+		mSleepers++;
+		mSleepCond.wait(aLock, [this, &theJob] { return IsDone(theJob) || mStopped || (mQueuedJobs > 0); });
+		mSleepers--;
+
+		if (mStopped)
+			break;
+	}
+}
+
+void JobSystem::WaitAll(const JobHandleVector &theJobs)
+{
+	for (size_t i = 0; i < theJobs.size(); i++)
+		Wait(theJobs[i]);
+}
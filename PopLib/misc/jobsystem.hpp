@@ -0,0 +1,120 @@
+#ifndef __JOBSYSTEM_HPP__
+#define __JOBSYSTEM_HPP__
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "common.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <SDL3/SDL.h>
+
+namespace PopLib
+{
+
+/// <summary>
+/// One scheduled job. Only JobSystem touches the insides, everyone else holds it through a JobHandle.
+/// </summary>
+class Job
+{
+  public:
+	std::function<void()> mFunc;
+	std::atomic<int> mPendingDependencies; // the job is queued when this reaches 0
+	std::atomic<bool> mDone;
+
+	std::mutex mMutex;
+	std::vector<std::shared_ptr<Job>> mContinuations; // jobs waiting on this one, guarded by mMutex
+
+  public:
+	Job() : mPendingDependencies(1), mDone(false)
+	{
+	}
+};
+
+/// <summary>
+/// Handle to a scheduled job. A null handle counts as finished, so it can be passed as a dependency or waited on.
+/// </summary>
+typedef std::shared_ptr<Job> JobHandle;
+typedef std::vector<JobHandle> JobHandleVector;
+
+/// <summary>
+/// Fixed pool of worker threads, one less than the number of cores. Each worker has its own deque: it pushes and
+/// pops jobs it schedules at the back, and idle workers steal from the front of the others. Jobs scheduled from
+/// threads outside the pool go to a shared queue. Waiting on a job runs other jobs in the meantime, so the main
+/// thread helps instead of blocking.
+/// </summary>
+class JobSystem
+{
+  protected:
+	struct WorkerQueue
+	{
+		std::mutex mMutex;
+		std::deque<JobHandle> mJobs;
+	};
+
+	std::vector<SDL_Thread *> mThreads;
+	std::vector<WorkerQueue *> mQueues; // one per worker, then the shared one
+	std::atomic<int> mQueuedJobs;
+	std::atomic<int> mSleepers;
+	std::atomic<bool> mStopped;
+	std::mutex mSleepMutex;
+	std::condition_variable mSleepCond;
+
+	static inline thread_local int gWorkerIndex = -1;
+
+  protected:
+	static int WorkerProcStub(void *theArg);
+	void WorkerProc(int theIndex);
+
+	void Enqueue(const JobHandle &theJob);
+	JobHandle TakeJob();
+	void RunJob(const JobHandle &theJob);
+	void DependencyDone(const JobHandle &theJob);
+	void Wake(bool all);
+
+  public:
+	/// <summary>
+	/// theThreadCount < 0 sizes the pool to the machine
+	/// </summary>
+	JobSystem(int theThreadCount = -1);
+	virtual ~JobSystem();
+
+	int GetThreadCount()
+	{
+		return (int)mThreads.size();
+	}
+
+	/// <summary>
+	/// Queues theFunc to run once every job in theDependencies has finished
+	/// </summary>
+	JobHandle Schedule(std::function<void()> theFunc, const JobHandleVector &theDependencies = JobHandleVector());
+
+	/// <summary>
+	/// Splits [0, theCount) into ranges of about theGrainSize and runs theFunc(begin, end) on each in parallel. The
+	/// returned handle finishes when every range has.
+	/// </summary>
+	JobHandle ParallelFor(int theCount, int theGrainSize, std::function<void(int, int)> theFunc,
+						  const JobHandleVector &theDependencies = JobHandleVector());
+
+	/// <summary>
+	/// Blocks until theJob has finished, running queued jobs on this thread while it waits
+	/// </summary>
+	void Wait(const JobHandle &theJob);
+	void WaitAll(const JobHandleVector &theJobs);
+
+	static bool IsDone(const JobHandle &theJob)
+	{
+		return (theJob == nullptr) || theJob->mDone.load(std::memory_order_acquire);
+	}
+};
+
+extern JobSystem *gJobSystem;
+
+} // namespace PopLib
+
+#endif // __JOBSYSTEM_HPP__
@@ -5,10 +5,14 @@
 #endif
 
 #include "common.hpp"
-#include <SDL3/SDL.h>
+#include "jobsystem.hpp"
 
 namespace PopLib
 {
+/// <summary>
+/// Runs one task at a time in the background. Kept for older code, the tasks are jobs on gJobSystem now, so a
+/// WorkerThread no longer owns a thread of its own.
+/// </summary>
 class WorkerThread
 {
   public:
@@ -21,21 +25,8 @@ class WorkerThread
 	std::string mName;
 
   protected:
-	static int StaticThreadProc(void *);
-
-	SDL_Thread *mThread;
-	SDL_Mutex *mMutex;
-	SDL_Condition *mCond;
-
-	void *mSignalEvent;
-	void *mDoneEvent;
-	void (*mTask)(void *);
-	void *mTaskArg;
-	bool mStopped;
-	bool mTaskPending;
-
-	void ThreadProc();
+	JobHandle mTask;
 };
 } // namespace PopLib
 
-#endif
\ No newline at end of file
+#endif
@@ -27,8 +27,86 @@ struct GPAKFileEntry
 {
 	char path[256];			 // null-terminated relative path
 	uint64_t dataOffset;	 // byte offset in .pak where compressed data lives
-	uint32_t compressedSize; // size in bytes of the compressed blob
+	uint32_t compressedSize; // size in bytes of the compressed blob, GPAK_STORED may be or'd in
 	uint32_t originalSize;	 // uncompressed size in bytes
 };
 
-#endif // __GPAK_HPP__
\ No newline at end of file
+/**
+ * @brief set in GPAKFileEntry::compressedSize for an entry kept as is, neither compressed nor encrypted. The
+ * runtime hands out pointers straight into the mapped .pak for these.
+ */
+constexpr uint32_t GPAK_STORED = 0x80000000;
+
+//////////////////////////////////////////////////////////////////////////
+// Version 2
+//
+// Entries are split into chunks of chunkSize bytes that are compressed (and
+// encrypted) on their own, so a read only decodes the chunks it touches. The
+// layout is the header, the entries' chunks with every entry starting on a
+// 16 byte boundary, the chunk table and the file table. An entry's chunks are
+// consecutive in both the table and the file, so one whose chunks are all
+// stored and unencrypted is a plain contiguous range of the .pak.
+//////////////////////////////////////////////////////////////////////////
+
+enum
+{
+	GPAK_CODEC_STORED = 0, // as is
+	GPAK_CODEC_ZLIB = 1	   // zlib stream
+};
+
+enum
+{
+	GPAK_FLAG_ENCRYPTED = 1 // every chunk is padded and AES-ECB encrypted after compression
+};
+
+/**
+ * @brief GPAK v2 header, GPAKHeader with version 2 followed by the chunk table's whereabouts
+ */
+struct GPAKHeaderV2
+{
+	GPAKHeader base;
+	uint32_t chunkSize;		   // uncompressed bytes per chunk, an entry's last chunk may be shorter
+	uint32_t flags;			   // GPAK_FLAG_*
+	uint64_t chunkTableOffset; // byte offset of the GPAKChunk table
+	uint64_t chunkCount;	   // how many entries in the chunk table
+};
+
+/**
+ * @brief GPAK v2 file entry
+ */
+struct GPAKFileEntryV2
+{
+	char path[256];		  // null-terminated relative path
+	uint64_t dataOffset;  // byte offset of the first chunk, a multiple of 16
+	uint64_t originalSize; // uncompressed size in bytes
+	uint64_t contentHash; // GPAKHash of the uncompressed data, entries with the same contents share chunks
+	uint64_t firstChunk;  // index of the entry's first chunk in the chunk table
+	uint32_t chunkCount;
+	uint32_t reserved;
+};
+
+/**
+ * @brief one independently decodable piece of an entry
+ */
+struct GPAKChunk
+{
+	uint64_t offset;		 // byte offset in the .pak
+	uint32_t compressedSize; // bytes stored, including any encryption padding
+	uint32_t codec;			 // GPAK_CODEC_*
+};
+
+static_assert(sizeof(GPAKHeader) == 24 && sizeof(GPAKHeaderV2) == 48, "GPAK header layout");
+static_assert(sizeof(GPAKFileEntryV2) == 296 && sizeof(GPAKChunk) == 16, "GPAK v2 table layout");
+
+/**
+ * @brief 64 bit FNV-1a, the v2 content hash
+ */
+inline uint64_t GPAKHash(const uint8_t *theData, size_t theSize)
+{
+	uint64_t aHash = 14695981039346656037ull;
+	for (size_t i = 0; i < theSize; i++)
+		aHash = (aHash ^ theData[i]) * 1099511628211ull;
+	return aHash;
+}
+
+#endif // __GPAK_HPP__
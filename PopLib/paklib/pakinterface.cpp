@@ -10,6 +10,13 @@ extern "C"
 #include <aes.h>
 }
 
+#ifndef _WIN32 // windows.h comes with common.hpp
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 using namespace std;
 
@@ -18,12 +25,12 @@ PakInterface *gPakInterface = new PakInterface();
 std::string gDecryptPassword = "PopCapPopLibFramework";
 
 //////////////////
-std::vector<uint8_t> Decompress(const std::vector<uint8_t> &input, size_t originalSize)
+std::vector<uint8_t> Decompress(const uint8_t *input, size_t inputSize, size_t originalSize)
 {
 	std::vector<uint8_t> output(originalSize);
 	uLongf destLen = originalSize;
 
-	int res = ::uncompress(output.data(), &destLen, input.data(), input.size());
+	int res = ::uncompress(output.data(), &destLen, input, inputSize);
 	if (res != Z_OK)
 		throw std::runtime_error("zlib decompression failed with code: " + std::to_string(res));
 
@@ -31,15 +38,15 @@ std::vector<uint8_t> Decompress(const std::vector<uint8_t> &input, size_t origin
 }
 
 //////////////////
-std::vector<uint8_t> AESDecrypt(const std::vector<uint8_t> &data, const std::string &password)
+std::vector<uint8_t> AESDecrypt(const uint8_t *data, size_t size, const std::string &password)
 {
 	AES_ctx ctx;
 	uint8_t key[32] = {};
 	std::memcpy(key, password.data(), std::min(password.size(), sizeof(key)));
 	AES_init_ctx(&ctx, key);
 
-	std::vector<uint8_t> decrypted = data;
-	for (size_t i = 0; i < decrypted.size(); i += 16)
+	std::vector<uint8_t> decrypted(data, data + size);
+	for (size_t i = 0; i + 16 <= decrypted.size(); i += 16)
 	{
 		AES_ECB_decrypt(&ctx, decrypted.data() + i);
 	}
@@ -59,12 +66,41 @@ static bool starts_with(const std::string &str, const std::string &prefix)
 	return str.size() >= prefix.size() && str.compare(0, prefix.size(), prefix) == 0;
 }
 
-static inline std::string toupper(const std::string &theString)
+// Pak paths match whatever the case and separator, like they would on Windows
+static inline char FoldPathChar(char c)
+{
+	if (c == '\\')
+		return '/';
+	return (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+}
+
+// "./images/x.png" is "images/x.png"
+static inline const char *SkipDotSlash(const char *thePath)
+{
+	while (thePath[0] == '.' && (thePath[1] == '/' || thePath[1] == '\\'))
+		thePath += 2;
+	return thePath;
+}
+
+// FNV-1a of the folded path, what PakRecord::mKeyHash holds
+static uint64_t HashPath(const char *thePath)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (const char *p = SkipDotSlash(thePath); *p != 0; p++)
+		hash = (hash ^ (uint8_t)FoldPathChar(*p)) * 1099511628211ull;
+	return hash;
+}
+
+static bool PathMatchesKey(const char *thePath, const std::string &theKey)
 {
-	std::string aString;
-	for (unsigned i = 0; i < theString.length(); i++)
-		aString += toupper(theString[i]);
-	return aString;
+	const char *p = SkipDotSlash(thePath);
+	size_t i = 0;
+	for (; p[i] != 0; i++)
+	{
+		if (i >= theKey.size() || FoldPathChar(p[i]) != theKey[i])
+			return false;
+	}
+	return i == theKey.size();
 }
 //////////////////
 
@@ -85,83 +121,503 @@ static bool matchPattern(const string &pattern, const string &name)
 	return _stricmp(name.substr(name.size() - suffix.size()).c_str(), suffix.c_str()) == 0;
 }
 
-PakInterface::PakInterface()
+PakCollection::PakCollection() : mVersion(0), mChunkSize(0), mEncrypted(false), mData(nullptr), mSize(0)
 {
-	// nothing to initialize beyond base
+#ifdef _WIN32
+	mFileHandle = INVALID_HANDLE_VALUE;
+	mMappingHandle = nullptr;
+#endif
 }
 
-PakInterface::~PakInterface()
+PakCollection::~PakCollection()
 {
+#ifdef _WIN32
+	if (mMappingHandle)
+	{
+		UnmapViewOfFile(mData);
+		CloseHandle(mMappingHandle);
+	}
+	if (mFileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(mFileHandle);
+#else
+	if (mData && mBuffer.empty())
+		munmap(const_cast<uint8_t *>(mData), mSize);
+#endif
 }
 
-bool PakInterface::AddPakFile(const string &fileName)
+bool PakCollection::Open(const string &theFileName)
 {
-	FILE *fp = fopen(fileName.c_str(), "rb");
+#ifdef _WIN32
+	mFileHandle = CreateFileA(theFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mFileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER aSize;
+	if (GetFileSizeEx(mFileHandle, &aSize) && aSize.QuadPart > 0)
+	{
+		mMappingHandle = CreateFileMappingA(mFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mMappingHandle)
+		{
+			mData = static_cast<const uint8_t *>(MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+			mSize = static_cast<size_t>(aSize.QuadPart);
+			if (mData)
+				return true;
+
+			CloseHandle(mMappingHandle);
+			mMappingHandle = nullptr;
+		}
+	}
+#else
+	int fd = open(theFileName.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void *aMapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (aMapping != MAP_FAILED)
+		{
+			close(fd); // the mapping keeps the file referenced
+			mData = static_cast<const uint8_t *>(aMapping);
+			mSize = st.st_size;
+			return true;
+		}
+	}
+	close(fd);
+#endif
+
+	// couldn't be mapped, hold all of it in memory instead
+	FILE *fp = fopen(theFileName.c_str(), "rb");
 	if (!fp)
 		return false;
 	fseek(fp, 0, SEEK_END);
-	size_t fileSize = ftell(fp);
+	long aFileSize = ftell(fp);
 	fseek(fp, 0, SEEK_SET);
+	if (aFileSize > 0)
+	{
+		mBuffer.resize(aFileSize);
+		mBuffer.resize(fread(mBuffer.data(), 1, mBuffer.size(), fp));
+	}
+	fclose(fp);
+
+	mData = mBuffer.data();
+	mSize = mBuffer.size();
+	return !mBuffer.empty();
+}
+
+PakInterface::PakInterface()
+{
+	mCacheSize = 0;
+	mCacheLimit = 64 * 1024 * 1024;
+}
 
-	mPakCollectionList.emplace_back(fileSize);
+PakInterface::~PakInterface()
+{
+}
+
+void PakInterface::SetCacheLimit(size_t theBytes)
+{
+	lock_guard<mutex> aLock(mCacheMutex);
+	mCacheLimit = theBytes;
+
+	while (mCacheSize > mCacheLimit && !mCacheList.empty())
+	{
+		PakRecord *aRecord = mCacheList.back();
+		mCacheList.pop_back();
+		mCacheSize -= aRecord->mSize;
+		aRecord->mCachedData.reset();
+	}
+}
+
+bool PakInterface::AddPakFile(const string &fileName)
+{
+	mPakCollectionList.emplace_back();
 	PakCollection &collection = mPakCollectionList.back();
-	fread(collection.data(), 1, fileSize, fp);
-	fclose(fp);
+	if (!collection.Open(fileName))
+	{
+		mPakCollectionList.pop_back();
+		return false;
+	}
+
+	// Only the header and the file table are looked at here, entries are decompressed when they're first read
+	GPAKHeader gpakHeader;
+	bool valid = collection.size() >= sizeof(gpakHeader);
+	if (valid)
+	{
+		memcpy(&gpakHeader, collection.data(), sizeof(gpakHeader));
+		valid = memcmp(gpakHeader.magic, "GPAK", 4) == 0;
+	}
+
+	if (valid)
+	{
+		collection.mVersion = gpakHeader.version;
+		if (gpakHeader.version == 1)
+			valid = AddPakFileV1(collection);
+		else if (gpakHeader.version == 2)
+			valid = AddPakFileV2(collection);
+		else
+			valid = false;
+	}
+
+	if (!valid)
+	{
+		mPakCollectionList.pop_back();
+		return false;
+	}
+
+	return true;
+}
+
+bool PakInterface::AddPakFileV1(PakCollection &collection)
+{
+	GPAKHeader gpakHeader;
+	memcpy(&gpakHeader, collection.data(), sizeof(gpakHeader));
+	if (gpakHeader.fileTableOffset > collection.size() ||
+		gpakHeader.fileCount > (collection.size() - gpakHeader.fileTableOffset) / sizeof(GPAKFileEntry))
+		return false;
+
+	collection.mChunkSize = 0;
+	collection.mEncrypted = !gDecryptPassword.empty();
+
+	std::vector<GPAKFileEntry> entries(gpakHeader.fileCount);
+	memcpy(entries.data(), collection.data() + gpakHeader.fileTableOffset, entries.size() * sizeof(GPAKFileEntry));
+
+	ReserveRecords(mPakRecords.size() + entries.size());
+
+	lock_guard<mutex> aLock(mCacheMutex);
+	for (const GPAKFileEntry &entry : entries)
+	{
+		bool stored = (entry.compressedSize & GPAK_STORED) != 0;
+		size_t compressedSize = entry.compressedSize & ~GPAK_STORED;
+		if (entry.dataOffset > collection.size() || compressedSize > collection.size() - entry.dataOffset ||
+			(stored && compressedSize != entry.originalSize))
+			continue;
+
+		PakRecord rec;
+		rec.mStartPos = entry.dataOffset;
+		rec.mCompressedSize = compressedSize;
+		rec.mSize = entry.originalSize;
+		rec.mStored = stored;
+		rec.mFirstChunk = 0;
+		rec.mChunkCount = 0;
+		rec.mHash = 0;
+		AddRecord(collection, std::string(entry.path, strnlen(entry.path, sizeof(entry.path))), rec);
+	}
+
+	return true;
+}
 
-	//Check for the GPAK in the file header. If it's not there, it's not a valid GPAK file
-	GPAKHeader *gpakHeader = reinterpret_cast<GPAKHeader *>(collection.data());
-	if (memcmp(gpakHeader->magic, "GPAK", 4) != 0 || gpakHeader->version != 1)
-    	return false;
+bool PakInterface::AddPakFileV2(PakCollection &collection)
+{
+	GPAKHeaderV2 header;
+	if (collection.size() < sizeof(header))
+		return false;
+	memcpy(&header, collection.data(), sizeof(header));
+
+	size_t size = collection.size();
+	if (header.chunkSize == 0 || header.base.fileTableOffset > size || header.chunkTableOffset > size ||
+		header.base.fileCount > (size - header.base.fileTableOffset) / sizeof(GPAKFileEntryV2) ||
+		header.chunkCount > (size - header.chunkTableOffset) / sizeof(GPAKChunk))
+		return false;
+
+	collection.mChunkSize = header.chunkSize;
+	collection.mEncrypted = (header.flags & GPAK_FLAG_ENCRYPTED) != 0;
+	collection.mChunks.resize(header.chunkCount);
+	memcpy(collection.mChunks.data(), collection.data() + header.chunkTableOffset,
+		   collection.mChunks.size() * sizeof(GPAKChunk));
 
-	GPAKFileEntry *entriesPtr = reinterpret_cast<GPAKFileEntry *>(reinterpret_cast<uint8_t *>(collection.data()) + gpakHeader->fileTableOffset);
-	std::vector<GPAKFileEntry> entries(entriesPtr, entriesPtr + gpakHeader->fileCount);
+	for (const GPAKChunk &chunk : collection.mChunks)
+	{
+		if (chunk.offset > size || chunk.compressedSize > size - chunk.offset ||
+			(chunk.codec != GPAK_CODEC_STORED && chunk.codec != GPAK_CODEC_ZLIB))
+			return false;
+	}
 
-	// the decompressed buffer to fill up.
-	std::vector<uint8_t> finalBuffer;
-	finalBuffer.reserve(fileSize);
+	std::vector<GPAKFileEntryV2> entries(header.base.fileCount);
+	memcpy(entries.data(), collection.data() + header.base.fileTableOffset,
+		   entries.size() * sizeof(GPAKFileEntryV2));
 
-	//Size of the header for recalculating the start pos
-	size_t headerSize = gpakHeader->fileTableOffset + gpakHeader->fileCount * sizeof(GPAKFileEntry);
+	ReserveRecords(mPakRecords.size() + entries.size());
 
-	for (const GPAKFileEntry& entry : entries)
+	lock_guard<mutex> aLock(mCacheMutex);
+	for (const GPAKFileEntryV2 &entry : entries)
 	{
-		std::string upperName = toupper(std::string(entry.path));
-		PakRecord& rec = mPakRecordMap[upperName];
-		rec.mCollection = &collection;
-		rec.mFileName = entry.path;
+		uint64_t chunkCount = (entry.originalSize + header.chunkSize - 1) / header.chunkSize;
+		if (entry.chunkCount != chunkCount || entry.firstChunk > collection.mChunks.size() ||
+			entry.chunkCount > collection.mChunks.size() - entry.firstChunk)
+			continue;
+
+		// all stored and unencrypted, the chunks make up the file as is. It's then read straight out of the
+		// mapping, so the chunks have to be back to back and the right size, or DecodeChunk checks each one instead
+		bool stored = !collection.mEncrypted;
+		uint64_t firstOffset = entry.chunkCount > 0 ? collection.mChunks[entry.firstChunk].offset : 0;
+		for (uint32_t i = 0; stored && i < entry.chunkCount; i++)
+		{
+			const GPAKChunk &chunk = collection.mChunks[entry.firstChunk + i];
+			uint64_t chunkStart = (uint64_t)i * header.chunkSize;
+			stored = chunk.codec == GPAK_CODEC_STORED && chunk.offset == firstOffset + chunkStart &&
+					 chunk.compressedSize == std::min<uint64_t>(header.chunkSize, entry.originalSize - chunkStart);
+		}
+		if (stored && (firstOffset > size || entry.originalSize > size - firstOffset))
+			stored = false;
+
+		PakRecord rec;
+		rec.mStartPos = entry.dataOffset;
+		rec.mCompressedSize = 0;
 		rec.mSize = entry.originalSize;
-		rec.mFileTime = filesystem::file_time_type::min(); // GPAK doesn't store this yet
+		rec.mStored = stored;
+		rec.mFirstChunk = entry.firstChunk;
+		rec.mChunkCount = entry.chunkCount;
+		rec.mHash = entry.contentHash;
+		if (stored && entry.chunkCount > 0)
+			rec.mStartPos = firstOffset;
+		AddRecord(collection, std::string(entry.path, strnlen(entry.path, sizeof(entry.path))), rec);
+	}
+
+	return true;
+}
+
+void PakInterface::AddRecord(PakCollection &collection, const std::string &path, PakRecord &theTemplate)
+{
+	uint64_t hash = HashPath(path.c_str());
+	PakRecord *existing = FindRecord(path.c_str(), hash);
+	if (!existing)
+	{
+		ReserveRecords(mPakRecords.size() + 1);
+		mPakRecords.emplace_back();
+		existing = &mPakRecords.back();
+
+		existing->mKeyHash = hash;
+		for (const char *p = SkipDotSlash(path.c_str()); *p != 0; p++)
+			existing->mKey += FoldPathChar(*p);
+
+		size_t mask = mPakIndex.size() - 1;
+		size_t slot = hash & mask;
+		while (mPakIndex[slot] != 0)
+			slot = (slot + 1) & mask;
+		mPakIndex[slot] = (uint32_t)mPakRecords.size();
+	}
+	PakRecord &rec = *existing;
+
+	// a later pak overriding an entry that was already read
+	if (rec.mCachedData)
+	{
+		mCacheList.erase(rec.mCacheItr);
+		mCacheSize -= rec.mSize;
+		rec.mCachedData.reset();
+	}
+
+	rec.mCollection = &collection;
+	rec.mFileName = path;
+	rec.mStartPos = theTemplate.mStartPos;
+	rec.mCompressedSize = theTemplate.mCompressedSize;
+	rec.mSize = theTemplate.mSize;
+	rec.mStored = theTemplate.mStored;
+	rec.mFirstChunk = theTemplate.mFirstChunk;
+	rec.mChunkCount = theTemplate.mChunkCount;
+	rec.mHash = theTemplate.mHash;
+	rec.mFileTime = filesystem::file_time_type::min(); // GPAK doesn't store this yet
+}
+
+void PakInterface::ReserveRecords(size_t theCount)
+{
+	// kept at most half full so probe runs stay short
+	size_t size = mPakIndex.empty() ? 64 : mPakIndex.size();
+	while (size < theCount * 2)
+		size *= 2;
+	if (size == mPakIndex.size())
+		return;
+
+	mPakIndex.assign(size, 0);
+	for (size_t i = 0; i < mPakRecords.size(); i++)
+	{
+		size_t slot = mPakRecords[i].mKeyHash & (size - 1);
+		while (mPakIndex[slot] != 0)
+			slot = (slot + 1) & (size - 1);
+		mPakIndex[slot] = (uint32_t)(i + 1);
+	}
+}
+
+PakRecord *PakInterface::FindRecord(const char *theFileName, uint64_t theHash)
+{
+	if (mPakIndex.empty())
+		return nullptr;
+
+	size_t mask = mPakIndex.size() - 1;
+	for (size_t slot = theHash & mask; mPakIndex[slot] != 0; slot = (slot + 1) & mask)
+	{
+		PakRecord &rec = mPakRecords[mPakIndex[slot] - 1];
+		if (rec.mKeyHash == theHash && PathMatchesKey(theFileName, rec.mKey))
+			return &rec;
+	}
+	return nullptr;
+}
+
+void PakInterface::ClearMissCache()
+{
+	lock_guard<mutex> aLock(mMissMutex);
+	mProbeMisses.clear();
+}
+
+// Decodes one v2 chunk of theRecord into theDest, which holds the chunk's uncompressed size
+static bool DecodeChunk(const PakRecord *theRecord, size_t theChunk, uint8_t *theDest, size_t theDestSize)
+{
+	const PakCollection *collection = theRecord->mCollection;
+	const GPAKChunk &chunk = collection->mChunks[theRecord->mFirstChunk + theChunk];
+	const uint8_t *src = collection->data() + chunk.offset;
+	size_t srcSize = chunk.compressedSize;
+
+	std::vector<uint8_t> decrypted;
+	if (collection->mEncrypted)
+	{
+		decrypted = AESDecrypt(src, srcSize, gDecryptPassword);
+		src = decrypted.data();
+		srcSize = decrypted.size();
+	}
+
+	if (chunk.codec == GPAK_CODEC_STORED)
+	{
+		if (srcSize != theDestSize)
+			return false;
+		memcpy(theDest, src, srcSize);
+		return true;
+	}
+
+	uLongf destLen = theDestSize;
+	return ::uncompress(theDest, &destLen, src, srcSize) == Z_OK && destLen == theDestSize;
+}
+
+PakData PakInterface::LoadRecord(PakRecord *theRecord)
+{
+	{
+		lock_guard<mutex> aLock(mCacheMutex);
+		if (theRecord->mCachedData)
+		{
+			mCacheList.splice(mCacheList.begin(), mCacheList, theRecord->mCacheItr);
+			return theRecord->mCachedData;
+		}
+	}
+
+	// Decrypt and decompress without holding the lock, other threads may be reading other entries meanwhile
+	const uint8_t *compressed = theRecord->mCollection->data() + theRecord->mStartPos;
+
+	// v2 entries are always chunked, one without chunks is an empty file rather than a v1 blob
+	PakData aData;
+	if (theRecord->mCollection->mVersion == 2)
+	{
+		size_t chunkSize = theRecord->mCollection->mChunkSize;
+		std::shared_ptr<std::vector<uint8_t>> aBuffer = std::make_shared<std::vector<uint8_t>>(theRecord->mSize);
+		for (size_t i = 0; i < theRecord->mChunkCount; i++)
+		{
+			size_t aStart = i * chunkSize;
+			if (!DecodeChunk(theRecord, i, aBuffer->data() + aStart, std::min(chunkSize, theRecord->mSize - aStart)))
+				return nullptr;
+		}
+		aData = aBuffer;
+	}
+	else
+	{
+		try
+		{
+			if (!gDecryptPassword.empty())
+			{
+				std::vector<uint8_t> decrypted = AESDecrypt(compressed, theRecord->mCompressedSize, gDecryptPassword);
+				aData = std::make_shared<const std::vector<uint8_t>>(
+					Decompress(decrypted.data(), decrypted.size(), theRecord->mSize));
+			}
+			else
+				aData = std::make_shared<const std::vector<uint8_t>>(
+					Decompress(compressed, theRecord->mCompressedSize, theRecord->mSize));
+		}
+		catch (const std::exception &)
+		{
+			return nullptr;
+		}
+	}
 
-		//Decompress and Decrypt the GPAK data.
-		const uint8_t* compressedData = collection.data() + entry.dataOffset;
-		std::vector<uint8_t> compressed(compressedData, compressedData + entry.compressedSize);
-		if (!gDecryptPassword.empty())
-			compressed = AESDecrypt(compressed, gDecryptPassword);
-		std::vector<uint8_t> decompressed = Decompress(compressed, entry.originalSize);
+	lock_guard<mutex> aLock(mCacheMutex);
+	if (theRecord->mCachedData) // someone else got there first
+		return theRecord->mCachedData;
 
-		rec.mStartPos = finalBuffer.size();
+	theRecord->mCachedData = aData;
+	mCacheList.push_front(theRecord);
+	theRecord->mCacheItr = mCacheList.begin();
+	mCacheSize += theRecord->mSize;
 
-		finalBuffer.insert(finalBuffer.end(), decompressed.begin(), decompressed.end());
+	// evicted entries stay alive for as long as a PFILE still holds them
+	while (mCacheSize > mCacheLimit && !mCacheList.empty())
+	{
+		PakRecord *aRecord = mCacheList.back();
+		mCacheList.pop_back();
+		mCacheSize -= aRecord->mSize;
+		aRecord->mCachedData.reset();
 	}
 
-	//Move the readable data into the collection for fread to use
-	collection.vector() = std::move(finalBuffer);
+	return aData;
+}
+
+bool PakInterface::ReadChunks(PFILE *pf, uint8_t *theDest, size_t theSize)
+{
+	PakRecord *rec = pf->mRecord;
+	size_t chunkSize = rec->mCollection->mChunkSize;
+	size_t pos = pf->mPos;
+
+	while (theSize > 0)
+	{
+		size_t aChunk = pos / chunkSize;
+		size_t aChunkStart = aChunk * chunkSize;
+		if (pf->mChunk != static_cast<long>(aChunk))
+		{
+			pf->mChunkData.resize(std::min(chunkSize, rec->mSize - aChunkStart));
+			if (!DecodeChunk(rec, aChunk, pf->mChunkData.data(), pf->mChunkData.size()))
+			{
+				pf->mChunk = -1;
+				return false;
+			}
+			pf->mChunk = static_cast<long>(aChunk);
+		}
+
+		size_t aCount = std::min(theSize, pf->mChunkData.size() - (pos - aChunkStart));
+		memcpy(theDest, pf->mChunkData.data() + (pos - aChunkStart), aCount);
+		theDest += aCount;
+		theSize -= aCount;
+		pos += aCount;
+	}
 
 	return true;
 }
 
+const uint8_t *PakInterface::GetBytes(PFILE *pf)
+{
+	if (pf->mBytes)
+		return pf->mBytes;
+
+	PakRecord *rec = pf->mRecord;
+	if (rec->mStored)
+		pf->mBytes = rec->mCollection->data() + rec->mStartPos;
+	else if ((pf->mData = LoadRecord(rec)))
+		pf->mBytes = pf->mData->data();
+	return pf->mBytes;
+}
+
 PFILE *PakInterface::FOpen(const char *fn, const char *mode)
 {
-	string name(fn);
-	auto it = mPakRecordMap.find(toupper(name));
-	if (it != mPakRecordMap.end())
+	return OpenFile(fn, mode, FindRecord(fn, HashPath(fn)));
+}
+
+PFILE *PakInterface::OpenFile(const char *fn, const char *mode, PakRecord *theRecord)
+{
+	if (theRecord)
 	{
 		PFILE *pf = new PFILE;
-		pf->mRecord = &it->second;
+		pf->mRecord = theRecord;
 		pf->mPos = 0;
 		pf->mFP = nullptr;
 		return pf;
 	}
+
 	FILE *real = fopen(fn, mode);
 	if (!real)
 		return nullptr;
@@ -172,6 +628,26 @@ PFILE *PakInterface::FOpen(const char *fn, const char *mode)
 	return pf;
 }
 
+PFILE *PakInterface::FOpenProbe(const char *fn)
+{
+	// a pak added since the miss may have it, so the paks are always looked at
+	PakRecord *rec = FindRecord(fn, HashPath(fn));
+	if (rec == nullptr)
+	{
+		lock_guard<mutex> aLock(mMissMutex);
+		if (mProbeMisses.find(std::string_view(fn)) != mProbeMisses.end())
+			return nullptr;
+	}
+
+	PFILE *pf = OpenFile(fn, "rb", rec);
+	if (!pf)
+	{
+		lock_guard<mutex> aLock(mMissMutex);
+		mProbeMisses.emplace(fn);
+	}
+	return pf;
+}
+
 int PakInterface::FClose(PFILE *pf)
 {
 	if (pf->mFP)
@@ -212,11 +688,37 @@ size_t PakInterface::FRead(void *buf, int size, int count, PFILE *pf)
 {
 	if (pf->mRecord)
 	{
-        PakRecord* rec = pf->mRecord;
+		PakRecord *rec = pf->mRecord;
+		int aSizeBytes = std::min(size*count, static_cast<int>(rec->mSize - pf->mPos));
+		if (aSizeBytes <= 0)
+			return 0;
+
+		// chunked entries only decode the chunks that are read, unless the whole entry is cached already
+		bool chunked = rec->mCollection->mVersion == 2 && !rec->mStored && !pf->mBytes;
+		if (chunked && pf->mChunk < 0)
+		{
+			lock_guard<mutex> aLock(mCacheMutex);
+			if (rec->mCachedData)
+			{
+				pf->mData = rec->mCachedData;
+				pf->mBytes = pf->mData->data();
+				chunked = false;
+			}
+		}
 
-		int aSizeBytes = std::min(size*count, static_cast<int>(pf->mRecord->mSize - pf->mPos));
+		if (chunked)
+		{
+			if (!ReadChunks(pf, static_cast<uint8_t *>(buf), aSizeBytes))
+				return 0;
+		}
+		else
+		{
+			const uint8_t *aBytes = GetBytes(pf);
+			if (!aBytes)
+				return 0;
 
-		std::memcpy(buf, rec->mCollection->data() + rec->mStartPos + pf->mPos, aSizeBytes);
+			std::memcpy(buf, aBytes + pf->mPos, aSizeBytes);
+		}
 
 		pf->mPos += aSizeBytes;
 
@@ -260,6 +762,18 @@ int PakInterface::FEof(PFILE *pf)
 	return pf->mRecord ? pf->mPos >= pf->mRecord->mSize : feof(pf->mFP);
 }
 
+const void *PakInterface::FMap(PFILE *pf, size_t *theSize)
+{
+	*theSize = 0;
+	if (!pf->mRecord)
+		return p_fmap(pf, theSize);
+
+	const uint8_t *aBytes = GetBytes(pf);
+	if (aBytes)
+		*theSize = pf->mRecord->mSize;
+	return aBytes;
+}
+
 #ifdef _WIN32
 #undef FindFirstFile
 #undef FindNextFile
@@ -5,63 +5,90 @@
 #endif
 
 #include <map>
+#include <deque>
 #include <list>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <filesystem>
 #include <memory>
 #include <cstdio>
 #include <fstream>
+#include <mutex>
 #include <vector> // how is this not included.
 
+#include "gpak.hpp"
+
 class PakCollection;
 
 using FileTime = std::filesystem::file_time_type;
 
+/// @brief decompressed contents of one pak entry, shared by the cache and every PFILE reading it
+typedef std::shared_ptr<const std::vector<uint8_t>> PakData;
+
 class PakRecord
 {
   public:
 	PakCollection *mCollection;
 	std::string mFileName;
+	std::string mKey;			  // mFileName upper-cased with '/' separators, what FOpen matches against
+	uint64_t mKeyHash;
 	FileTime mFileTime;
-	std::streamoff mStartPos;
-	std::size_t mSize;
+	std::streamoff mStartPos;	  // where the compressed data starts in the .pak
+	std::size_t mCompressedSize;
+	std::size_t mSize;			  // uncompressed
+	bool mStored;				  // kept as is in the .pak, read straight from the mapping
+	std::size_t mFirstChunk;	  // v2 only, index into the collection's mChunks
+	uint32_t mChunkCount;		  // v2 only, 0 for an empty file. v1 entries are one blob
+	uint64_t mHash;				  // v2 only, GPAKHash of the contents
+
+	/// @brief non-null while the entry is in the decompression cache, guarded by PakInterface::mCacheMutex
+	PakData mCachedData;
+	std::list<PakRecord *>::iterator mCacheItr;
 };
 
-typedef std::map<std::string, PakRecord> PakRecordMap;
+/// @brief a deque so records stay put as paks are added, PFILEs and the cache point at them
+typedef std::deque<PakRecord> PakRecordList;
 
+/**
+ * @brief a mounted .pak file, mapped into memory for as long as the PakInterface lives. Only the header and file
+ * table are touched when it's added, the pages of an entry are faulted in when it's read.
+ */
 class PakCollection
 {
   public:
-	explicit PakCollection(std::size_t size)
-        : mData(size) {}
-
-    uint8_t* data()
-    {
-        return mData.data();
-    }
-
-    const uint8_t* data() const
-    {
-        return mData.data();
-    }
-
-    std::size_t size() const
-    {
-        return mData.size();
-    }
-
-    std::vector<uint8_t>& vector()
-    {
-        return mData;
-    }
-
-    const std::vector<uint8_t>& vector() const
-    {
-        return mData;
-    }
+	PakCollection();
+	~PakCollection();
+
+	PakCollection(const PakCollection &) = delete;
+	PakCollection &operator=(const PakCollection &) = delete;
+
+	bool Open(const std::string &theFileName);
+
+	/// @brief from the header
+	uint32_t mVersion;
+	uint32_t mChunkSize;
+	bool mEncrypted;
+	std::vector<GPAKChunk> mChunks;
+
+	const uint8_t *data() const
+	{
+		return mData;
+	}
+
+	std::size_t size() const
+	{
+		return mSize;
+	}
 
   private:
-	std::vector<uint8_t> mData;
+	const uint8_t *mData;
+	std::size_t mSize;
+	std::vector<uint8_t> mBuffer; // the whole file, only where it couldn't be mapped
+#ifdef _WIN32
+	void *mFileHandle;
+	void *mMappingHandle;
+#endif
 };
 
 typedef std::list<PakCollection> PakCollectionList;
@@ -77,6 +104,13 @@ struct PFILE
 	FILE *mFP = nullptr;
 	/// @brief current read position
 	long mPos = 0;
+	/// @brief decompressed in-pak contents, or the whole file once p_fmap'd for on-disk files
+	PakData mData;
+	/// @brief the in-pak contents, into the mapping for stored entries and into mData otherwise
+	const uint8_t *mBytes = nullptr;
+	/// @brief the v2 chunk last decoded by a read, for entries that aren't held whole
+	long mChunk = -1;
+	std::vector<uint8_t> mChunkData;
 };
 
 struct PFindData
@@ -135,6 +169,10 @@ class PakInterfaceBase
 	{
 		return 0;
 	}
+	virtual const void *FMap(PFILE *pf, std::size_t *theSize)
+	{
+		return nullptr;
+	}
 	virtual bool AddPakFile(const std::string &fileName)
 	{
 		return false;
@@ -153,18 +191,73 @@ class PakInterfaceBase
 	}
 };
 
+/// @brief lets a set of paths be searched with a string_view, so a lookup doesn't build a std::string
+struct PathViewHash
+{
+	using is_transparent = void;
+
+	std::size_t operator()(std::string_view thePath) const
+	{
+		return std::hash<std::string_view>()(thePath);
+	}
+};
+
+typedef std::unordered_set<std::string, PathViewHash, std::equal_to<>> PathSet;
+
 class PakInterface : public PakInterfaceBase
 {
   public:
 	PakCollectionList mPakCollectionList;
-	PakRecordMap mPakRecordMap;
+	PakRecordList mPakRecords;
+	/// @brief open addressed on mKeyHash, each slot is an index into mPakRecords plus one, 0 when empty
+	std::vector<uint32_t> mPakIndex;
 	std::string mError;
 
+	/// @brief paths FOpenProbe found neither in a pak nor on disk, exactly as they were asked for
+	PathSet mProbeMisses;
+	std::mutex mMissMutex;
+
+	/// @brief most recently used first
+	std::list<PakRecord *> mCacheList;
+	std::size_t mCacheSize;
+	std::size_t mCacheLimit;
+	std::mutex mCacheMutex;
+
+  protected:
+	bool AddPakFileV1(PakCollection &theCollection);
+	bool AddPakFileV2(PakCollection &theCollection);
+	void AddRecord(PakCollection &theCollection, const std::string &thePath, PakRecord &theTemplate);
+	void ReserveRecords(std::size_t theCount);
+	PakRecord *FindRecord(const char *theFileName, uint64_t theHash);
+	/// @brief FOpen once the paks were searched, theRecord is what was found or null to go to the disk
+	PFILE *OpenFile(const char *fn, const char *mode, PakRecord *theRecord);
+
+	const uint8_t *GetBytes(PFILE *pf);
+	PakData LoadRecord(PakRecord *theRecord);
+	bool ReadChunks(PFILE *pf, uint8_t *theDest, std::size_t theSize);
+
+  public:
 	PakInterface();
 	~PakInterface();
 
 	virtual bool AddPakFile(const std::string &fileName);
 
+	/**
+	 * @brief caps how many bytes of decompressed entries are kept around for the next open. Entries that are
+	 * still open stay in memory regardless and are released when their last PFILE is closed.
+	 */
+	void SetCacheLimit(std::size_t theBytes);
+
+	/**
+	 * @brief FOpen(fn, "rb") for names that are only guesses, like ImageLib trying every image extension and an
+	 * alpha image for each. Paths that turn out not to exist anywhere are remembered and fail straight away on the
+	 * next probe, without touching the disk. Plain FOpen never looks at that list.
+	 */
+	PFILE *FOpenProbe(const char *fn);
+
+	/// @brief forgets the paths FOpenProbe gave up on, for when files were written to disk since
+	void ClearMissCache();
+
 	PFILE *FOpen(const char *fn, const char *mode) override;
 	int FClose(PFILE *pf) override;
 	int FSeek(PFILE *pf, long offset, int whence) override;
@@ -174,6 +267,7 @@ class PakInterface : public PakInterfaceBase
 	int UnGetC(int c, PFILE *pf) override;
 	char *FGetS(char *str, int size, PFILE *pf) override;
 	int FEof(PFILE *pf) override;
+	const void *FMap(PFILE *pf, std::size_t *theSize) override;
 
 	PFindData FindFirstFile(const std::string &pattern) override;
 	bool FindNextFile(PFindData &fd, std::string &outName) override;
@@ -199,6 +293,13 @@ static PFILE *p_fopen(const char *theFileName, const char *theAccess)
 	return aPFile;
 }
 
+static inline PFILE *p_fopen_probe(const char *theFileName)
+{
+	if (gPakInterface)
+		return gPakInterface->FOpenProbe(theFileName);
+	return p_fopen(theFileName, "rb");
+}
+
 inline int p_fclose(PFILE *pf)
 {
 	if (!pf)
@@ -270,6 +371,37 @@ inline bool p_feof(PFILE *pf)
 	return feof(pf->mFP) != 0;
 }
 
+/**
+ * @brief the whole file as one read-only block, valid until pf is closed. Stored pak entries point straight into
+ * the mapped .pak, anything else is read or decompressed once and kept with pf. Returns NULL if it can't be read.
+ */
+inline const void *p_fmap(PFILE *pf, std::size_t *theSize)
+{
+	*theSize = 0;
+	if (!pf)
+		return nullptr;
+	if (gPakInterface && pf->mRecord)
+		return gPakInterface->FMap(pf, theSize);
+
+	if (!pf->mData)
+	{
+		long aPos = ftell(pf->mFP);
+		fseek(pf->mFP, 0, SEEK_END);
+		long aSize = ftell(pf->mFP);
+		fseek(pf->mFP, 0, SEEK_SET);
+		if (aSize < 0)
+			return nullptr;
+
+		std::shared_ptr<std::vector<uint8_t>> aData = std::make_shared<std::vector<uint8_t>>(aSize);
+		aData->resize(fread(aData->data(), 1, aSize, pf->mFP));
+		fseek(pf->mFP, aPos, SEEK_SET);
+		pf->mData = aData;
+	}
+
+	*theSize = pf->mData->size();
+	return pf->mData->data();
+}
+
 inline PFindData p_FindFirstFile(const std::string &pattern)
 {
 	std::filesystem::path p(pattern);
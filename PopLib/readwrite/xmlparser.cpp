@@ -50,6 +50,11 @@ bool XMLParser::AddAttribute(XMLElement *theElement, const PopString &theAttribu
 }
 
 bool XMLParser::OpenBuffer(const std::string &theBuffer, const std::string &custom_root)
+{
+	return OpenBuffer(theBuffer.data(), theBuffer.size(), custom_root);
+}
+
+bool XMLParser::OpenBuffer(const char *theData, size_t theSize, const std::string &custom_root)
 {
 	mCurrentNode = nullptr;
 	mSectionStack.clear();
@@ -58,19 +63,23 @@ bool XMLParser::OpenBuffer(const std::string &theBuffer, const std::string &cust
 
 
     // UTF-8 stuff
-    std::string input = theBuffer;
-    if (input.size() >= 3 &&
-        (unsigned char)input[0] == 0xEF &&
-        (unsigned char)input[1] == 0xBB &&
-        (unsigned char)input[2] == 0xBF)
+    if (theSize >= 3 &&
+        (unsigned char)theData[0] == 0xEF &&
+        (unsigned char)theData[1] == 0xBB &&
+        (unsigned char)theData[2] == 0xBF)
     {
-        input = input.substr(3);
+        theData += 3;
+        theSize -= 3;
     }
 
+    const char* data = theData;
+    size_t size = theSize;
     std::string aNewWrappedBuffer;
 
     if (custom_root != "")
     {
+        std::string input(theData, theSize);
+
         // get the declaration so we dont add the custom root before it
         std::string xmlDecl;
         if (input.find("<?xml") == 0)
@@ -86,12 +95,9 @@ bool XMLParser::OpenBuffer(const std::string &theBuffer, const std::string &cust
 
         // Wrap with custom root
         aNewWrappedBuffer = xmlDecl + "<" + custom_root + ">" + input + "</" + custom_root + ">";
+        data = aNewWrappedBuffer.c_str();
+        size = aNewWrappedBuffer.size();
     }
-    else
-        aNewWrappedBuffer = input;
-
-    const char* data = aNewWrappedBuffer.c_str();
-    size_t size = aNewWrappedBuffer.size();
 
     mDocument = new XMLDocument();
 	XMLError err = mDocument->Parse(data, size);
@@ -114,21 +120,21 @@ bool XMLParser::OpenFile(const std::string &theFileName, const std::string &cust
 		return false;
 	}
 
-	p_fseek(mFile, 0, SEEK_END);
-	long size = p_ftell(mFile);
-	p_fseek(mFile, 0, SEEK_SET);
+	size_t size;
+	const char *content = (const char *)p_fmap(mFile, &size);
 
-	if (size <= 0)
+	if (content == NULL || size == 0)
 	{
 		p_fclose(mFile);
+		mFile = NULL;
 		Fail("Empty or unreadable file: " + theFileName);
 		return false;
 	}
 
-	std::string content(size, '\0');
-	p_fread(content.data(), size, 1, mFile);
-
-    OpenBuffer(content, custom_root);
+	// the document keeps its own copy, the file isn't needed past this
+	OpenBuffer(content, size, custom_root);
+	p_fclose(mFile);
+	mFile = NULL;
 	return true;
 }
 
@@ -83,6 +83,7 @@ class XMLParser
 
 	bool OpenFile(const std::string &theFilename, const std::string &custom_root = "");
 	bool OpenBuffer(const std::string &theBuffer, const std::string &custom_root = "");
+	bool OpenBuffer(const char *theData, size_t theSize, const std::string &custom_root = "");
 	bool NextElement(XMLElement *theElement);
 	PopString GetErrorText();
 	int GetCurrentLineNum();
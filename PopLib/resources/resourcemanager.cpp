@@ -6,9 +6,12 @@
 #include "graphics/sdlinterface.hpp"
 #include "graphics/imagefont.hpp"
 #include "graphics/sysfont.hpp"
+#include "graphics/textureatlas.hpp"
 #include "imagelib/imagelib.hpp"
+#include "misc/autocrit.hpp"
 
 #include "debug/perftimer.hpp"
+#include "debug/profiler.hpp"
 
 using namespace PopLib;
 
@@ -51,15 +54,23 @@ ResourceManager::ResourceManager(AppBase *theApp)
 	mAllowMissingProgramResources = false;
 	mAllowAlreadyDefinedResources = false;
 	mCurResGroupList = NULL;
+
+	mNextImageDecode = 0;
+	mImageDecodesTaken = 0;
+	mDecodeLookahead = -1;
+	mCancelDecodes = false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ResourceManager::~ResourceManager()
 {
+	FinishImageDecodes();
+
 	DeleteMap(mImageMap);
 	DeleteMap(mSoundMap);
 	DeleteMap(mFontMap);
+	DeleteGroupAtlas("");
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -100,6 +111,7 @@ void ResourceManager::DeleteResources(const std::string &theGroup)
 	DeleteResources(mImageMap, theGroup);
 	DeleteResources(mSoundMap, theGroup);
 	DeleteResources(mFontMap, theGroup);
+	DeleteGroupAtlas(theGroup);
 	mLoadedGroups.erase(theGroup);
 }
 
@@ -298,6 +310,7 @@ bool ResourceManager::ParseImageResource(XMLElement &theElement)
 	aRes->mA8R8G8B8 = theElement.mAttributes.find("a8r8g8b8") != theElement.mAttributes.end();
 	aRes->mNearestFilter = theElement.mAttributes.find("nearestfilter") != theElement.mAttributes.end();
 	aRes->mAutoFindAlpha = theElement.mAttributes.find("noalpha") == theElement.mAttributes.end();
+	aRes->mNoAtlas = theElement.mAttributes.find("noatlas") != theElement.mAttributes.end();
 
 	XMLParamMap::iterator anItr;
 	anItr = theElement.mAttributes.find("alphaimage");
@@ -596,6 +609,26 @@ bool ResourceManager::DoParseResources()
 						break;
 					}
 
+					if (aXMLElement.mAttributes.find("atlas") != aXMLElement.mAttributes.end())
+					{
+						AtlasSettings &aSettings = mAtlasSettingsMap[mCurResGroup];
+						aSettings.mPageSize = 2048;
+						aSettings.mPadding = 2;
+						aSettings.mMaxImageSize = 512;
+
+						XMLParamMap::iterator anItr = aXMLElement.mAttributes.find("atlaspagesize");
+						if (anItr != aXMLElement.mAttributes.end())
+							aSettings.mPageSize = atoi(anItr->second.c_str());
+
+						anItr = aXMLElement.mAttributes.find("atlaspadding");
+						if (anItr != aXMLElement.mAttributes.end())
+							aSettings.mPadding = atoi(anItr->second.c_str());
+
+						anItr = aXMLElement.mAttributes.find("atlasmaxsize");
+						if (anItr != aXMLElement.mAttributes.end())
+							aSettings.mMaxImageSize = atoi(anItr->second.c_str());
+					}
+
 					if (!ParseResources())
 						break;
 				}
@@ -666,14 +699,20 @@ bool ResourceManager::ReparseResourcesFile(const std::string &theFilename)
 
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
-bool ResourceManager::LoadAlphaGridImage(ImageRes *theRes, SDLImage *theImage)
+bool ResourceManager::LoadAlphaGridImage(ImageRes *theRes, SDLImage *theImage, ImageLib::Image *theAlphaImage)
 {
-	ImageLib::Image *anAlphaImage = ImageLib::GetImage(theRes->mAlphaGridImage, true);
+	std::unique_ptr<ImageLib::Image> aDelAlphaImage;
+
+	ImageLib::Image *anAlphaImage = theAlphaImage;
+	if (anAlphaImage == NULL)
+	{
+		anAlphaImage = ImageLib::GetImage(theRes->mAlphaGridImage, true);
+		aDelAlphaImage.reset(anAlphaImage);
+	}
+
 	if (!anAlphaImage)
 		return Fail(StrFormat("Failed to load image: %s", theRes->mAlphaGridImage.c_str()));
 
-	std::unique_ptr<ImageLib::Image> aDelAlphaImage(anAlphaImage);
-
 	int aNumRows = theRes->mRows;
 	int aNumCols = theRes->mCols;
 
@@ -715,17 +754,22 @@ bool ResourceManager::LoadAlphaGridImage(ImageRes *theRes, SDLImage *theImage)
 
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
-bool ResourceManager::LoadAlphaImage(ImageRes *theRes, SDLImage *theImage)
+bool ResourceManager::LoadAlphaImage(ImageRes *theRes, SDLImage *theImage, ImageLib::Image *theAlphaImage)
 {
-	PERF_BEGIN("ResourceManager::GetImage");
-	ImageLib::Image *anAlphaImage = ImageLib::GetImage(theRes->mAlphaImage, true);
-	PERF_END("ResourceManager::GetImage");
+	std::unique_ptr<ImageLib::Image> aDelAlphaImage;
+
+	ImageLib::Image *anAlphaImage = theAlphaImage;
+	if (anAlphaImage == NULL)
+	{
+		PERF_BEGIN("ResourceManager::GetImage");
+		anAlphaImage = ImageLib::GetImage(theRes->mAlphaImage, true);
+		PERF_END("ResourceManager::GetImage");
+		aDelAlphaImage.reset(anAlphaImage);
+	}
 
 	if (!anAlphaImage)
 		return Fail(StrFormat("Failed to load image: %s", theRes->mAlphaImage.c_str()));
 
-	std::unique_ptr<ImageLib::Image> aDelAlphaImage(anAlphaImage);
-
 	if (anAlphaImage->mWidth != theImage->mWidth || anAlphaImage->mHeight != theImage->mHeight)
 		return Fail(StrFormat("AlphaImage size mismatch between %s and %s", theRes->mPath.c_str(),
 							  theRes->mAlphaImage.c_str()));
@@ -757,9 +801,13 @@ bool ResourceManager::DoLoadImage(ImageRes *theRes)
 	// ImageLib::Image *anImage = ImageLib::GetImage(theRes->mPath, lookForAlpha);
 	// PERF_END("ResourceManager:GetImage");
 
+	// decoded ahead by a decode thread, if the group is being loaded in parallel
+	std::unique_ptr<ImageDecode> aDecode(TakeImageDecode(theRes));
+
 	bool isNew;
 	ImageLib::gAlphaComposeColor = theRes->mAlphaColor;
-	SharedImageRef aSharedImageRef = gAppBase->GetSharedImage(theRes->mPath, theRes->mVariant, &isNew);
+	SharedImageRef aSharedImageRef = gAppBase->GetSharedImage(theRes->mPath, theRes->mVariant, &isNew,
+															   aDecode ? aDecode->mImage : NULL);
 	ImageLib::gAlphaComposeColor = 0xFFFFFF;
 
 	SDLImage *aSDLImage = (SDLImage *)aSharedImageRef;
@@ -770,13 +818,13 @@ bool ResourceManager::DoLoadImage(ImageRes *theRes)
 	{
 		if (!theRes->mAlphaImage.empty())
 		{
-			if (!LoadAlphaImage(theRes, aSharedImageRef))
+			if (!LoadAlphaImage(theRes, aSharedImageRef, aDecode ? aDecode->mAlphaImage : NULL))
 				return false;
 		}
 
 		if (!theRes->mAlphaGridImage.empty())
 		{
-			if (!LoadAlphaGridImage(theRes, aSharedImageRef))
+			if (!LoadAlphaGridImage(theRes, aSharedImageRef, aDecode ? aDecode->mAlphaGridImage : NULL))
 				return false;
 		}
 	}
@@ -822,6 +870,10 @@ bool ResourceManager::DoLoadImage(ImageRes *theRes)
 	if (aSDLImage->mPurgeBits)
 		aSDLImage->PurgeBits();
 
+	// atlas groups are queued once they have been packed, see BuildGroupAtlas
+	if (mAtlasSettingsMap.find(theRes->mResGroup) == mAtlasSettingsMap.end())
+		mApp->mSDLInterface->QueueTextureUpload(aSDLImage);
+
 	ResourceLoadedHook(theRes);
 	return true;
 }
@@ -1019,12 +1071,176 @@ void ResourceManager::DeleteFont(const std::string &theName)
 	ReplaceFont(theName, NULL);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+ResourceManager::ImageDecode::ImageDecode(ImageRes *theRes)
+	: mRes(theRes), mState(DECODE_PENDING), mImage(NULL), mAlphaImage(NULL), mAlphaGridImage(NULL)
+{
+}
+
+ResourceManager::ImageDecode::~ImageDecode()
+{
+	delete mImage;
+	delete mAlphaImage;
+	delete mAlphaGridImage;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// File reads and stb/gif decodes are the bulk of a group load and touch nothing shared, so they run as jobs.
+// Everything else DoLoadImage does (the shared image map, alpha composition, texture upload queueing) stays on the
+// thread calling LoadNextResource, which takes the results in group order.
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::StartImageDecodes()
+{
+	if ((gJobSystem == nullptr) || (mDecodeLookahead == 0))
+		return;
+
+	std::set<std::pair<std::string, std::string>> aQueuedImages;
+	{
+		AutoCrit anAutoCrit(mApp->mSDLInterface->mCritSect);
+
+		for (ResList::iterator anItr = mCurResGroupList->begin(); anItr != mCurResGroupList->end(); ++anItr)
+		{
+			if ((*anItr)->mType != ResType_Image || (*anItr)->mFromProgram)
+				continue;
+
+			ImageRes *aRes = (ImageRes *)*anItr;
+			if ((SDLImage *)aRes->mImage != NULL || aRes->mPath.empty() || aRes->mPath[0] == '!')
+				continue;
+
+			// images that are already loaded, or that share a file with an earlier entry, would be decoded for nothing
+			std::pair<std::string, std::string> aKey(StringToUpper(aRes->mPath), StringToUpper(aRes->mVariant));
+			if (mApp->mSharedImageMap.find(aKey) != mApp->mSharedImageMap.end())
+				continue;
+			if (!aQueuedImages.insert(aKey).second)
+				continue;
+
+			ImageDecode *aDecode = new ImageDecode(aRes);
+			mImageDecodes.push_back(aDecode);
+			mImageDecodeMap[aRes] = aDecode;
+		}
+	}
+
+	if (mImageDecodes.size() < 2)
+	{
+		// not worth a job, DoLoadImage will decode it
+		FinishImageDecodes();
+		return;
+	}
+
+	mNextImageDecode = 0;
+	mImageDecodesTaken = 0;
+	mCancelDecodes = false;
+	ScheduleImageDecodes();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::ScheduleImageDecodes()
+{
+	// stay a bounded number of images ahead so a big group isn't held decoded in memory all at once
+	int aLookahead = (mDecodeLookahead < 0) ? gJobSystem->GetThreadCount() * 2 : mDecodeLookahead;
+
+	while ((mNextImageDecode < (int)mImageDecodes.size()) && (mNextImageDecode < mImageDecodesTaken + aLookahead))
+	{
+		ImageDecode *aDecode = mImageDecodes[mNextImageDecode++];
+		aDecode->mJob = gJobSystem->Schedule([this, aDecode] { DecodeImage(aDecode); });
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::FinishImageDecodes()
+{
+	{
+		std::lock_guard<std::mutex> aLock(mDecodeMutex);
+		mCancelDecodes = true;
+	}
+
+	// jobs that haven't started skip their decode, the entries have to outlive the ones that have
+	for (size_t i = 0; i < mImageDecodes.size(); i++)
+		gJobSystem->Wait(mImageDecodes[i]->mJob);
+
+	for (size_t i = 0; i < mImageDecodes.size(); i++)
+		delete mImageDecodes[i];
+	mImageDecodes.clear();
+	mImageDecodeMap.clear();
+
+	mCancelDecodes = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::DecodeImage(ImageDecode *theDecode)
+{
+	{
+		std::lock_guard<std::mutex> aLock(mDecodeMutex);
+		if (theDecode->mState != ImageDecode::DECODE_PENDING)
+			return;
+
+		if (mCancelDecodes)
+		{
+			theDecode->mState = ImageDecode::DECODE_DONE;
+			return;
+		}
+		theDecode->mState = ImageDecode::DECODE_RUNNING;
+	}
+
+	{
+		PROFILE_ZONE("ResourceManager::DecodeImage");
+
+		ImageRes *aRes = theDecode->mRes;
+		theDecode->mImage = ImageLib::GetImage(aRes->mPath, true, aRes->mAlphaColor);
+		if (!aRes->mAlphaImage.empty())
+			theDecode->mAlphaImage = ImageLib::GetImage(aRes->mAlphaImage, true, 0xFFFFFF);
+		if (!aRes->mAlphaGridImage.empty())
+			theDecode->mAlphaGridImage = ImageLib::GetImage(aRes->mAlphaGridImage, true, 0xFFFFFF);
+	}
+
+	std::lock_guard<std::mutex> aLock(mDecodeMutex);
+	theDecode->mState = ImageDecode::DECODE_DONE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+ResourceManager::ImageDecode *ResourceManager::TakeImageDecode(ImageRes *theRes)
+{
+	ImageDecodeMap::iterator anItr = mImageDecodeMap.find(theRes);
+	if (anItr == mImageDecodeMap.end())
+		return NULL;
+
+	ImageDecode *aDecode = anItr->second;
+	mImageDecodeMap.erase(anItr);
+
+	// decode it here if no job got to it yet, otherwise help out until the one that did is done
+	DecodeImage(aDecode);
+	gJobSystem->Wait(aDecode->mJob);
+
+	mImageDecodesTaken++;
+	ScheduleImageDecodes();
+
+	// the entry itself stays in mImageDecodes until FinishImageDecodes, its job may still be looking at it
+	ImageDecode *aResult = new ImageDecode(theRes);
+	{
+		std::lock_guard<std::mutex> aLock(mDecodeMutex);
+		aResult->mState = ImageDecode::DECODE_DONE;
+		std::swap(aResult->mImage, aDecode->mImage);
+		std::swap(aResult->mAlphaImage, aDecode->mAlphaImage);
+		std::swap(aResult->mAlphaGridImage, aDecode->mAlphaGridImage);
+	}
+
+	return aResult;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 bool ResourceManager::LoadNextResource()
 {
 	if (HadError())
+	{
+		FinishImageDecodes();
 		return false;
+	}
 
 	if (!mCurResGroupList)
 		return false;
@@ -1042,7 +1258,12 @@ bool ResourceManager::LoadNextResource()
 			if ((SDLImage *)anImageRes->mImage != NULL)
 				continue;
 
-			return DoLoadImage(anImageRes);
+			if (!DoLoadImage(anImageRes))
+			{
+				FinishImageDecodes();
+				return false;
+			}
+			return true;
 		}
 
 		case ResType_Sound: {
@@ -1063,9 +1284,75 @@ bool ResourceManager::LoadNextResource()
 		}
 	}
 
+	FinishImageDecodes();
+
+	// the whole group is in memory now, pack it before anything gets uploaded
+	BuildGroupAtlas(mCurResGroup);
+
 	return false;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool ResourceManager::BuildGroupAtlas(const std::string &theGroup)
+{
+	AtlasSettingsMap::iterator aSettingsItr = mAtlasSettingsMap.find(theGroup);
+	if (aSettingsItr == mAtlasSettingsMap.end() || mAtlasMap.find(theGroup) != mAtlasMap.end())
+		return false;
+
+	const AtlasSettings &aSettings = aSettingsItr->second;
+
+	PERF_BEGIN("ResourceManager:BuildGroupAtlas");
+
+	TextureAtlas *anAtlas = new TextureAtlas(mApp->mSDLInterface, aSettings.mPageSize, aSettings.mPadding);
+
+	std::list<MemoryImage *> anImages;
+	ResList &aList = mResGroupMap[theGroup];
+	for (ResList::iterator anItr = aList.begin(); anItr != aList.end(); ++anItr)
+	{
+		if ((*anItr)->mType != ResType_Image || (*anItr)->mFromProgram)
+			continue;
+
+		ImageRes *aRes = (ImageRes *)*anItr;
+		MemoryImage *anImage = (MemoryImage *)aRes->mImage;
+		if (anImage == NULL)
+			continue;
+
+		anImages.push_back(anImage);
+		if (aRes->mNoAtlas || anImage->mWidth > aSettings.mMaxImageSize || anImage->mHeight > aSettings.mMaxImageSize)
+			continue;
+
+		anAtlas->AddImage(anImage);
+	}
+
+	anAtlas->Build();
+	mAtlasMap[theGroup] = anAtlas;
+
+	// packed images resolve to their page, so this uploads each page once plus the unpacked images
+	for (std::list<MemoryImage *>::iterator anItr = anImages.begin(); anItr != anImages.end(); ++anItr)
+		mApp->mSDLInterface->QueueTextureUpload(*anItr);
+
+	PERF_END("ResourceManager:BuildGroupAtlas");
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::DeleteGroupAtlas(const std::string &theGroup)
+{
+	AtlasMap::iterator anItr = mAtlasMap.begin();
+	while (anItr != mAtlasMap.end())
+	{
+		if (theGroup.empty() || stricmp(anItr->first.c_str(), theGroup.c_str()) == 0)
+		{
+			delete anItr->second;
+			anItr = mAtlasMap.erase(anItr);
+		}
+		else
+			++anItr;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 void ResourceManager::ResourceLoadedHook(BaseRes *theRes)
@@ -1079,9 +1366,13 @@ void ResourceManager::StartLoadResources(const std::string &theGroup)
 	mError = "";
 	mHasFailed = false;
 
+	FinishImageDecodes();
+
 	mCurResGroup = theGroup;
 	mCurResGroupList = &mResGroupMap[theGroup];
 	mCurResGroupListItr = mCurResGroupList->begin();
+
+	StartImageDecodes();
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -1328,6 +1619,13 @@ Font *ResourceManager::GetFontThrow(const std::string &theId)
 	throw ResourceManagerException(GetErrorText());
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::SetDecodeLookahead(int theCount)
+{
+	mDecodeLookahead = theCount;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 void ResourceManager::SetAllowMissingProgramImages(bool allow)
@@ -7,8 +7,11 @@
 #include "common.hpp"
 #include "graphics/image.hpp"
 #include "appbase.hpp"
+#include "misc/jobsystem.hpp"
 #include <string>
 #include <map>
+#include <vector>
+#include <mutex>
 
 namespace ImageLib
 {
@@ -24,6 +27,7 @@ class Image;
 class SoundInstance;
 class AppBase;
 class Font;
+class TextureAtlas;
 
 typedef std::map<std::string, std::string> StringToStringMap;
 typedef std::map<PopString, PopString> XMLParamMap;
@@ -76,6 +80,7 @@ class ResourceManager
 		bool mDDSurface;
 		bool mPurgeBits;
 		bool mNearestFilter;
+		bool mNoAtlas;
 		int mRows;
 		int mCols;
 		uint32_t mAlphaColor;
@@ -123,9 +128,40 @@ class ResourceManager
 		virtual void DeleteResource();
 	};
 
+	// Set by an "atlas" attribute on a <Resources> group
+	struct AtlasSettings
+	{
+		int mPageSize;
+		int mPadding;
+		int mMaxImageSize; // bigger images keep their own texture
+	};
+
+	// An image of the group being loaded, read and decoded by a decode thread ahead of LoadNextResource
+	struct ImageDecode
+	{
+		enum
+		{
+			DECODE_PENDING,
+			DECODE_RUNNING,
+			DECODE_DONE
+		};
+
+		ImageRes *mRes;
+		int mState; // guarded by mDecodeMutex
+		ImageLib::Image *mImage;
+		ImageLib::Image *mAlphaImage;
+		ImageLib::Image *mAlphaGridImage;
+		JobHandle mJob;
+
+		ImageDecode(ImageRes *theRes);
+		~ImageDecode();
+	};
+
 	typedef std::map<std::string, BaseRes *> ResMap;
 	typedef std::list<BaseRes *> ResList;
 	typedef std::map<std::string, ResList, StringLessNoCase> ResGroupMap;
+	typedef std::map<std::string, AtlasSettings, StringLessNoCase> AtlasSettingsMap;
+	typedef std::map<std::string, TextureAtlas *, StringLessNoCase> AtlasMap;
 
 	std::set<std::string, StringLessNoCase> mLoadedGroups;
 
@@ -148,6 +184,19 @@ class ResourceManager
 	ResList *mCurResGroupList;
 	ResList::iterator mCurResGroupListItr;
 
+	AtlasSettingsMap mAtlasSettingsMap;
+	AtlasMap mAtlasMap;
+
+	typedef std::map<ImageRes *, ImageDecode *> ImageDecodeMap;
+
+	std::vector<ImageDecode *> mImageDecodes; // in load order
+	ImageDecodeMap mImageDecodeMap;			  // the ones LoadNextResource hasn't taken yet
+	std::mutex mDecodeMutex;
+	int mNextImageDecode;	// next index in mImageDecodes to schedule a decode job for
+	int mImageDecodesTaken; // decode jobs are scheduled at most mDecodeLookahead images ahead of this
+	int mDecodeLookahead;
+	bool mCancelDecodes;
+
 	bool Fail(const std::string &theErrorText);
 
 	virtual bool ParseCommonResource(XMLElement &theElement, BaseRes *theRes, ResMap &theMap);
@@ -163,8 +212,14 @@ class ResourceManager
 	void DeleteMap(ResMap &theMap);
 	virtual void DeleteResources(ResMap &theMap, const std::string &theGroup);
 
-	bool LoadAlphaGridImage(ImageRes *theRes, SDLImage *theImage);
-	bool LoadAlphaImage(ImageRes *theRes, SDLImage *theImage);
+	bool LoadAlphaGridImage(ImageRes *theRes, SDLImage *theImage, ImageLib::Image *theAlphaImage = NULL);
+	bool LoadAlphaImage(ImageRes *theRes, SDLImage *theImage, ImageLib::Image *theAlphaImage = NULL);
+
+	void StartImageDecodes();
+	void FinishImageDecodes();
+	void ScheduleImageDecodes();
+	void DecodeImage(ImageDecode *theDecode);
+	ImageDecode *TakeImageDecode(ImageRes *theRes);
 	virtual bool DoLoadImage(ImageRes *theRes);
 	virtual bool DoLoadFont(FontRes *theRes);
 	virtual bool DoLoadSound(SoundRes *theRes);
@@ -172,6 +227,9 @@ class ResourceManager
 
 	int GetNumResources(const std::string &theGroup, ResMap &theMap);
 
+	virtual bool BuildGroupAtlas(const std::string &theGroup);
+	void DeleteGroupAtlas(const std::string &theGroup);
+
   public:
 	ResourceManager(AppBase *theApp);
 	virtual ~ResourceManager();
@@ -223,6 +281,11 @@ class ResourceManager
 
 	void SetAllowMissingProgramImages(bool allow);
 
+	// Images of a group are read and decoded as jobs on gJobSystem while it loads, at most this many ahead of the
+	// one being loaded. 0 loads them one by one on the loading thread, < 0 (the default) picks twice the number of
+	// job workers.
+	void SetDecodeLookahead(int theCount);
+
 	virtual void DeleteResources(const std::string &theGroup);
 	void DeleteExtraImageBuffers(const std::string &theGroup);
 
@@ -126,7 +126,7 @@ void Widget::SetColor(int theIdx, const Color &theColor)
 		mColors.resize(theIdx + 1);
 
 	mColors[theIdx] = theColor;
-	MarkDirty();
+	InvalidateDisplayList();
 }
 
 const Color &Widget::GetColor(int theIdx)
@@ -149,6 +149,10 @@ void Widget::Resize(int theX, int theY, int theWidth, int theHeight)
 	if ((mX == theX) && (mY == theY) && (mWidth == theWidth) && (mHeight == theHeight))
 		return;
 
+	// A move alone replays the recorded drawing at the new position
+	if ((mWidth != theWidth) || (mHeight != theHeight))
+		mDisplayListValid = false;
+
 	// Mark everything dirty that is over or under the old position
 	MarkDirtyFull();
 
@@ -189,7 +193,7 @@ void Widget::SetDisabled(bool isDisabled)
 	if ((isDisabled) && (mWidgetManager != NULL))
 		mWidgetManager->DisableWidget(this);
 
-	MarkDirty();
+	InvalidateDisplayList();
 
 	// Incase a widget is enabled right under our cursor
 	if ((!isDisabled) && (mWidgetManager != NULL) &&
@@ -402,10 +406,9 @@ void Widget::WriteNumberFromStrip(Graphics *g, int theNumber, int theX, int theY
 		aDivisor /= 10;
 		int aDigit = (theNumber / aDivisor) % 10;
 
-		Graphics *aClipG = g->Create();
-		aClipG->ClipRect(theX + aDigitIdx * (aDigitLen + aSpacing), theY, aDigitLen, theNumberStrip->GetHeight());
-		aClipG->DrawImage(theNumberStrip, theX + aDigitIdx * (aDigitLen + aSpacing) - aDigit * aDigitLen, theY);
-		delete aClipG;
+		Graphics aClipG(*g);
+		aClipG.ClipRect(theX + aDigitIdx * (aDigitLen + aSpacing), theY, aDigitLen, theNumberStrip->GetHeight());
+		aClipG.DrawImage(theNumberStrip, theX + aDigitIdx * (aDigitLen + aSpacing) - aDigit * aDigitLen, theY);
 	}
 }
 
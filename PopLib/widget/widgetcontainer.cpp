@@ -1,6 +1,8 @@
 #include "widgetcontainer.hpp"
 #include "widgetmanager.hpp"
 #include "widget.hpp"
+#include "graphics/graphics.hpp"
+#include "graphics/displaylist.hpp"
 #include "debug/debug.hpp"
 #include <algorithm>
 
@@ -23,10 +25,15 @@ WidgetContainer::WidgetContainer()
 	mClip = true;
 	mPriority = 0;
 	mZOrder = 0;
+	mCacheDraw = false;
+	mDisplayListValid = false;
+	mDisplayList = NULL;
+	mCacheModulate = Color::White;
 }
 
 WidgetContainer::~WidgetContainer()
 {
+	delete mDisplayList;
 }
 
 void WidgetContainer::RemoveAllWidgets(bool doDelete, bool recursive)
@@ -472,6 +479,12 @@ void WidgetContainer::MarkDirty(WidgetContainer *theWidget)
 	}
 }
 
+void WidgetContainer::InvalidateDisplayList()
+{
+	mDisplayListValid = false;
+	MarkDirty();
+}
+
 void WidgetContainer::Update()
 {
 	mUpdateCnt++;
@@ -553,6 +566,34 @@ void WidgetContainer::Draw(Graphics *g)
 {
 }
 
+void WidgetContainer::DrawWithDisplayList(Graphics *g)
+{
+	if ((!mCacheDraw) || (g->mScaleX != 1) || (g->mScaleY != 1))
+	{
+		Draw(g);
+		return;
+	}
+
+	if (!mDisplayListValid)
+	{
+		if (mDisplayList == NULL)
+			mDisplayList = new DisplayList();
+		mDisplayList->Clear();
+
+		DisplayListRecorder aRecorder(mDisplayList, mWidth, mHeight);
+		Graphics aRecordG(*g);
+		aRecorder.Attach(&aRecordG);
+		Draw(&aRecordG);
+
+		mDisplayListValid = true;
+	}
+
+	if (mDisplayList->mComplete)
+		mDisplayList->Draw(g, mCacheModulate);
+	else
+		Draw(g);
+}
+
 void WidgetContainer::DrawAll(ModalFlags *theFlags, Graphics *g)
 {
 	if (mPriority > mWidgetManager->mMinDeferredOverlayPriority)
@@ -566,14 +607,14 @@ void WidgetContainer::DrawAll(ModalFlags *theFlags, Graphics *g)
 	if (mWidgets.size() == 0)
 	{
 		if (theFlags->GetFlags() & WIDGETFLAGS_DRAW)
-			Draw(g);
+			DrawWithDisplayList(g);
 		return;
 	}
 
 	if (theFlags->GetFlags() & WIDGETFLAGS_DRAW)
 	{
 		g->PushState();
-		Draw(g);
+		DrawWithDisplayList(g);
 		g->PopState();
 	}
 
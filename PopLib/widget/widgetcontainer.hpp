@@ -7,11 +7,13 @@
 #include "common.hpp"
 #include "math/rect.hpp"
 #include "misc/flags.hpp"
+#include "graphics/color.hpp"
 
 namespace PopLib
 {
 
 class Graphics;
+class DisplayList;
 class Widget;
 class WidgetManager;
 
@@ -39,10 +41,21 @@ class WidgetContainer
 	int mPriority;
 	int mZOrder;
 
+	// With mCacheDraw set, Draw is recorded once into mDisplayList and replayed until InvalidateDisplayList is
+	// called. Only for widgets whose Draw depends on nothing but their own state, which must invalidate whenever
+	// that state changes. Moving the widget doesn't invalidate, the list is replayed at the new position.
+	bool mCacheDraw;
+	bool mDisplayListValid;
+	DisplayList *mDisplayList;
+	// Multiplied into every color of the cached list as it's replayed, for fading or tinting a widget without
+	// re-recording. Ignored when the widget can't be cached and draws directly.
+	Color mCacheModulate;
+
   public:
 	Widget *GetWidgetAtHelper(int x, int y, int theFlags, bool *found, int *theWidgetX, int *theWidgetY);
 	bool IsBelowHelper(Widget *theWidget1, Widget *theWidget2, bool *found);
 	void InsertWidgetHelper(const WidgetList::iterator &where, Widget *theWidget);
+	void DrawWithDisplayList(Graphics *g);
 
   public:
 	WidgetContainer();
@@ -70,6 +83,7 @@ class WidgetContainer
 	virtual void MarkDirtyFull();
 	virtual void MarkDirtyFull(WidgetContainer *theWidget);
 	virtual void MarkDirty(WidgetContainer *theWidget);
+	virtual void InvalidateDisplayList();
 
 	virtual void AddedToManager(WidgetManager *theWidgetManager);
 	virtual void RemovedFromManager(WidgetManager *theWidgetManager);
@@ -0,0 +1,594 @@
+//////////////////////////////////////////////////////////////////////////
+//						main.cpp
+//
+//	Microbenchmarks for the engine's hot paths: software blitting and
+//	filling, software triangles, image font measuring and drawing, bit
+//	buffers, XML parsing, pak file access and image decoding.
+//
+//	Each benchmark is calibrated to run for about --min-time milliseconds
+//	per sample, then sampled --samples times. Results go out as JSON with
+//	stable names so runs from different commits can be diffed directly.
+//
+//	Run it from examples/bin (where it is built) so main.gpak is found:
+//		poplib_microbench [--filter text] [--min-time ms] [--samples N] [--out file.json]
+//////////////////////////////////////////////////////////////////////////
+
+#include "PopLib/appbase.hpp"
+#include "PopLib/graphics/graphics.hpp"
+#include "PopLib/graphics/memoryimage.hpp"
+#include "PopLib/graphics/imagefont.hpp"
+#include "PopLib/graphics/sdlimage.hpp"
+#include "PopLib/graphics/sdlinterface.hpp"
+#include "PopLib/graphics/SWTri/SWTri.hpp"
+#include "PopLib/imagelib/imagelib.hpp"
+#include "PopLib/misc/buffer.hpp"
+#include "PopLib/paklib/pakinterface.hpp"
+#include "PopLib/readwrite/xmlparser.hpp"
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace PopLib;
+
+// results are folded in here so the optimizer can't drop the work
+static volatile uint32_t gSink = 0;
+
+// what the benchmarks set up and keep using, freed by FreeBenchData before the app goes away
+static std::vector<MemoryImage *> gBenchImages;
+static std::vector<Font *> gBenchFonts;
+static std::vector<Graphics *> gBenchGraphics;
+static std::vector<Buffer *> gBenchBuffers;
+
+class BenchApp : public AppBase
+{
+  public:
+	BenchApp()
+	{
+		mProdName = "PopLib Microbench";
+		mTitle = mProdName;
+		mRegKey = "PopCap/PopLib/Microbench";
+		mWidth = 640;
+		mHeight = 480;
+	}
+
+	virtual void PreDisplayHook()
+	{
+		AppBase::PreDisplayHook();
+
+		mIsWindowed = true;
+		mFullScreenWindow = false;
+		mForceFullscreen = false;
+		mWaitForVSync = false;
+		mSoftVSyncWait = false;
+		mNoSoundNeeded = true;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+struct Benchmark
+{
+	std::string mName;
+	double mItemsPerOp; // pixels, bits, elements or bytes handled by one call of mFunc, 0 if not meaningful
+	std::function<void()> mFunc;
+};
+
+struct BenchResult
+{
+	std::string mName;
+	uint64_t mIterations;
+	double mNsPerOp;
+	double mNsPerOpMin;
+	double mItemsPerSecond;
+};
+
+typedef std::vector<Benchmark> BenchmarkVector;
+
+static double Seconds(uint64_t theTicks)
+{
+	return (double)theTicks / (double)SDL_GetPerformanceFrequency();
+}
+
+static double TimeIterations(const Benchmark &theBenchmark, uint64_t theIterations)
+{
+	uint64_t aStartTicks = SDL_GetPerformanceCounter();
+	for (uint64_t i = 0; i < theIterations; i++)
+		theBenchmark.mFunc();
+	return Seconds(SDL_GetPerformanceCounter() - aStartTicks);
+}
+
+static BenchResult RunBenchmark(const Benchmark &theBenchmark, double theMinTime, int theSamples)
+{
+	// grow the iteration count until one sample takes theMinTime
+	uint64_t anIterations = 1;
+	for (;;)
+	{
+		double aTime = TimeIterations(theBenchmark, anIterations);
+		if (aTime >= theMinTime)
+			break;
+
+		uint64_t aGrow = (aTime <= theMinTime / 100) ? 100 : (uint64_t)(theMinTime / aTime * 1.2) + 1;
+		anIterations *= std::max<uint64_t>(aGrow, 2);
+	}
+
+	std::vector<double> aNsPerOp;
+	for (int i = 0; i < theSamples; i++)
+		aNsPerOp.push_back(TimeIterations(theBenchmark, anIterations) * 1e9 / anIterations);
+	std::sort(aNsPerOp.begin(), aNsPerOp.end());
+
+	BenchResult aResult;
+	aResult.mName = theBenchmark.mName;
+	aResult.mIterations = anIterations;
+	aResult.mNsPerOp = aNsPerOp[aNsPerOp.size() / 2];
+	aResult.mNsPerOpMin = aNsPerOp[0];
+	aResult.mItemsPerSecond = theBenchmark.mItemsPerOp > 0 ? theBenchmark.mItemsPerOp * 1e9 / aResult.mNsPerOp : 0;
+	return aResult;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static void FreeBenchData()
+{
+	for (Graphics *aGraphics : gBenchGraphics)
+		delete aGraphics;
+	gBenchGraphics.clear();
+
+	for (Font *aFont : gBenchFonts)
+		delete aFont;
+	gBenchFonts.clear();
+
+	for (MemoryImage *anImage : gBenchImages)
+		delete anImage;
+	gBenchImages.clear();
+
+	for (Buffer *aBuffer : gBenchBuffers)
+		delete aBuffer;
+	gBenchBuffers.clear();
+}
+
+static MemoryImage *CreateTestImage(int theSize, bool hasAlpha)
+{
+	MemoryImage *anImage = new MemoryImage();
+	gBenchImages.push_back(anImage);
+	anImage->Create(theSize, theSize);
+
+	ulong *aBits = anImage->GetBits();
+	for (int y = 0; y < theSize; y++)
+	{
+		for (int x = 0; x < theSize; x++)
+		{
+			ulong anAlpha = hasAlpha ? (ulong)((x * 255 / std::max(theSize - 1, 1)) & 0xFF) : 0xFF;
+			aBits[y * theSize + x] = (anAlpha << 24) | ((x * 7) & 0xFF) << 16 | ((y * 5) & 0xFF) << 8 | 0x40;
+		}
+	}
+
+	anImage->SetImageMode(hasAlpha, hasAlpha);
+	anImage->BitsChanged();
+	return anImage;
+}
+
+static void AddBlitBenchmarks(BenchmarkVector &theBenchmarks, MemoryImage *theDest)
+{
+	static const int aSizes[] = {16, 64, 256};
+
+	for (int aSize : aSizes)
+	{
+		MemoryImage *anOpaqueImage = CreateTestImage(aSize, false);
+		MemoryImage *anAlphaImage = CreateTestImage(aSize, true);
+		Rect aSrcRect(0, 0, aSize, aSize);
+		Color aTint(255, 128, 64, 160);
+		double aPixels = (double)aSize * aSize;
+
+		theBenchmarks.push_back({StrFormat("MemoryImage/NormalBlt/%d/opaque", aSize), aPixels,
+								 [=]() { theDest->NormalBlt(anOpaqueImage, 8, 8, aSrcRect, Color::White); }});
+		theBenchmarks.push_back({StrFormat("MemoryImage/NormalBlt/%d/alpha", aSize), aPixels,
+								 [=]() { theDest->NormalBlt(anAlphaImage, 8, 8, aSrcRect, Color::White); }});
+		theBenchmarks.push_back({StrFormat("MemoryImage/NormalBlt/%d/alpha_tinted", aSize), aPixels,
+								 [=]() { theDest->NormalBlt(anAlphaImage, 8, 8, aSrcRect, aTint); }});
+		theBenchmarks.push_back({StrFormat("MemoryImage/AdditiveBlt/%d/alpha", aSize), aPixels,
+								 [=]() { theDest->AdditiveBlt(anAlphaImage, 8, 8, aSrcRect, Color::White); }});
+		theBenchmarks.push_back({StrFormat("MemoryImage/AdditiveBlt/%d/alpha_tinted", aSize), aPixels,
+								 [=]() { theDest->AdditiveBlt(anAlphaImage, 8, 8, aSrcRect, aTint); }});
+
+		theBenchmarks.push_back({StrFormat("MemoryImage/FillRect/%d/opaque", aSize), aPixels, [=]() {
+									 theDest->FillRect(aSrcRect, Color(32, 64, 128), Graphics::DRAWMODE_NORMAL);
+								 }});
+		theBenchmarks.push_back({StrFormat("MemoryImage/FillRect/%d/alpha", aSize), aPixels, [=]() {
+									 theDest->FillRect(aSrcRect, Color(32, 64, 128, 128), Graphics::DRAWMODE_NORMAL);
+								 }});
+		theBenchmarks.push_back({StrFormat("MemoryImage/FillRect/%d/additive", aSize), aPixels, [=]() {
+									 theDest->FillRect(aSrcRect, Color(32, 64, 128), Graphics::DRAWMODE_ADDITIVE);
+								 }});
+
+		if (aSize > 128)
+			continue;
+
+		// 2x up, so the destination area is four times the source
+		Rect aDestRect(8, 8, aSize * 2, aSize * 2);
+		Rect aClipRect(0, 0, theDest->mWidth, theDest->mHeight);
+
+		theBenchmarks.push_back({StrFormat("MemoryImage/StretchBlt/%d/fast", aSize), aPixels * 4, [=]() {
+									 theDest->StretchBlt(anAlphaImage, aDestRect, aSrcRect, aClipRect, Color::White,
+														 Graphics::DRAWMODE_NORMAL, true);
+								 }});
+		theBenchmarks.push_back({StrFormat("MemoryImage/StretchBlt/%d/slow", aSize), aPixels * 4, [=]() {
+									 theDest->StretchBlt(anAlphaImage, aDestRect, aSrcRect, aClipRect, Color::White,
+														 Graphics::DRAWMODE_NORMAL, false);
+								 }});
+	}
+}
+
+static void AddTriangleBenchmarks(BenchmarkVector &theBenchmarks, MemoryImage *theDest)
+{
+	SWTri_AddAllDrawTriFuncs();
+
+	// the texture has to be a power of two on each side
+	MemoryImage *aTexture = CreateTestImage(256, true);
+
+	static const int aSizes[] = {64, 256};
+
+	for (int aSize : aSizes)
+	{
+		// right triangle with both legs aSize long, in 16.16 fixed point
+		SWHelper::SWVertex aVerts[3];
+		memset(aVerts, 0, sizeof(aVerts));
+		aVerts[0].x = 8 << 16;
+		aVerts[0].y = 8 << 16;
+		aVerts[1].x = (8 + aSize) << 16;
+		aVerts[1].y = 8 << 16;
+		aVerts[1].u = 255 << 16;
+		aVerts[2].x = 8 << 16;
+		aVerts[2].y = (8 + aSize) << 16;
+		aVerts[2].v = 255 << 16;
+		for (int i = 0; i < 3; i++)
+		{
+			aVerts[i].a = 0xC0 << 16;
+			aVerts[i].r = (0x40 + i * 0x40) << 16;
+			aVerts[i].g = 0x80 << 16;
+			aVerts[i].b = 0xFF << 16;
+		}
+
+		SWHelper::SWTextureInfo aTextureInfo;
+		aTextureInfo.pTexture = (const unsigned int *)aTexture->GetBits();
+		aTextureInfo.pitch = aTexture->mWidth;
+		aTextureInfo.height = aTexture->mHeight;
+		aTextureInfo.endpos = aTexture->mWidth * aTexture->mHeight;
+		aTextureInfo.vShift = 16 - 8; // log2 of the 256 pixel pitch
+		aTextureInfo.uMask = (unsigned int)(aTexture->mWidth - 1) << 16;
+		aTextureInfo.vMask = (unsigned int)(aTexture->mHeight - 1) << 16;
+
+		unsigned int *aFrameBuffer = (unsigned int *)theDest->GetBits();
+		unsigned int aBytePitch = theDest->mWidth * 4;
+		double aPixels = (double)aSize * aSize / 2;
+
+		struct Variant
+		{
+			const char *mName;
+			bool mTextured;
+			bool mTAlpha;
+			bool mModARGB;
+			bool mGlobalARGB;
+			bool mBlend;
+		};
+
+		static const Variant aVariants[] = {{"flat", false, false, false, true, false},
+											{"flat_blend", false, false, false, true, true},
+											{"gouraud_blend", false, false, true, false, true},
+											{"textured", true, false, false, false, false},
+											{"textured_alpha", true, true, false, false, true},
+											{"textured_alpha_modulated", true, true, true, true, true}};
+
+		for (const Variant &aVariant : aVariants)
+		{
+			theBenchmarks.push_back(
+				{StrFormat("SWHelper/SWDrawTriangle/%d/%s", aSize, aVariant.mName), aPixels, [=]() {
+					 SWHelper::SWVertex aTriVerts[3] = {aVerts[0], aVerts[1], aVerts[2]};
+					 SWHelper::SWDiffuse aDiffuse = {0xC0, 0xFF, 0x80, 0x40};
+					 SWHelper::SWDrawTriangle(aVariant.mTextured, aVariant.mTAlpha, aVariant.mModARGB,
+											  aVariant.mGlobalARGB, aTriVerts, aFrameBuffer, aBytePitch,
+											  &aTextureInfo, aDiffuse, 0x8888, aVariant.mBlend);
+				 }});
+		}
+	}
+}
+
+static void AddFontBenchmarks(BenchmarkVector &theBenchmarks, AppBase *theApp)
+{
+	ImageFont *aFont = new ImageFont(theApp, "fonts/ContinuumBold12.txt");
+	gBenchFonts.push_back(aFont);
+	if (aFont->mFontData == nullptr || !aFont->mFontData->mInitialized)
+	{
+		fprintf(stderr, "poplib_microbench: couldn't load fonts/ContinuumBold12.txt, skipping font benchmarks\n");
+		return;
+	}
+
+	static const char *aShort = "Score: 1234567";
+	static const char *aLong = "The quick brown fox jumps over the lazy dog while the planets keep on spinning, "
+							   "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG 0123456789 !?.,;:'\"()[]";
+
+	struct Text
+	{
+		const char *mName;
+		const char *mString;
+	};
+	static const Text aTexts[] = {{"short", aShort}, {"long", aLong}};
+
+	SDLInterface *anInterface = theApp->mSDLInterface;
+	Graphics *aScreenG = new Graphics(anInterface->GetScreenImage());
+	gBenchGraphics.push_back(aScreenG);
+	Rect aClipRect(0, 0, theApp->mWidth, theApp->mHeight);
+
+	for (const Text &aText : aTexts)
+	{
+		PopString aString = aText.mString;
+		double aChars = (double)aString.length();
+
+		theBenchmarks.push_back({StrFormat("ImageFont/StringWidth/%s", aText.mName), aChars,
+								 [=]() { gSink = gSink + aFont->StringWidth(aString); }});
+		theBenchmarks.push_back({StrFormat("ImageFont/DrawStringEx/%s", aText.mName), aChars, [=]() {
+									 aFont->DrawStringEx(aScreenG, 4, 40, aString, Color::White, &aClipRect, nullptr,
+														 nullptr);
+									 anInterface->FlushBatch();
+								 }});
+	}
+}
+
+static void AddBufferBenchmarks(BenchmarkVector &theBenchmarks)
+{
+	const int aCount = 1024;
+	static const int aBitCounts[] = {1, 5, 13, 32};
+
+	for (int aBits : aBitCounts)
+	{
+		Buffer *aWriteBuffer = new Buffer();
+		Buffer *aReadBuffer = new Buffer();
+		gBenchBuffers.push_back(aWriteBuffer);
+		gBenchBuffers.push_back(aReadBuffer);
+		int aMask = (aBits == 32) ? -1 : ((1 << aBits) - 1);
+
+		for (int i = 0; i < aCount; i++)
+			aReadBuffer->WriteNumBits((i * 2654435761u) & aMask, aBits);
+
+		theBenchmarks.push_back({StrFormat("Buffer/WriteNumBits/%d", aBits), (double)aCount * aBits, [=]() {
+									 aWriteBuffer->Clear();
+									 for (int i = 0; i < aCount; i++)
+										 aWriteBuffer->WriteNumBits((i * 2654435761u) & aMask, aBits);
+									 gSink = gSink + aWriteBuffer->mDataBitSize;
+								 }});
+		theBenchmarks.push_back({StrFormat("Buffer/ReadNumBits/%d", aBits), (double)aCount * aBits, [=]() {
+									 aReadBuffer->SeekFront();
+									 int aSum = 0;
+									 for (int i = 0; i < aCount; i++)
+										 aSum += aReadBuffer->ReadNumBits(aBits, false);
+									 gSink = gSink + aSum;
+								 }});
+	}
+}
+
+static std::string ReadPakFile(const std::string &theFileName)
+{
+	std::string aData;
+
+	PFILE *aFile = p_fopen(theFileName.c_str(), "rb");
+	if (aFile == nullptr)
+		return aData;
+
+	char aChunk[4096];
+	for (;;)
+	{
+		size_t aRead = p_fread(aChunk, 1, sizeof(aChunk), aFile);
+		if (aRead == 0)
+			break;
+		aData.append(aChunk, aRead);
+	}
+
+	p_fclose(aFile);
+	return aData;
+}
+
+static void AddXMLBenchmarks(BenchmarkVector &theBenchmarks)
+{
+	std::string aManifest = ReadPakFile("properties/resources.xml");
+
+	size_t aBodyStart = aManifest.find("<ResourceManifest");
+	if (aBodyStart != std::string::npos)
+		aBodyStart = aManifest.find('>', aBodyStart);
+	size_t aBodyEnd = aManifest.rfind("</ResourceManifest>");
+	if (aBodyStart == std::string::npos || aBodyEnd == std::string::npos || aBodyEnd <= aBodyStart)
+	{
+		fprintf(stderr, "poplib_microbench: couldn't read properties/resources.xml, skipping XML benchmarks\n");
+		return;
+	}
+
+	// the examples' manifest is small, repeat its body to get something the size of a real game's
+	std::string aBody = aManifest.substr(aBodyStart + 1, aBodyEnd - aBodyStart - 1);
+	std::string aLargeManifest = "<?xml version=\"1.0\"?>\n<ResourceManifest>";
+	for (int i = 0; i < 32; i++)
+		aLargeManifest += aBody;
+	aLargeManifest += "</ResourceManifest>\n";
+
+	int anElementCount = 0;
+	{
+		XMLParser aParser;
+		XMLElement anElement;
+		if (aParser.OpenBuffer(aLargeManifest))
+			while (aParser.NextElement(&anElement))
+				anElementCount++;
+	}
+
+	theBenchmarks.push_back({"XMLParser/NextElement/resources_x32", (double)anElementCount, [=]() {
+								 XMLParser aParser;
+								 XMLElement anElement;
+								 aParser.OpenBuffer(aLargeManifest);
+								 int aCount = 0;
+								 while (aParser.NextElement(&anElement))
+									 aCount++;
+								 gSink = gSink + aCount;
+							 }});
+}
+
+static void AddPakBenchmarks(BenchmarkVector &theBenchmarks)
+{
+	static const char *aFileName = "images/atomicexplosion.jpg";
+	double aSize = (double)ReadPakFile(aFileName).size();
+
+	theBenchmarks.push_back({"PakInterface/FOpen", 0, []() {
+								 PFILE *aFile = gPakInterface->FOpen(aFileName, "rb");
+								 if (aFile != nullptr)
+									 gPakInterface->FClose(aFile);
+							 }});
+	theBenchmarks.push_back({"PakInterface/FRead/4k", aSize, []() {
+								 PFILE *aFile = gPakInterface->FOpen(aFileName, "rb");
+								 if (aFile == nullptr)
+									 return;
+
+								 char aChunk[4096];
+								 while (gPakInterface->FRead(aChunk, 1, sizeof(aChunk), aFile) > 0)
+									 gSink = gSink + (uchar)aChunk[0];
+								 gPakInterface->FClose(aFile);
+							 }});
+}
+
+static void AddImageLibBenchmarks(BenchmarkVector &theBenchmarks)
+{
+	struct Decode
+	{
+		const char *mName;
+		const char *mFileName;
+	};
+	static const Decode aDecodes[] = {
+		{"jpg", "images/atomicexplosion.jpg"}, {"png", "images/layer1.png"}, {"gif", "images/dialog.gif"}};
+
+	for (const Decode &aDecode : aDecodes)
+	{
+		std::string aFileName = aDecode.mFileName;
+
+		ImageLib::Image *anImage = ImageLib::GetImage(aFileName, false);
+		if (anImage == nullptr)
+		{
+			fprintf(stderr, "poplib_microbench: couldn't decode %s, skipping\n", aDecode.mFileName);
+			continue;
+		}
+		double aPixels = (double)anImage->GetWidth() * anImage->GetHeight();
+		delete anImage;
+
+		theBenchmarks.push_back({StrFormat("ImageLib/GetImage/%s", aDecode.mName), aPixels, [=]() {
+									 ImageLib::Image *anImage = ImageLib::GetImage(aFileName, false);
+									 gSink = gSink + (anImage != nullptr ? anImage->GetWidth() : 0);
+									 delete anImage;
+								 }});
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+	std::string aFilter;
+	std::string anOutPath;
+	double aMinTime = 0.1;
+	int aSamples = 5;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "--filter") == 0) && (i + 1 < argc))
+			aFilter = argv[++i];
+		else if ((strcmp(argv[i], "--min-time") == 0) && (i + 1 < argc))
+			aMinTime = std::max(atof(argv[++i]), 1.0) / 1000.0;
+		else if ((strcmp(argv[i], "--samples") == 0) && (i + 1 < argc))
+			aSamples = std::max(atoi(argv[++i]), 1);
+		else if ((strcmp(argv[i], "--out") == 0) && (i + 1 < argc))
+			anOutPath = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [--filter text] [--min-time ms] [--samples N] [--out file.json]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// headless, same setup as poplib_scene_bench
+	SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+	SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+	SDL_SetHint(SDL_HINT_RENDER_VSYNC, "0");
+	SDL_setenv_unsafe("ALSOFT_DRIVERS", "null", 1);
+
+	BenchApp *anApp = new BenchApp();
+	anApp->Init();
+	if (!anApp->mInitialized)
+	{
+		fprintf(stderr, "poplib_microbench: initialization failed\n");
+		delete anApp;
+		return 1;
+	}
+
+	SRand(1);
+	srand(1);
+
+	MemoryImage *aDest = new MemoryImage();
+	aDest->Create(1024, 1024);
+	aDest->SetImageMode(true, true);
+
+	BenchmarkVector aBenchmarks;
+	AddBlitBenchmarks(aBenchmarks, aDest);
+	AddTriangleBenchmarks(aBenchmarks, aDest);
+	AddFontBenchmarks(aBenchmarks, anApp);
+	AddBufferBenchmarks(aBenchmarks);
+	AddXMLBenchmarks(aBenchmarks);
+	AddPakBenchmarks(aBenchmarks);
+	AddImageLibBenchmarks(aBenchmarks);
+
+	std::string aJSON = "{\n  \"benchmarks\": [\n";
+	bool first = true;
+
+	for (const Benchmark &aBenchmark : aBenchmarks)
+	{
+		if (!aFilter.empty() && aBenchmark.mName.find(aFilter) == std::string::npos)
+			continue;
+
+		BenchResult aResult = RunBenchmark(aBenchmark, aMinTime, aSamples);
+		fprintf(stderr, "%-52s %14.1f ns/op\n", aResult.mName.c_str(), aResult.mNsPerOp);
+
+		if (!first)
+			aJSON += ",\n";
+		first = false;
+
+		aJSON += StrFormat("    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"ns_per_op_min\": %.2f, "
+						   "\"items_per_second\": %.0f}",
+						   aResult.mName.c_str(), (unsigned long long)aResult.mIterations, aResult.mNsPerOp,
+						   aResult.mNsPerOpMin, aResult.mItemsPerSecond);
+	}
+
+	aJSON += "\n  ]\n}\n";
+	fputs(aJSON.c_str(), stdout);
+
+	int anExitCode = 0;
+	if (!anOutPath.empty())
+	{
+		FILE *aFile = fopen(anOutPath.c_str(), "w");
+		if (aFile != nullptr)
+		{
+			fputs(aJSON.c_str(), aFile);
+			fclose(aFile);
+		}
+		else
+		{
+			fprintf(stderr, "poplib_microbench: couldn't write %s\n", anOutPath.c_str());
+			anExitCode = 1;
+		}
+	}
+
+	// the benchmarks only hold pointers into the bench data, which goes before the app it was made with
+	aBenchmarks.clear();
+	FreeBenchData();
+	delete aDest;
+
+	anApp->mShutdown = true;
+	delete anApp;
+	return anExitCode;
+}
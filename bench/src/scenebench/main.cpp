@@ -0,0 +1,460 @@
+//////////////////////////////////////////////////////////////////////////
+//						main.cpp
+//
+//	Headless scene benchmark. Runs the Hun-garr board under SDL's offscreen
+//	video driver with the software renderer, OpenAL's null backend, no
+//	vsync and no sleeping, steps a fixed number of update/draw frames with a
+//	fixed random seed and prints frame time, draw call and allocation
+//	statistics as JSON.
+//
+//	Afterwards a probe widget goes on top of the board for a few more
+//	frames. It nests PushState eight deep and copies the Graphics it is
+//	handed at every level; the run fails if any of that allocates. A
+//	second one has mCacheDraw set, so after its first frame it's drawn by
+//	replaying its DisplayList. It's also drawn offscreen both directly and
+//	from its list, and the run fails unless the pixels match.
+//
+//	Run it from examples/bin (where it is built) so main.gpak is found:
+//		poplib_scene_bench [--frames N] [--warmup N] [--seed N] [--out file.json]
+//////////////////////////////////////////////////////////////////////////
+
+#include "gameapp.hpp"
+#include "titlescreen.hpp"
+#include "res.hpp"
+#include "PopLib/widget/widgetmanager.hpp"
+#include "PopLib/graphics/graphics.hpp"
+#include "PopLib/graphics/displaylist.hpp"
+#include "PopLib/graphics/sdlimage.hpp"
+#include "PopLib/graphics/sdlinterface.hpp"
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace PopLib;
+
+//////////////////////////////////////////////////////////////////////////
+// Every heap allocation in the process goes through here so each frame's
+// allocations can be counted.
+//////////////////////////////////////////////////////////////////////////
+
+static std::atomic<uint64_t> gAllocCount{0};
+static std::atomic<uint64_t> gAllocBytes{0};
+
+void *operator new(size_t theSize)
+{
+	gAllocCount.fetch_add(1, std::memory_order_relaxed);
+	gAllocBytes.fetch_add(theSize, std::memory_order_relaxed);
+
+	void *aPtr = malloc(theSize != 0 ? theSize : 1);
+	if (aPtr == nullptr)
+		throw std::bad_alloc();
+	return aPtr;
+}
+
+void *operator new[](size_t theSize)
+{
+	return operator new(theSize);
+}
+
+void operator delete(void *thePtr) noexcept
+{
+	free(thePtr);
+}
+
+void operator delete[](void *thePtr) noexcept
+{
+	free(thePtr);
+}
+
+void operator delete(void *thePtr, size_t) noexcept
+{
+	free(thePtr);
+}
+
+void operator delete[](void *thePtr, size_t) noexcept
+{
+	free(thePtr);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+class SceneBenchApp : public GameApp
+{
+  public:
+	virtual void PreDisplayHook()
+	{
+		GameApp::PreDisplayHook();
+
+		// whatever the registry says, run in a plain window with no waiting on the display and no music
+		mIsWindowed = true;
+		mFullScreenWindow = false;
+		mForceFullscreen = false;
+		mWaitForVSync = false;
+		mSoftVSyncWait = false;
+		mNoSoundNeeded = true;
+	}
+
+	bool LeaveTitleScreen()
+	{
+		for (WidgetList::iterator anItr = mWidgetManager->mWidgets.begin(); anItr != mWidgetManager->mWidgets.end();
+			 ++anItr)
+		{
+			TitleScreen *aTitleScreen = dynamic_cast<TitleScreen *>(*anItr);
+			if (aTitleScreen != nullptr)
+			{
+				// same as clicking the "click here to play" link
+				aTitleScreen->ButtonDepress(1);
+				ProcessSafeDeleteList();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void StepFrame()
+	{
+		// input is dropped so every run sees the same frames
+		SDL_PumpEvents();
+		SDL_FlushEvents(SDL_EVENT_FIRST, SDL_EVENT_LAST);
+
+		DoUpdateFrames();
+		DoUpdateFramesF(1.0f);
+		ProcessSafeDeleteList();
+		DrawDirtyStuff();
+	}
+};
+
+// Does to a Graphics what nested widgets do and counts the heap allocations that causes, which should be none as
+// long as the nesting stays within MAX_INLINE_STATES
+class GraphicsAllocProbe : public Widget
+{
+  public:
+	uint64_t mAllocs;
+	int mDrawCount;
+
+	GraphicsAllocProbe() : mAllocs(0), mDrawCount(0)
+	{
+		mMouseVisible = false;
+		mHasAlpha = true;
+	}
+
+	virtual void Update()
+	{
+		Widget::Update();
+		MarkDirty();
+	}
+
+	void DrawNested(Graphics *g, int theDepth)
+	{
+		g->PushState();
+		g->Translate(1, 1);
+		g->ClipRect(0, 0, mWidth - theDepth, mHeight - theDepth);
+		g->SetColor(Color(255, 255, 255, 32));
+		g->FillRect(0, 0, 4, 4);
+
+		// a child's Graphics, copied on the stack from its parent's
+		Graphics aCopy(*g);
+		aCopy.SetColor(Color(0, 0, 0, 32));
+		aCopy.FillRect(2, 2, 4, 4);
+
+		if (theDepth + 1 < MAX_INLINE_STATES)
+			DrawNested(&aCopy, theDepth + 1);
+
+		g->PopState();
+	}
+
+	virtual void Draw(Graphics *g)
+	{
+		uint64_t anAllocCount = gAllocCount.load(std::memory_order_relaxed);
+
+		// eight deep on the one Graphics (DrawNested pushes the last), and eight deep across the copies
+		for (int i = 0; i < MAX_INLINE_STATES - 1; i++)
+			g->PushState();
+		DrawNested(g, 0);
+		for (int i = 0; i < MAX_INLINE_STATES - 1; i++)
+			g->PopState();
+
+		// the first draw is left out, it may be what grows the renderer's batch buffers
+		if (mDrawCount > 0)
+			mAllocs += gAllocCount.load(std::memory_order_relaxed) - anAllocCount;
+		mDrawCount++;
+	}
+};
+
+// A static panel with fills, lines, an image and text, recorded once into its DisplayList and replayed from then on
+class DisplayListProbe : public Widget
+{
+  public:
+	int mDrawCount;
+
+	DisplayListProbe() : mDrawCount(0)
+	{
+		mMouseVisible = false;
+		mCacheDraw = true;
+	}
+
+	virtual void Update()
+	{
+		Widget::Update();
+		MarkDirty();
+	}
+
+	virtual void Draw(Graphics *g)
+	{
+		mDrawCount++;
+
+		g->SetColor(Color(32, 48, 96));
+		g->FillRect(0, 0, mWidth, mHeight);
+		g->SetColor(Color(255, 255, 255, 128));
+		g->DrawRect(2, 2, mWidth - 5, mHeight - 5);
+		g->DrawLine(2, mHeight - 3, mWidth - 3, 2);
+
+		int anImageWidth = std::min(IMAGE_HUNGARR_HORIZ->GetWidth(), mWidth - 8);
+		int anImageHeight = std::min(IMAGE_HUNGARR_HORIZ->GetHeight(), mHeight / 2);
+		g->DrawImage(IMAGE_HUNGARR_HORIZ, 4, 4, Rect(0, 0, anImageWidth, anImageHeight));
+
+		g->SetFont(FONT_HUNGARR);
+		g->SetColor(Color(255, 255, 0));
+		g->DrawString("Replayed", 4, mHeight - 6);
+	}
+};
+
+// Draws theWidget through DrawWithDisplayList into a new render target the widget's size and returns its pixels
+static std::vector<ulong> DrawOffscreen(AppBase *theApp, Widget *theWidget)
+{
+	SDLImage *anImage = new SDLImage(theApp->mSDLInterface);
+	anImage->Create(theWidget->mWidth, theWidget->mHeight);
+
+	{
+		Graphics aDrawG(anImage);
+		theWidget->DrawWithDisplayList(&aDrawG);
+	}
+
+	ulong *aBits = anImage->GetBits();
+	std::vector<ulong> aPixels(aBits, aBits + theWidget->mWidth * theWidget->mHeight);
+	delete anImage;
+	return aPixels;
+}
+
+struct FrameSample
+{
+	double mMilliseconds;
+	int mDrawCalls;
+	int mUploadBytes;
+	uint64_t mAllocs;
+	uint64_t mAllocBytes;
+};
+
+static double Percentile(const std::vector<double> &theSorted, double thePercent)
+{
+	if (theSorted.empty())
+		return 0;
+
+	size_t anIndex = (size_t)(thePercent * (theSorted.size() - 1) + 0.5);
+	return theSorted[std::min(anIndex, theSorted.size() - 1)];
+}
+
+static int Fail(const char *theReason)
+{
+	fprintf(stderr, "poplib_scene_bench: %s\n", theReason);
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	int aFrameCount = 600;
+	int aWarmupCount = 60;
+	ulong aSeed = 1;
+	std::string anOutPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "--frames") == 0) && (i + 1 < argc))
+			aFrameCount = std::max(atoi(argv[++i]), 1);
+		else if ((strcmp(argv[i], "--warmup") == 0) && (i + 1 < argc))
+			aWarmupCount = std::max(atoi(argv[++i]), 0);
+		else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc))
+			aSeed = strtoul(argv[++i], nullptr, 10);
+		else if ((strcmp(argv[i], "--out") == 0) && (i + 1 < argc))
+			anOutPath = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [--frames N] [--warmup N] [--seed N] [--out file.json]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// all of this has to be in place before AppBase's constructor initializes SDL
+	SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+	SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+	SDL_SetHint(SDL_HINT_RENDER_VSYNC, "0");
+	SDL_setenv_unsafe("ALSOFT_DRIVERS", "null", 1);
+
+	SceneBenchApp *anApp = new SceneBenchApp();
+	anApp->Init();
+	if (anApp->mLoadingFailed || !anApp->mInitialized)
+		return Fail("initialization failed, run from examples/bin");
+
+	anApp->StartLoadingThread();
+	while (!anApp->mLoadingThreadCompleted)
+		SDL_Delay(1);
+
+	if (anApp->mLoadingFailed)
+		return Fail("resource loading failed");
+
+	// picks up the finished loading thread
+	anApp->StepFrame();
+
+	anApp->mRandSeed = aSeed;
+	SRand(aSeed);
+	srand(aSeed);
+
+	if (!anApp->LeaveTitleScreen())
+		return Fail("title screen not found");
+
+	for (int i = 0; i < aWarmupCount; i++)
+		anApp->StepFrame();
+
+	std::vector<FrameSample> aSamples;
+	aSamples.reserve(aFrameCount);
+
+	double aTicksPerMillisecond = SDL_GetPerformanceFrequency() / 1000.0;
+
+	for (int i = 0; i < aFrameCount; i++)
+	{
+		uint64_t anAllocCount = gAllocCount.load(std::memory_order_relaxed);
+		uint64_t anAllocBytes = gAllocBytes.load(std::memory_order_relaxed);
+		uint64_t aStartTicks = SDL_GetPerformanceCounter();
+
+		anApp->StepFrame();
+
+		FrameSample aSample;
+		aSample.mMilliseconds = (SDL_GetPerformanceCounter() - aStartTicks) / aTicksPerMillisecond;
+		const RenderStats &aStats = anApp->mSDLInterface->GetRenderStats();
+		aSample.mDrawCalls = aStats.mDrawCalls;
+		aSample.mUploadBytes = aStats.mUploadBytes;
+		aSample.mAllocs = gAllocCount.load(std::memory_order_relaxed) - anAllocCount;
+		aSample.mAllocBytes = gAllocBytes.load(std::memory_order_relaxed) - anAllocBytes;
+		aSamples.push_back(aSample);
+	}
+
+	std::vector<double> aTimes;
+	double aTotalTime = 0;
+	double aTotalDrawCalls = 0;
+	double aTotalUploadBytes = 0;
+	double aTotalAllocs = 0;
+	double aTotalAllocBytes = 0;
+	int aMaxDrawCalls = 0;
+	uint64_t aMaxAllocs = 0;
+
+	for (size_t i = 0; i < aSamples.size(); i++)
+	{
+		const FrameSample &aSample = aSamples[i];
+		aTimes.push_back(aSample.mMilliseconds);
+		aTotalTime += aSample.mMilliseconds;
+		aTotalDrawCalls += aSample.mDrawCalls;
+		aTotalUploadBytes += aSample.mUploadBytes;
+		aTotalAllocs += aSample.mAllocs;
+		aTotalAllocBytes += aSample.mAllocBytes;
+		aMaxDrawCalls = std::max(aMaxDrawCalls, aSample.mDrawCalls);
+		aMaxAllocs = std::max(aMaxAllocs, aSample.mAllocs);
+	}
+
+	std::sort(aTimes.begin(), aTimes.end());
+	double aCount = (double)aSamples.size();
+
+	std::string aJSON = StrFormat("{\n"
+								  "  \"scene\": \"hun-garr\",\n"
+								  "  \"frames\": %d,\n"
+								  "  \"warmup\": %d,\n"
+								  "  \"seed\": %lu,\n"
+								  "  \"frame_ms\": {\"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n"
+								  "  \"draw_calls\": {\"mean\": %.2f, \"max\": %d},\n"
+								  "  \"upload_bytes\": {\"mean\": %.1f},\n"
+								  "  \"allocations\": {\"mean\": %.2f, \"max\": %llu, \"bytes_mean\": %.1f}\n"
+								  "}\n",
+								  aFrameCount, aWarmupCount, aSeed, aTotalTime / aCount, Percentile(aTimes, 0.50),
+								  Percentile(aTimes, 0.99), aTimes.back(), aTotalDrawCalls / aCount, aMaxDrawCalls,
+								  aTotalUploadBytes / aCount, aTotalAllocs / aCount, (unsigned long long)aMaxAllocs,
+								  aTotalAllocBytes / aCount);
+
+	fputs(aJSON.c_str(), stdout);
+
+	GraphicsAllocProbe *aProbe = new GraphicsAllocProbe();
+	aProbe->Resize(0, 0, 64, 64);
+	anApp->mWidgetManager->AddWidget(aProbe);
+	anApp->mWidgetManager->BringToFront(aProbe);
+
+	DisplayListProbe *aListProbe = new DisplayListProbe();
+	aListProbe->Resize(80, 80, 160, 64);
+	anApp->mWidgetManager->AddWidget(aListProbe);
+	anApp->mWidgetManager->BringToFront(aListProbe);
+
+	for (int i = 0; i < 10; i++)
+		anApp->StepFrame();
+	anApp->mWidgetManager->RemoveWidget(aProbe);
+	anApp->mWidgetManager->RemoveWidget(aListProbe);
+
+	uint64_t aProbeAllocs = aProbe->mAllocs;
+	int aProbeDraws = aProbe->mDrawCount;
+	delete aProbe;
+
+	// once to record, then never again, every later frame is a replay
+	int aListProbeDraws = aListProbe->mDrawCount;
+	bool aListComplete = aListProbe->mDisplayList != nullptr && aListProbe->mDisplayList->mComplete;
+
+	bool aListHasText = false;
+	if (aListProbe->mDisplayList != nullptr)
+	{
+		const DisplayList::CommandVector &aCommands = aListProbe->mDisplayList->mCommands;
+		for (size_t i = 0; i < aCommands.size(); i++)
+			aListHasText |= aCommands[i].mType == DisplayList::CMD_DRAWSTRING;
+	}
+
+	// the same widget drawn directly, then recorded and replayed, then replayed from the list it already has
+	aListProbe->mCacheDraw = false;
+	std::vector<ulong> aDirectPixels = DrawOffscreen(anApp, aListProbe);
+	aListProbe->mCacheDraw = true;
+	aListProbe->InvalidateDisplayList();
+	std::vector<ulong> aRecordedPixels = DrawOffscreen(anApp, aListProbe);
+	std::vector<ulong> aReplayedPixels = DrawOffscreen(anApp, aListProbe);
+	delete aListProbe;
+
+	if (!anOutPath.empty())
+	{
+		FILE *aFile = fopen(anOutPath.c_str(), "w");
+		if (aFile == nullptr)
+			return Fail("couldn't write the output file");
+		fputs(aJSON.c_str(), aFile);
+		fclose(aFile);
+	}
+
+	anApp->mShutdown = true;
+	delete anApp;
+
+	if (aProbeDraws < 2)
+		return Fail("the Graphics probe was never drawn");
+	if (aProbeAllocs != 0)
+	{
+		fprintf(stderr, "poplib_scene_bench: nested Graphics states and copies made %llu heap allocations\n",
+				(unsigned long long)aProbeAllocs);
+		return 1;
+	}
+
+	if (aListProbeDraws != 1)
+		return Fail("the cached widget wasn't replayed from its display list");
+	if (!aListComplete || !aListHasText)
+		return Fail("the cached widget's display list is incomplete or is missing its text");
+	if (aRecordedPixels != aDirectPixels || aReplayedPixels != aDirectPixels)
+		return Fail("replaying a display list drew differently than drawing the widget directly");
+
+	return 0;
+}
@@ -123,6 +123,11 @@ void Board::Draw(Graphics *g)
 	g->DrawString("Smooth motion is silky smoothness", 10, 200);
 	g->DrawImageF(IMAGE_ROBOTROBOT, mUpdateFMotionX, 220.0f);
 
+	// The Update driven motion can be smoothed out without UpdateF too: GetUpdateInterpolation
+	// tells how far we are into the next Update, so we draw where the image is heading by then.
+	g->DrawString("Interpolated motion is smooth too", 10, 460);
+	g->DrawImageF(IMAGE_ROBOTROBOT, mMotionX + 5.0f * (float)mApp->GetUpdateInterpolation(), 480.0f);
+
 	// Let's draw the currently selected list item:
 	g->DrawString(mText, mListWidget->mX, mListWidget->mY + mListWidget->mHeight + 20);
 }
@@ -234,15 +234,16 @@ class Board : public Widget, public ButtonListener, public EditListener, public
 	//	parts of your game logic should be in Update and which should be in
 	//	UpdateF.  To facilitate cooperation and good behavior between the two
 	//	update methods, there are some rules they follow:  Updating always occurs
-	//	in blocks, with one or two Update calls followed immediately with an
+	//	in blocks, with zero, one or two Update calls followed immediately with an
 	//	UpdateF call.  This means that the application will never get the chance
 	//	to draw or process input between an Update and a Draw without calling
 	//	UpdateF in the middle.  Therefore, you can assume that focus won't be
 	//	lost, nor will input change between an Update and an UpdateF, and you'll
 	//	know that you'll have a chance to finalize your state in UpdateF so things
 	//	can be left dangling (whatever that means for your app) after Update.
-	//	You are also guaranteed that the value passed in to UpdateF will be between
-	//	1.67 (for a 60 Hz monitor) and 1.0 (for a 100 Hz monitor).  Even if the
+	//	The value passed in to UpdateF is 1.67 for a 60 Hz monitor and 1.0 for a
+	//	100 Hz monitor.  Faster monitors get less than 1.0 (0.69 at 144 Hz), and
+	//	then only get an Update on the refreshes that add up to one.  Even if the
 	//	monitor is 60 Hz but the computer is only fast enough to draw at 30 FPS
 	//	you will get two Update blocks in a row before the draw, so it will still
 	//	appear to your app as if you are updating at 60 Hz.
@@ -0,0 +1,319 @@
+//////////////////////////////////////////////////////////////////////////
+//						main.cpp
+//
+//	GPAK packer. Packs every file under a directory into a version 2 .gpak
+//	(see PopLib/paklib/gpak.hpp): entries split into independently
+//	compressed chunks, chunks that don't shrink kept as is, identical files
+//	stored once. --list prints what's in a v1 or v2 pak.
+//
+//		gpak [--chunk-size KB] [--level 1-9] [--password text] <dir> <out.gpak>
+//		gpak --list <file.gpak>
+//////////////////////////////////////////////////////////////////////////
+
+#include "paklib/gpak.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+extern "C"
+{
+#include <aes.h>
+}
+
+static int Fail(const std::string &theReason)
+{
+	fprintf(stderr, "gpak: %s\n", theReason.c_str());
+	return 1;
+}
+
+static bool ReadWholeFile(const std::string &theFileName, std::vector<uint8_t> &theData)
+{
+	FILE *aFile = fopen(theFileName.c_str(), "rb");
+	if (aFile == nullptr)
+		return false;
+
+	fseek(aFile, 0, SEEK_END);
+	long aSize = ftell(aFile);
+	fseek(aFile, 0, SEEK_SET);
+
+	theData.resize(aSize > 0 ? aSize : 0);
+	bool ok = fread(theData.data(), 1, theData.size(), aFile) == theData.size();
+	fclose(aFile);
+	return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+class PakWriter
+{
+  public:
+	FILE *mFile;
+	uint64_t mPos;
+
+	PakWriter(FILE *theFile) : mFile(theFile), mPos(0)
+	{
+	}
+
+	bool Write(const void *theData, size_t theSize)
+	{
+		mPos += theSize;
+		return theSize == 0 || fwrite(theData, 1, theSize, mFile) == theSize;
+	}
+
+	bool Align(size_t theAlignment)
+	{
+		static const uint8_t aZeros[16] = {};
+		return Write(aZeros, (theAlignment - mPos % theAlignment) % theAlignment);
+	}
+};
+
+static void Encrypt(std::vector<uint8_t> &theData, const std::string &thePassword)
+{
+	// PKCS#7 style padding, which the runtime strips after decrypting, same as v1
+	uint8_t aPad = 16 - theData.size() % 16;
+	theData.insert(theData.end(), aPad, aPad);
+
+	AES_ctx aContext;
+	uint8_t aKey[32] = {};
+	memcpy(aKey, thePassword.data(), std::min(thePassword.size(), sizeof(aKey)));
+	AES_init_ctx(&aContext, aKey);
+
+	for (size_t i = 0; i < theData.size(); i += 16)
+		AES_ECB_encrypt(&aContext, theData.data() + i);
+}
+
+static int Pack(const std::string &theDir, const std::string &theOutFile, uint32_t theChunkSize, int theLevel,
+				const std::string &thePassword)
+{
+	namespace fs = std::filesystem;
+
+	std::error_code anError;
+	fs::path anOutPath = fs::absolute(theOutFile, anError);
+
+	std::vector<std::string> aFiles;
+	for (fs::recursive_directory_iterator anItr(theDir, anError), anEnd; !anError && anItr != anEnd;
+		 anItr.increment(anError))
+	{
+		if (anItr->is_regular_file() && !fs::equivalent(anItr->path(), anOutPath, anError))
+			aFiles.push_back(fs::relative(anItr->path(), theDir).generic_string());
+	}
+	if (anError)
+		return Fail("can't read " + theDir + ": " + anError.message());
+
+	// same input, same pak
+	std::sort(aFiles.begin(), aFiles.end());
+
+	FILE *aFile = fopen(theOutFile.c_str(), "wb");
+	if (aFile == nullptr)
+		return Fail("can't write " + theOutFile);
+
+	PakWriter aWriter(aFile);
+	GPAKHeaderV2 aHeader = {};
+	aWriter.Write(&aHeader, sizeof(aHeader)); // filled in at the end
+
+	std::vector<GPAKFileEntryV2> anEntries;
+	std::vector<GPAKChunk> aChunks;
+	std::map<std::pair<uint64_t, uint64_t>, size_t> aContentMap; // (hash, size) -> first entry with it
+	uint64_t aTotalIn = 0;
+	int aDuplicates = 0;
+
+	std::vector<uint8_t> aData;
+	std::vector<uint8_t> aCompressed;
+	for (const std::string &aPath : aFiles)
+	{
+		if (aPath.size() >= sizeof(GPAKFileEntryV2::path))
+		{
+			fclose(aFile);
+			return Fail("path too long: " + aPath);
+		}
+
+		if (!ReadWholeFile((fs::path(theDir) / aPath).string(), aData))
+		{
+			fclose(aFile);
+			return Fail("can't read " + aPath);
+		}
+		aTotalIn += aData.size();
+
+		GPAKFileEntryV2 anEntry = {};
+		strcpy(anEntry.path, aPath.c_str());
+		anEntry.originalSize = aData.size();
+		anEntry.contentHash = GPAKHash(aData.data(), aData.size());
+
+		// identical contents share the first copy's chunks
+		std::pair<uint64_t, uint64_t> aKey(anEntry.contentHash, anEntry.originalSize);
+		std::map<std::pair<uint64_t, uint64_t>, size_t>::iterator aSame = aContentMap.find(aKey);
+		if (aSame != aContentMap.end())
+		{
+			std::vector<uint8_t> anOther;
+			const GPAKFileEntryV2 &aFirst = anEntries[aSame->second];
+			if (ReadWholeFile((fs::path(theDir) / aFirst.path).string(), anOther) && anOther == aData)
+			{
+				anEntry.dataOffset = aFirst.dataOffset;
+				anEntry.firstChunk = aFirst.firstChunk;
+				anEntry.chunkCount = aFirst.chunkCount;
+				anEntries.push_back(anEntry);
+				aDuplicates++;
+				continue;
+			}
+		}
+		aContentMap[aKey] = anEntries.size();
+
+		aWriter.Align(16);
+		anEntry.dataOffset = aWriter.mPos;
+		anEntry.firstChunk = aChunks.size();
+
+		for (size_t aStart = 0; aStart < aData.size(); aStart += theChunkSize)
+		{
+			size_t aSize = std::min((size_t)theChunkSize, aData.size() - aStart);
+
+			uLongf aCompressedSize = compressBound(aSize);
+			aCompressed.resize(aCompressedSize);
+			GPAKChunk aChunk = {};
+			aChunk.codec = GPAK_CODEC_ZLIB;
+
+			// already compressed formats (png, ogg, ...) don't shrink, those are kept as is
+			if (compress2(aCompressed.data(), &aCompressedSize, aData.data() + aStart, aSize, theLevel) != Z_OK ||
+				aCompressedSize >= aSize)
+			{
+				aChunk.codec = GPAK_CODEC_STORED;
+				aCompressed.assign(aData.begin() + aStart, aData.begin() + aStart + aSize);
+			}
+			else
+				aCompressed.resize(aCompressedSize);
+
+			if (!thePassword.empty())
+				Encrypt(aCompressed, thePassword);
+
+			aChunk.offset = aWriter.mPos;
+			aChunk.compressedSize = (uint32_t)aCompressed.size();
+			aChunks.push_back(aChunk);
+			aWriter.Write(aCompressed.data(), aCompressed.size());
+		}
+
+		anEntry.chunkCount = (uint32_t)(aChunks.size() - anEntry.firstChunk);
+		anEntries.push_back(anEntry);
+	}
+
+	aWriter.Align(16);
+	aHeader.chunkTableOffset = aWriter.mPos;
+	aHeader.chunkCount = aChunks.size();
+	aWriter.Write(aChunks.data(), aChunks.size() * sizeof(GPAKChunk));
+
+	aWriter.Align(16);
+	memcpy(aHeader.base.magic, "GPAK", 5);
+	aHeader.base.version = 2;
+	aHeader.base.fileCount = (uint32_t)anEntries.size();
+	aHeader.base.fileTableOffset = aWriter.mPos;
+	aHeader.chunkSize = theChunkSize;
+	aHeader.flags = thePassword.empty() ? 0 : GPAK_FLAG_ENCRYPTED;
+	bool ok = aWriter.Write(anEntries.data(), anEntries.size() * sizeof(GPAKFileEntryV2));
+
+	ok = ok && fseek(aFile, 0, SEEK_SET) == 0 && fwrite(&aHeader, sizeof(aHeader), 1, aFile) == 1;
+	ok = (fclose(aFile) == 0) && ok;
+	if (!ok)
+		return Fail("failed writing " + theOutFile);
+
+	printf("%s: %d files (%d duplicates), %llu chunks, %llu -> %llu bytes\n", theOutFile.c_str(),
+		   (int)anEntries.size(), aDuplicates, (unsigned long long)aChunks.size(), (unsigned long long)aTotalIn,
+		   (unsigned long long)aWriter.mPos);
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static int List(const std::string &thePakFile)
+{
+	std::vector<uint8_t> aPak;
+	GPAKHeaderV2 aHeader = {};
+	if (!ReadWholeFile(thePakFile, aPak) || aPak.size() < sizeof(GPAKHeader))
+		return Fail("can't read " + thePakFile);
+
+	memcpy(&aHeader, aPak.data(), std::min(sizeof(aHeader), aPak.size()));
+	if (memcmp(aHeader.base.magic, "GPAK", 4) != 0)
+		return Fail(thePakFile + " isn't a GPAK file");
+
+	uint64_t aTableOffset = aHeader.base.fileTableOffset;
+	uint32_t aCount = aHeader.base.fileCount;
+	if (aHeader.base.version == 1)
+	{
+		if (aTableOffset > aPak.size() || aCount > (aPak.size() - aTableOffset) / sizeof(GPAKFileEntry))
+			return Fail("bad file table");
+
+		printf("version 1, %u files\n", aCount);
+		for (uint32_t i = 0; i < aCount; i++)
+		{
+			GPAKFileEntry anEntry;
+			memcpy(&anEntry, aPak.data() + aTableOffset + i * sizeof(anEntry), sizeof(anEntry));
+			anEntry.path[sizeof(anEntry.path) - 1] = 0;
+			printf("%10u %10u%s  %s\n", anEntry.originalSize, anEntry.compressedSize & ~GPAK_STORED,
+				   (anEntry.compressedSize & GPAK_STORED) ? " stored" : "", anEntry.path);
+		}
+		return 0;
+	}
+
+	if (aHeader.base.version != 2 || aPak.size() < sizeof(aHeader) || aTableOffset > aPak.size() ||
+		aCount > (aPak.size() - aTableOffset) / sizeof(GPAKFileEntryV2) ||
+		aHeader.chunkTableOffset > aPak.size() ||
+		aHeader.chunkCount > (aPak.size() - aHeader.chunkTableOffset) / sizeof(GPAKChunk))
+		return Fail("unknown version or bad tables");
+
+	const GPAKChunk *aChunks = (const GPAKChunk *)(aPak.data() + aHeader.chunkTableOffset);
+	printf("version 2, %u files, %llu chunks of %u bytes%s\n", aCount, (unsigned long long)aHeader.chunkCount,
+		   aHeader.chunkSize, (aHeader.flags & GPAK_FLAG_ENCRYPTED) ? ", encrypted" : "");
+	for (uint32_t i = 0; i < aCount; i++)
+	{
+		GPAKFileEntryV2 anEntry;
+		memcpy(&anEntry, aPak.data() + aTableOffset + i * sizeof(anEntry), sizeof(anEntry));
+		anEntry.path[sizeof(anEntry.path) - 1] = 0;
+
+		uint64_t aStoredSize = 0;
+		for (uint64_t c = anEntry.firstChunk; c < anEntry.firstChunk + anEntry.chunkCount && c < aHeader.chunkCount;
+			 c++)
+			aStoredSize += aChunks[c].compressedSize;
+
+		printf("%10llu %10llu %5u  %016llx  %s\n", (unsigned long long)anEntry.originalSize,
+			   (unsigned long long)aStoredSize, anEntry.chunkCount, (unsigned long long)anEntry.contentHash,
+			   anEntry.path);
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t aChunkSize = 64 * 1024;
+	int aLevel = Z_BEST_SPEED;
+	std::string aPassword;
+	std::vector<std::string> anArgs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "--list") == 0) && (i + 1 < argc))
+			return List(argv[i + 1]);
+		else if ((strcmp(argv[i], "--chunk-size") == 0) && (i + 1 < argc))
+			aChunkSize = std::max(atoi(argv[++i]), 1) * 1024;
+		else if ((strcmp(argv[i], "--level") == 0) && (i + 1 < argc))
+			aLevel = std::min(std::max(atoi(argv[++i]), 1), 9);
+		else if ((strcmp(argv[i], "--password") == 0) && (i + 1 < argc))
+			aPassword = argv[++i];
+		else
+			anArgs.push_back(argv[i]);
+	}
+
+	if (anArgs.size() != 2)
+	{
+		fprintf(stderr,
+				"usage: %s [--chunk-size KB] [--level 1-9] [--password text] <dir> <out.gpak>\n"
+				"       %s --list <file.gpak>\n",
+				argv[0], argv[0]);
+		return 1;
+	}
+
+	return Pack(anArgs[0], anArgs[1], aChunkSize, aLevel, aPassword);
+}